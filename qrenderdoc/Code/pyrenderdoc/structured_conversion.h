@@ -126,6 +126,16 @@ struct RefcountConverter
 template <>
 struct ExtRefcount<SDChunk *> : public ActiveRefcounter<SDChunk>
 {
+  static PyObject *GetPyObject(const SDChunk *c)
+  {
+    // python reads data.children directly, which doesn't decode lazy children on demand like the
+    // accessors do, so decode them before handing the chunk over.
+    if(c)
+      c->PopulateChildren();
+
+    return ActiveRefcounter<SDChunk>::GetPyObject(c);
+  }
+
   static void DelPyObject(PyObject *py, SDChunk *c)
   {
     // dec ref any python-owned objects in the children array, so the default destructor doesn't
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "apidefs.h"
+#include "rdcpair.h"
+
+// this is an open-addressing hash table with linear probing. Entries are stored inline in a single
+// contiguous allocation so a lookup touches a couple of adjacent cache lines instead of walking tree
+// or bucket nodes. It's intended for large bookkeeping maps keyed on IDs or pointers, with many
+// thousands of entries that are looked up far more often than they are iterated.
+//
+// Unlike the STL node-based containers, inserting a new key may rehash and so invalidates all
+// iterators and references. Looking up or assigning to an existing key never rehashes, and erasing
+// leaves a tombstone so it only invalidates iterators to the erased element.
+// Iteration order is unspecified.
+//
+// The hash is post-multiplied before picking a slot, so std::hash implementations that are the
+// identity (as is common for integers and pointers) still spread well over the power-of-two table.
+template <typename Key, typename Entry, typename KeyOf, typename Hash>
+struct rdchashtable
+{
+  template <bool isConst>
+  struct iterator_base
+  {
+    using table_type = typename std::conditional<isConst, const rdchashtable, rdchashtable>::type;
+    using value_type = typename std::conditional<isConst, const Entry, Entry>::type;
+
+    iterator_base() = default;
+    iterator_base(table_type *t, size_t i) : table(t), idx(i) {}
+    // for const iterators this allows conversion from non-const. Otherwise it's a copy constructor
+    iterator_base(const iterator_base<false> &o) : table(o.table), idx(o.idx) {}
+    iterator_base &operator=(const iterator_base &o) = default;
+
+    value_type &operator*() const { return table->m_Entries[idx]; }
+    value_type *operator->() const { return &table->m_Entries[idx]; }
+    iterator_base &operator++()
+    {
+      idx = table->next_full(idx + 1);
+      return *this;
+    }
+    iterator_base operator++(int)
+    {
+      iterator_base ret = *this;
+      ++(*this);
+      return ret;
+    }
+    bool operator==(const iterator_base &o) const { return idx == o.idx; }
+    bool operator!=(const iterator_base &o) const { return idx != o.idx; }
+    table_type *table = NULL;
+    size_t idx = 0;
+  };
+
+  using iterator = iterator_base<false>;
+  using const_iterator = iterator_base<true>;
+  using size_type = size_t;
+
+  rdchashtable() = default;
+  rdchashtable(const rdchashtable &o) { *this = o; }
+  rdchashtable(rdchashtable &&o) { swap(o); }
+  ~rdchashtable()
+  {
+    clear();
+    free(m_Entries);
+    free(m_State);
+  }
+
+  rdchashtable &operator=(const rdchashtable &o)
+  {
+    if(this == &o)
+      return *this;
+
+    clear();
+    reserve(o.size());
+    for(const Entry &e : o)
+    {
+      bool inserted = false;
+      insert_slot(KeyOf::get(e), inserted, e);
+    }
+    return *this;
+  }
+
+  rdchashtable &operator=(rdchashtable &&o)
+  {
+    swap(o);
+    return *this;
+  }
+
+  iterator begin() { return iterator(this, m_Size == 0 ? m_Capacity : next_full(0)); }
+  iterator end() { return iterator(this, m_Capacity); }
+  const_iterator begin() const
+  {
+    return const_iterator(this, m_Size == 0 ? m_Capacity : next_full(0));
+  }
+  const_iterator end() const { return const_iterator(this, m_Capacity); }
+
+  iterator find(const Key &key) { return iterator(this, find_slot(key)); }
+  const_iterator find(const Key &key) const { return const_iterator(this, find_slot(key)); }
+  size_t count(const Key &key) const { return find_slot(key) == m_Capacity ? 0 : 1; }
+
+  size_t erase(const Key &key)
+  {
+    size_t idx = find_slot(key);
+    if(idx == m_Capacity)
+      return 0;
+
+    erase_slot(idx);
+    return 1;
+  }
+
+  iterator erase(const_iterator it)
+  {
+    size_t idx = it.idx;
+    erase_slot(idx);
+    return iterator(this, m_Size == 0 ? m_Capacity : next_full(idx + 1));
+  }
+
+  bool empty() const { return m_Size == 0; }
+  size_t size() const { return m_Size; }
+  size_t capacity() const { return m_Capacity; }
+  // clear all entries, but keep the allocation as maps like this tend to be refilled to a similar
+  // size afterwards.
+  void clear()
+  {
+    if(m_Size > 0)
+    {
+      for(size_t i = 0; i < m_Capacity; i++)
+        if(m_State[i] == Full)
+          m_Entries[i].~Entry();
+    }
+
+    if(m_Capacity > 0)
+      memset(m_State, Empty, m_Capacity);
+    m_Size = m_Deleted = 0;
+  }
+
+  void reserve(size_t count)
+  {
+    size_t cap = MinCapacity;
+    while(cap * 3 < count * 4)
+      cap *= 2;
+    if(cap > m_Capacity)
+      rehash(cap);
+  }
+
+  void swap(rdchashtable &o)
+  {
+    std::swap(m_Entries, o.m_Entries);
+    std::swap(m_State, o.m_State);
+    std::swap(m_Capacity, o.m_Capacity);
+    std::swap(m_Shift, o.m_Shift);
+    std::swap(m_Size, o.m_Size);
+    std::swap(m_Deleted, o.m_Deleted);
+  }
+
+protected:
+  enum : uint8_t
+  {
+    Empty = 0,
+    Full = 1,
+    Deleted = 2,
+  };
+
+  static const size_t MinCapacity = 16;
+
+  Entry *m_Entries = NULL;
+  uint8_t *m_State = NULL;
+  size_t m_Capacity = 0;
+  uint32_t m_Shift = 64;
+  size_t m_Size = 0;
+  size_t m_Deleted = 0;
+
+  size_t home_slot(const Key &key) const
+  {
+    // fibonacci hashing - take the top bits of the hash multiplied by 2^64 / phi
+    return size_t((uint64_t(Hash()(key)) * 0x9E3779B97F4A7C15ULL) >> m_Shift);
+  }
+
+  size_t next_full(size_t idx) const
+  {
+    while(idx < m_Capacity && m_State[idx] != Full)
+      idx++;
+    return idx;
+  }
+
+  size_t find_slot(const Key &key) const
+  {
+    if(m_Size == 0)
+      return m_Capacity;
+
+    const size_t mask = m_Capacity - 1;
+    for(size_t idx = home_slot(key);; idx = (idx + 1) & mask)
+    {
+      if(m_State[idx] == Empty)
+        return m_Capacity;
+      if(m_State[idx] == Full && KeyOf::get(m_Entries[idx]) == key)
+        return idx;
+    }
+  }
+
+  // returns the slot holding key, constructing the entry from args if it isn't present. The table is
+  // only grown when a new key is inserted
+  template <typename... Args>
+  size_t insert_slot(const Key &key, bool &inserted, Args &&... args)
+  {
+    size_t idx = find_slot(key);
+    if(idx != m_Capacity)
+    {
+      inserted = false;
+      return idx;
+    }
+
+    // keep at least a quarter of the table empty, including tombstones, so probe sequences stay
+    // short. If most of the used slots are tombstones just rehash in place to clear them.
+    if(m_Capacity == 0)
+      rehash(MinCapacity);
+    else if((m_Size + m_Deleted + 1) * 4 > m_Capacity * 3)
+      rehash((m_Size + 1) * 2 > m_Capacity ? m_Capacity * 2 : m_Capacity);
+
+    const size_t mask = m_Capacity - 1;
+    idx = home_slot(key);
+    while(m_State[idx] == Full)
+      idx = (idx + 1) & mask;
+
+    if(m_State[idx] == Deleted)
+      m_Deleted--;
+
+    new(m_Entries + idx) Entry(std::forward<Args>(args)...);
+    m_State[idx] = Full;
+    m_Size++;
+    inserted = true;
+    return idx;
+  }
+
+  void erase_slot(size_t idx)
+  {
+    m_Entries[idx].~Entry();
+    m_State[idx] = Deleted;
+    m_Size--;
+    m_Deleted++;
+
+    // once everything is gone we can drop all the tombstones for free
+    if(m_Size == 0)
+    {
+      memset(m_State, Empty, m_Capacity);
+      m_Deleted = 0;
+    }
+  }
+
+  void rehash(size_t newCapacity)
+  {
+    Entry *oldEntries = m_Entries;
+    uint8_t *oldState = m_State;
+    size_t oldCapacity = m_Capacity;
+
+    m_Entries = (Entry *)malloc(sizeof(Entry) * newCapacity);
+    m_State = (uint8_t *)calloc(newCapacity, 1);
+    m_Capacity = newCapacity;
+    m_Shift = 64;
+    for(size_t c = newCapacity; c > 1; c >>= 1)
+      m_Shift--;
+    m_Deleted = 0;
+
+    const size_t mask = m_Capacity - 1;
+    for(size_t i = 0; i < oldCapacity; i++)
+    {
+      if(oldState[i] != Full)
+        continue;
+
+      size_t idx = home_slot(KeyOf::get(oldEntries[i]));
+      while(m_State[idx] != Empty)
+        idx = (idx + 1) & mask;
+
+      new(m_Entries + idx) Entry(std::move(oldEntries[i]));
+      m_State[idx] = Full;
+      oldEntries[i].~Entry();
+    }
+
+    free(oldEntries);
+    free(oldState);
+  }
+};
+
+template <typename Key, typename Value>
+struct rdchashmap_keyof
+{
+  static const Key &get(const rdcpair<Key, Value> &e) { return e.first; }
+};
+
+template <typename Key>
+struct rdchashset_keyof
+{
+  static const Key &get(const Key &e) { return e; }
+};
+
+// For ease of transition this presents a std::map like interface, with the weaker guarantees
+// described above.
+DOCUMENT("");
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+struct rdchashmap : public rdchashtable<Key, rdcpair<Key, Value>, rdchashmap_keyof<Key, Value>, Hash>
+{
+  using base = rdchashtable<Key, rdcpair<Key, Value>, rdchashmap_keyof<Key, Value>, Hash>;
+  using typename base::iterator;
+
+  Value &operator[](const Key &key)
+  {
+    bool inserted = false;
+    size_t idx = this->insert_slot(key, inserted, key, Value());
+    return this->m_Entries[idx].second;
+  }
+
+  rdcpair<iterator, bool> insert(const rdcpair<Key, Value> &val)
+  {
+    bool inserted = false;
+    size_t idx = this->insert_slot(val.first, inserted, val);
+    return {iterator(this, idx), inserted};
+  }
+};
+
+// as rdchashmap, but with a std::set like interface.
+DOCUMENT("");
+template <typename Key, typename Hash = std::hash<Key>>
+struct rdchashset : public rdchashtable<Key, Key, rdchashset_keyof<Key>, Hash>
+{
+  using base = rdchashtable<Key, Key, rdchashset_keyof<Key>, Hash>;
+  using typename base::iterator;
+
+  rdcpair<iterator, bool> insert(const Key &key)
+  {
+    bool inserted = false;
+    size_t idx = this->insert_slot(key, inserted, key);
+    return {iterator(this, idx), inserted};
+  }
+};
@@ -33,6 +33,8 @@
 void RENDERDOC_OutOfMemory(uint64_t sz);
 #endif
 
+class rdcstr;
+
 // special type for storing literals. This allows functions to force callers to pass them literals
 class rdcliteral
 {
@@ -41,6 +43,8 @@ class rdcliteral
 
   // make the literal operator a friend so it can construct fixed strings. No-one else can.
   friend rdcliteral operator"" _lit(const char *str, size_t len);
+  // the interned string table never frees its storage, so it can hand out fixed strings too.
+  friend rdcliteral strintern(const rdcstr &str);
 
   rdcliteral(const char *s, size_t l) : str(s), len(l) {}
   rdcliteral() = delete;
@@ -98,6 +98,13 @@ version of RenderDoc that addes a new section type. They should be considered eq
   This section contains any edited shaders.
 
   The name for this section will be "renderdoc/ui/edits".
+
+.. data:: CallstackTable
+
+  This section contains the callstacks referenced by chunks in the frame capture, deduplicated so
+  that each chunk only refers to its callstack by index.
+
+  The name for this section will be "renderdoc/internal/callstacks".
 )");
 enum class SectionType : uint32_t
 {
@@ -112,6 +119,7 @@ enum class SectionType : uint32_t
   ExtendedThumbnail,
   EmbeddedLogfile,
   EditedShaders,
+  CallstackTable,
   Count,
 };
 
@@ -3841,6 +3849,12 @@ DOCUMENT(R"(A set of flags describing the properties of a section in a renderdoc
 .. data:: ZstdCompressed
 
   This section is compressed with Zstd on disk.
+
+.. data:: ZstdBlockIndexed
+
+  This section is compressed with Zstd in independent blocks, with an index of the blocks stored
+  after the compressed data. This allows the section to be decompressed in parallel or from an
+  arbitrary offset. It is always set together with :data:`ZstdCompressed`.
 )");
 enum class SectionFlags : uint32_t
 {
@@ -3848,6 +3862,7 @@ enum class SectionFlags : uint32_t
   ASCIIStored = 0x1,
   LZ4Compressed = 0x2,
   ZstdCompressed = 0x4,
+  ZstdBlockIndexed = 0x8,
 };
 
 BITMASK_OPERATORS(SectionFlags);
@@ -144,6 +144,13 @@ DOCUMENT(R"(Bitfield flags that could be applied to a type.
 
   Special flag to indicate that this is structure is stored as a union, meaning all children share
   the same memory and some external flag indicates which element is valid.
+
+.. data:: LazyChildren
+
+  Internal flag for a :class:`SDChunk` whose children are decoded from the capture on demand. They
+  are decoded transparently the first time they are accessed through any of the accessors such as
+  :meth:`SDObject.NumChildren` or :meth:`SDObject.GetChild`, or when the chunk is passed to python.
+  The flag stays set once they have been decoded.
 )");
 enum class SDTypeFlags : uint32_t
 {
@@ -154,6 +161,7 @@ enum class SDTypeFlags : uint32_t
   NullString = 0x8,
   FixedArray = 0x10,
   Union = 0x20,
+  LazyChildren = 0x40,
 };
 
 BITMASK_OPERATORS(SDTypeFlags);
@@ -162,6 +170,23 @@ DECLARE_REFLECTION_ENUM(SDTypeFlags);
 struct SDObject;
 struct SDChunk;
 
+#if !defined(SWIG)
+// storage for chunks flagged with SDTypeFlags::LazyChildren, which decodes their children on
+// demand. This is implemented inside the library so that objects are allocated consistently, and
+// it tracks which chunks have been decoded itself so that chunks need no synchronisation.
+struct SDChunkStorage
+{
+  // decode the children of a lazy chunk if no other thread has yet. Thread-safe, and cheap once
+  // the children have been decoded.
+  virtual void Populate(SDChunk *chunk) = 0;
+  // release the reference held by a chunk, which must no longer be accessed through its storage
+  virtual void Release() = 0;
+
+protected:
+  virtual ~SDChunkStorage() = default;
+};
+#endif
+
 DOCUMENT("Details the name and properties of a structured type");
 struct SDType
 {
@@ -366,12 +391,36 @@ private:
 
 DECLARE_REFLECTION_STRUCT(SDObjectData);
 
-DOCUMENT("Defines a single structured object.");
-struct SDObject
+#if !defined(SWIG)
+// Objects are either allocated individually, or in bulk from an arena by the structured serialiser
+// to avoid a heap allocation per object. Every allocation is prefixed with a pointer to the arena
+// it came from (or NULL if it was allocated individually), with flags in the low bits.
+//
+// Objects in an arena aren't freed individually. Deleting one only destroys it, and each chunk in
+// the arena holds a reference on it. Once the last reference is gone, every object that's still
+// alive is destroyed in one pass over the arena's pages and then the pages are freed together.
+// Objects in an arena belong to the arena rather than their parent, so they must not be moved out
+// of structured data that outlives it - Duplicate() them instead.
+struct SDObjectArenaBase
+{
+  // implemented inside the library, so that arenas are freed consistently
+  void (*release)(SDObjectArenaBase *arena);
+};
+
+struct SDObjectAlloc
 {
+  // the size of the arena pointer before each object, keeping objects 8-byte aligned
+  static const size_t PrefixSize = sizeof(uint64_t);
+
+  // the object has been destroyed and must not be destroyed again when its arena is freed
+  static const uint64_t DeadFlag = 0x1;
+  // the object is a chunk, which holds a reference on its arena
+  static const uint64_t ChunkFlag = 0x2;
+  static const uint64_t FlagMask = 0x7;
+
   /////////////////////////////////////////////////////////////////
   // memory management, in a dll safe way
-  void *operator new(size_t sz)
+  static void *AllocateMem(size_t sz)
   {
     void *ret = NULL;
 #ifdef RENDERDOC_EXPORTS
@@ -383,7 +432,7 @@ struct SDObject
 #endif
     return ret;
   }
-  void operator delete(void *p)
+  static void FreeMem(void *p)
   {
 #ifdef RENDERDOC_EXPORTS
     free(p);
@@ -391,6 +440,48 @@ struct SDObject
     RENDERDOC_FreeArrayMem(p);
 #endif
   }
+
+  static uint64_t &Prefix(const void *p) { return *(uint64_t *)((byte *)p - PrefixSize); }
+  static bool InArena(const void *p) { return (Prefix(p) & ~FlagMask) != 0; }
+  static void *Allocate(size_t sz)
+  {
+    byte *ret = (byte *)AllocateMem(sz + PrefixSize);
+    *(uint64_t *)ret = 0;
+    return ret + PrefixSize;
+  }
+  static void Free(void *p)
+  {
+    if(p == NULL)
+      return;
+
+    uint64_t &prefix = Prefix(p);
+    if(prefix == 0)
+    {
+      FreeMem((byte *)p - PrefixSize);
+      return;
+    }
+
+    prefix |= DeadFlag;
+
+    if(prefix & ChunkFlag)
+    {
+      SDObjectArenaBase *arena = (SDObjectArenaBase *)(uintptr_t)(prefix & ~FlagMask);
+      arena->release(arena);
+    }
+  }
+};
+#endif
+
+DOCUMENT("Defines a single structured object.");
+struct SDObject
+{
+  /////////////////////////////////////////////////////////////////
+  // memory management, in a dll safe way. See SDObjectArenaBase
+  void *operator new(size_t sz) { return SDObjectAlloc::Allocate(sz); }
+  void operator delete(void *p) { SDObjectAlloc::Free(p); }
+  // placement new, for objects allocated in bulk by the serialiser
+  void *operator new(size_t, void *ptr) { return ptr; }
+  void operator delete(void *p, void *) {}
   void *operator new[](size_t count) = delete;
   void operator delete[](void *p) = delete;
 
@@ -404,9 +495,14 @@ struct SDObject
   DOCUMENT("Create a deep copy of this object.");
   SDObject *Duplicate() const
   {
+    PopulateChildren();
+
     SDObject *ret = new SDObject();
     ret->name = name;
     ret->type = type;
+#if !defined(SWIG)
+    ret->type.flags &= ~SDTypeFlags::LazyChildren;
+#endif
     ret->data.basic = data.basic;
     ret->data.str = data.str;
 
@@ -429,6 +525,9 @@ struct SDObject
   DOCUMENT("Checks if the given object has the same value as this one.");
   bool HasEqualValue(const SDObject *o) const
   {
+    PopulateChildren();
+    o->PopulateChildren();
+
     bool ret = true;
 
     if(data.str != o->data.str)
@@ -453,10 +552,15 @@ struct SDObject
   }
 
   DOCUMENT("Add a new child object by duplicating it.");
-  inline void AddChild(SDObject *child) { data.children.push_back(child->Duplicate()); }
+  inline void AddChild(SDObject *child)
+  {
+    PopulateChildren();
+    data.children.push_back(child->Duplicate());
+  }
   DOCUMENT("Find a child object by a given name.");
   inline SDObject *FindChild(const char *childName) const
   {
+    PopulateChildren();
     for(size_t i = 0; i < data.children.size(); i++)
       if(data.children[i]->name == childName)
         return data.children[i];
@@ -466,6 +570,7 @@ struct SDObject
   DOCUMENT("Get a child object at a given index.");
   inline SDObject *GetChild(size_t index) const
   {
+    PopulateChildren();
     if(index < data.children.size())
       return data.children[index];
     return NULL;
@@ -474,22 +579,58 @@ struct SDObject
   DOCUMENT("Delete all child objects.");
   inline void DeleteChildren()
   {
+    PopulateChildren();
     for(size_t i = 0; i < data.children.size(); i++)
+    {
+#if !defined(SWIG)
+      // children allocated in bulk are destroyed along with their arena
+      if(SDObjectAlloc::InArena(data.children[i]))
+        continue;
+#endif
       delete data.children[i];
+    }
 
     data.children.clear();
   }
 
   DOCUMENT("Get the number of child objects.");
-  inline size_t NumChildren() const { return data.children.size(); }
+  inline size_t NumChildren() const
+  {
+    PopulateChildren();
+    return data.children.size();
+  }
   DOCUMENT("Get a ``list`` of :class:`SDObject` children.");
-  inline StructuredObjectList &GetChildren() { return data.children; }
+  inline StructuredObjectList &GetChildren()
+  {
+    PopulateChildren();
+    return data.children;
+  }
 #if !defined(SWIG)
   // these are for C++ iteration so not defined when SWIG is generating interfaces
-  inline SDObject *const *begin() const { return data.children.begin(); }
-  inline SDObject *const *end() const { return data.children.end(); }
-  inline SDObject **begin() { return data.children.begin(); }
-  inline SDObject **end() { return data.children.end(); }
+  inline SDObject *const *begin() const
+  {
+    PopulateChildren();
+    return data.children.begin();
+  }
+  inline SDObject *const *end() const
+  {
+    PopulateChildren();
+    return data.children.end();
+  }
+  inline SDObject **begin()
+  {
+    PopulateChildren();
+    return data.children.begin();
+  }
+  inline SDObject **end()
+  {
+    PopulateChildren();
+    return data.children.end();
+  }
+
+  // if this is a chunk with lazy children, decode them. Any direct access to data.children must
+  // call this first, the accessors above do it automatically.
+  inline void PopulateChildren() const;
 #endif
 
 // C++ gets more extensive typecasts. We'll add a couple for python in the interface file
@@ -578,7 +719,11 @@ struct SDObject
     return this;
   }
 
-  void AddAndOwnChild(SDObject *child) { data.children.push_back(child); }
+  void AddAndOwnChild(SDObject *child)
+  {
+    PopulateChildren();
+    data.children.push_back(child);
+  }
 #endif
 
   // these are common to both python and C++
@@ -884,41 +1029,52 @@ DOCUMENT("Defines a single structured chunk, which is a :class:`SDObject`.");
 struct SDChunk : public SDObject
 {
   /////////////////////////////////////////////////////////////////
-  // memory management, in a dll safe way
-  void *operator new(size_t sz)
-  {
-    void *ret = NULL;
-#ifdef RENDERDOC_EXPORTS
-    ret = malloc(sz);
-    if(ret == NULL)
-      RENDERDOC_OutOfMemory(sz);
-#else
-    ret = RENDERDOC_AllocArrayMem(sz);
-#endif
-    return ret;
-  }
-  void operator delete(void *p)
-  {
-#ifdef RENDERDOC_EXPORTS
-    free(p);
-#else
-    RENDERDOC_FreeArrayMem(p);
-#endif
-  }
+  // memory management, in a dll safe way. See SDObjectArenaBase
+  void *operator new(size_t sz) { return SDObjectAlloc::Allocate(sz); }
+  void operator delete(void *p) { SDObjectAlloc::Free(p); }
+  // placement new, for chunks allocated in bulk by the serialiser
+  void *operator new(size_t, void *ptr) { return ptr; }
+  void operator delete(void *p, void *) {}
   void *operator new[](size_t count) = delete;
   void operator delete[](void *p) = delete;
 
   SDChunk(const char *name) : SDObject(name, "Chunk"_lit) { type.basetype = SDBasic::Chunk; }
+  SDChunk(const rdcliteral &name) : SDObject(name, "Chunk"_lit) { type.basetype = SDBasic::Chunk; }
+  ~SDChunk()
+  {
+#if !defined(SWIG)
+    // drop the storage without decoding any children that haven't been yet. Decoded children may
+    // be in an arena owned by the storage, so let go of them first.
+    if(storage)
+    {
+      type.flags &= ~SDTypeFlags::LazyChildren;
+      DeleteChildren();
+      storage->Release();
+    }
+#endif
+  }
   DOCUMENT("The :class:`SDChunkMetaData` with the metadata for this chunk.");
   SDChunkMetaData metadata;
 
+#if !defined(SWIG)
+  // the storage that decodes this chunk's children if it's flagged with LazyChildren, and this
+  // chunk's index in that storage. The storage stays referenced for the chunk's lifetime once set.
+  SDChunkStorage *storage = NULL;
+  uint32_t storageIndex = 0;
+#endif
+
   DOCUMENT("Create a deep copy of this chunk.");
   SDChunk *Duplicate() const
   {
+    PopulateChildren();
+
     SDChunk *ret = new SDChunk();
     ret->name = name;
     ret->metadata = metadata;
     ret->type = type;
+#if !defined(SWIG)
+    ret->type.flags &= ~SDTypeFlags::LazyChildren;
+#endif
     ret->data.basic = data.basic;
     ret->data.str = data.str;
 
@@ -937,6 +1093,18 @@ protected:
 
 DECLARE_REFLECTION_STRUCT(SDChunk);
 
+#if !defined(SWIG)
+inline void SDObject::PopulateChildren() const
+{
+  // the flag is only ever set on chunks, and never changes while the chunk is shared
+  if(type.flags & SDTypeFlags::LazyChildren)
+  {
+    SDChunk *chunk = (SDChunk *)this;
+    chunk->storage->Populate(chunk);
+  }
+}
+#endif
+
 DOCUMENT("A ``list`` of :class:`SDChunk` objects");
 struct StructuredChunkList : public rdcarray<SDChunk *>
 {
@@ -26,6 +26,9 @@
 #include "common.h"
 #include <stdarg.h>
 #include <string.h>
+#if ENABLED(RDOC_SSE2)
+#include <emmintrin.h>
+#endif
 #include "common/threading.h"
 #include "os/os_specific.h"
 #include "strings/string_utils.h"
@@ -178,6 +181,104 @@ bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &
   return diffStart < bufSize;
 }
 
+// compares 64 bytes at a and b, using unaligned loads as persistent maps can be offset from the
+// start of the allocation. Returns if they're equal or different
+static bool Vec64NotEqual(void *a, void *b)
+{
+#if ENABLED(RDOC_SSE2)
+  const __m128i *avec = (const __m128i *)a;
+  const __m128i *bvec = (const __m128i *)b;
+
+  __m128i diff01 =
+      _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(avec + 0), _mm_loadu_si128(bvec + 0)),
+                   _mm_xor_si128(_mm_loadu_si128(avec + 1), _mm_loadu_si128(bvec + 1)));
+  __m128i diff23 =
+      _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(avec + 2), _mm_loadu_si128(bvec + 2)),
+                   _mm_xor_si128(_mm_loadu_si128(avec + 3), _mm_loadu_si128(bvec + 3)));
+  __m128i diff = _mm_or_si128(diff01, diff23);
+
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xffff;
+#else
+  byte *a8 = (byte *)a;
+  byte *b8 = (byte *)b;
+
+  return Vec16NotEqual(a8, b8) || Vec16NotEqual(a8 + 16, b8 + 16) ||
+         Vec16NotEqual(a8 + 32, b8 + 32) || Vec16NotEqual(a8 + 48, b8 + 48);
+#endif
+}
+
+size_t FindDiffRanges(void *a, void *b, size_t bufSize, size_t mergeGap, DiffRange *ranges,
+                      size_t maxRanges)
+{
+  RDCASSERT(uintptr_t(a) % 16 == 0);
+  RDCASSERT(uintptr_t(b) % 16 == 0);
+
+  if(maxRanges == 0)
+    return 0;
+
+  byte *a8 = (byte *)a;
+  byte *b8 = (byte *)b;
+
+  size_t numRanges = 0;
+
+  // extends the current range to cover [start, end), or begins a new one if it's far enough away
+  auto addDiff = [&](size_t start, size_t end) {
+    if(numRanges > 0 && (start - ranges[numRanges - 1].end <= mergeGap || numRanges == maxRanges))
+    {
+      ranges[numRanges - 1].end = end;
+    }
+    else
+    {
+      ranges[numRanges].start = start;
+      ranges[numRanges].end = end;
+      numRanges++;
+    }
+  };
+
+  // sweep in large blocks, only checking each 16 bytes when the block contains a difference. Ranges
+  // are only 16-byte accurate at this point
+  const size_t blockSize = 64;
+  size_t offs = 0;
+
+  for(; offs + blockSize <= bufSize; offs += blockSize)
+  {
+    if(!Vec64NotEqual(a8 + offs, b8 + offs))
+      continue;
+
+    for(size_t v = offs; v < offs + blockSize; v += 16)
+    {
+      if(Vec16NotEqual(a8 + v, b8 + v))
+        addDiff(v, v + 16);
+    }
+  }
+
+  for(; offs < bufSize; offs++)
+  {
+    if(a8[offs] != b8[offs])
+      addDiff(offs, offs + 1);
+  }
+
+  // make sure we're byte-accurate, to comply with WRITE_NO_OVERWRITE. If the memory is being
+  // written concurrently a difference might have disappeared since, so remove any empty ranges.
+  size_t numValid = 0;
+
+  for(size_t r = 0; r < numRanges; r++)
+  {
+    DiffRange range = ranges[r];
+
+    while(range.start < range.end && a8[range.start] == b8[range.start])
+      range.start++;
+
+    while(range.end > range.start && a8[range.end - 1] == b8[range.end - 1])
+      range.end--;
+
+    if(range.end > range.start)
+      ranges[numValid++] = range;
+  }
+
+  return numValid;
+}
+
 uint32_t CalcNumMips(int w, int h, int d)
 {
   int mipLevels = 1;
@@ -502,3 +603,163 @@ void rdclog_direct(time_t utcTime, uint32_t pid, LogType type, const char *proje
 
   SAFE_DELETE_ARRAY(oversizedBuffer);
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Find diff ranges", "[diff]")
+{
+  const size_t bufSize = 256 * 1024 + 7;
+
+  byte *a = AllocAlignedBuffer(bufSize);
+  byte *b = AllocAlignedBuffer(bufSize);
+
+  memset(a, 0x5a, bufSize);
+  memset(b, 0x5a, bufSize);
+
+  DiffRange ranges[8];
+
+  SECTION("Identical buffers")
+  {
+    CHECK(FindDiffRanges(a, b, bufSize, 0, ranges, ARRAY_COUNT(ranges)) == 0);
+    CHECK(FindDiffRanges(a, b, 0, 0, ranges, ARRAY_COUNT(ranges)) == 0);
+  };
+
+  SECTION("Single byte differences are byte accurate")
+  {
+    for(size_t offs : {(size_t)0, (size_t)1, (size_t)15, (size_t)16, (size_t)63, (size_t)64,
+                       (size_t)1000, bufSize - 8, bufSize - 1})
+    {
+      b[offs] = 0;
+
+      REQUIRE(FindDiffRanges(a, b, bufSize, 0, ranges, ARRAY_COUNT(ranges)) == 1);
+      CHECK(ranges[0].start == offs);
+      CHECK(ranges[0].end == offs + 1);
+
+      b[offs] = 0x5a;
+    }
+  };
+
+  SECTION("Distant differences are separate ranges")
+  {
+    b[10] = 0;
+    b[20000] = 0;
+    b[20001] = 0;
+    b[bufSize - 1] = 0;
+
+    REQUIRE(FindDiffRanges(a, b, bufSize, 4096, ranges, ARRAY_COUNT(ranges)) == 3);
+    CHECK(ranges[0].start == 10);
+    CHECK(ranges[0].end == 11);
+    CHECK(ranges[1].start == 20000);
+    CHECK(ranges[1].end == 20002);
+    CHECK(ranges[2].start == bufSize - 1);
+    CHECK(ranges[2].end == bufSize);
+  };
+
+  SECTION("Nearby differences are merged")
+  {
+    b[100] = 0;
+    b[400] = 0;
+    b[5000] = 0;
+
+    REQUIRE(FindDiffRanges(a, b, bufSize, 1024, ranges, ARRAY_COUNT(ranges)) == 2);
+    CHECK(ranges[0].start == 100);
+    CHECK(ranges[0].end == 401);
+    CHECK(ranges[1].start == 5000);
+    CHECK(ranges[1].end == 5001);
+
+    REQUIRE(FindDiffRanges(a, b, bufSize, 0, ranges, ARRAY_COUNT(ranges)) == 3);
+    CHECK(ranges[0].start == 100);
+    CHECK(ranges[0].end == 101);
+  };
+
+  SECTION("Differences exactly mergeGap apart are merged")
+  {
+    // adjacent bytes in different 16-byte blocks, with no gap between them
+    b[111] = 0;
+    b[112] = 0;
+
+    REQUIRE(FindDiffRanges(a, b, bufSize, 0, ranges, ARRAY_COUNT(ranges)) == 1);
+    CHECK(ranges[0].start == 111);
+    CHECK(ranges[0].end == 113);
+  };
+
+  SECTION("Excess differences are folded into the last range")
+  {
+    for(size_t i = 0; i < 20; i++)
+      b[i * 10000] = 0;
+
+    REQUIRE(FindDiffRanges(a, b, bufSize, 0, ranges, 4) == 4);
+    CHECK(ranges[0].start == 0);
+    CHECK(ranges[0].end == 1);
+    CHECK(ranges[2].start == 20000);
+    CHECK(ranges[2].end == 20001);
+    CHECK(ranges[3].start == 30000);
+    CHECK(ranges[3].end == 190001);
+
+    CHECK(FindDiffRanges(a, b, bufSize, 0, ranges, 0) == 0);
+  };
+
+  SECTION("Ranges are within the single diff range")
+  {
+    for(size_t i = 0; i < 50; i++)
+      b[(i * 7919) % bufSize] ^= 0xff;
+
+    size_t diffStart = 0, diffEnd = 0;
+    REQUIRE(FindDiffRange(a, b, bufSize, diffStart, diffEnd));
+
+    size_t numRanges = FindDiffRanges(a, b, bufSize, 512, ranges, ARRAY_COUNT(ranges));
+    REQUIRE(numRanges > 0);
+
+    CHECK(ranges[0].start == diffStart);
+    CHECK(ranges[numRanges - 1].end == diffEnd);
+
+    for(size_t r = 1; r < numRanges; r++)
+      CHECK(ranges[r].start > ranges[r - 1].end + 512);
+  };
+
+  FreeAlignedBuffer(a);
+  FreeAlignedBuffer(b);
+};
+
+TEST_CASE("Benchmark diff ranges", "[diff][!benchmark]")
+{
+  const size_t bufSize = 64 * 1024 * 1024;
+
+  byte *a = AllocAlignedBuffer(bufSize);
+  byte *b = AllocAlignedBuffer(bufSize);
+
+  memset(a, 0, bufSize);
+  memset(b, 0, bufSize);
+
+  // a few sparse writes spread over the buffer, like a ring of per-draw constants
+  for(size_t i = 0; i < 16; i++)
+    b[i * (bufSize / 16) + 256] = 1;
+
+  size_t diffStart = 0, diffEnd = 0;
+  DiffRange ranges[MaxMapDiffRanges];
+  size_t numRanges = 0;
+
+  BENCHMARK("Single diff range")
+  {
+    FindDiffRange(a, b, bufSize, diffStart, diffEnd);
+  }
+
+  BENCHMARK("Multiple diff ranges")
+  {
+    numRanges = FindDiffRanges(a, b, bufSize, 4096, ranges, ARRAY_COUNT(ranges));
+  }
+
+  size_t multiBytes = 0;
+  for(size_t r = 0; r < numRanges; r++)
+    multiBytes += ranges[r].end - ranges[r].start;
+
+  RDCLOG("Single range captures %llu bytes, %llu ranges capture %llu bytes",
+         uint64_t(diffEnd - diffStart), uint64_t(numRanges), uint64_t(multiBytes));
+
+  FreeAlignedBuffer(a);
+  FreeAlignedBuffer(b);
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -285,6 +285,23 @@ inline T AlignUpPtr(T x, A a)
   (((uint32_t)(d) << 24) | ((uint32_t)(c) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(a))
 
 bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &diffEnd);
+
+struct DiffRange
+{
+  size_t start;
+  size_t end;
+};
+
+// finds every range of bytes that differs between a and b, unlike FindDiffRange which returns one
+// range spanning the first and last difference. Differences at most mergeGap bytes apart are
+// merged into one range, and if there are more than maxRanges the last range covers all remaining
+// differences. Returns the number of ranges written.
+size_t FindDiffRanges(void *a, void *b, size_t bufSize, size_t mergeGap, DiffRange *ranges,
+                      size_t maxRanges);
+
+// the maximum number of separate ranges drivers write when flushing changes to mapped memory
+static const size_t MaxMapDiffRanges = 32;
+
 uint32_t CalcNumMips(int Width, int Height, int Depth);
 
 typedef uint8_t byte;
@@ -0,0 +1,302 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common/threading.h"
+
+namespace Threading
+{
+namespace JobSystem
+{
+struct Job
+{
+  std::function<void()> callback;
+
+  // intrusive links in the pending queue, only valid while the job is queued
+  Job *prev = NULL;
+  Job *next = NULL;
+  bool queued = false;
+
+  // woken once the job has finished executing on a worker
+  Semaphore *done = NULL;
+};
+
+// All state is allocated on first use rather than being a static object, since the job system may
+// be shut down from RenderDoc's destructor which can run after static objects in this file have
+// been destroyed.
+struct JobSystemState
+{
+  // the queue of jobs that haven't been picked up yet, protected by queueLock
+  CriticalSection queueLock;
+  Job *queueHead = NULL;
+  Job *queueTail = NULL;
+
+  // workers block on this, it's woken once per job added
+  Semaphore *workAvailable = NULL;
+  rdcarray<ThreadHandle> workers;
+  bool shuttingDown = false;
+};
+
+static SpinLock stateLock;
+static JobSystemState *state = NULL;
+
+// must be called with queueLock held
+static void Unlink(Job *job)
+{
+  if(job->prev)
+    job->prev->next = job->next;
+  else
+    state->queueHead = job->next;
+
+  if(job->next)
+    job->next->prev = job->prev;
+  else
+    state->queueTail = job->prev;
+
+  job->prev = job->next = NULL;
+  job->queued = false;
+}
+
+static void WorkerThread()
+{
+  SetCurrentThreadName("RenderDoc job worker");
+
+  JobSystemState *s = state;
+
+  for(;;)
+  {
+    s->workAvailable->WaitForWake();
+
+    Job *job = NULL;
+    {
+      SCOPED_LOCK(s->queueLock);
+
+      if(s->shuttingDown)
+        return;
+
+      // the job we were woken for may have been executed inline by a sync, in which case there's
+      // nothing for us to do.
+      job = s->queueHead;
+      if(job)
+        Unlink(job);
+    }
+
+    if(job)
+    {
+      job->callback();
+      job->done->Wake(1);
+    }
+  }
+}
+
+static JobSystemState *GetState()
+{
+  SCOPED_SPINLOCK(stateLock);
+
+  if(state)
+    return state;
+
+  state = new JobSystemState;
+
+  // leave one core for the thread adding jobs, which will typically be consuming the results.
+  uint32_t numWorkers = RDCMIN(NumberOfCores() - 1, 32U);
+
+  state->workAvailable = Semaphore::Create();
+
+  for(uint32_t i = 0; i < numWorkers; i++)
+  {
+    ThreadHandle t = CreateThread(&WorkerThread);
+    if(t)
+      state->workers.push_back(t);
+  }
+
+  RDCDEBUG("Job system initialised with %zu workers", state->workers.size());
+
+  return state;
+}
+
+void Shutdown()
+{
+  SCOPED_SPINLOCK(stateLock);
+
+  if(!state)
+    return;
+
+  {
+    SCOPED_LOCK(state->queueLock);
+
+    RDCASSERTMSG("Job system shutting down with outstanding jobs", state->queueHead == NULL);
+
+    state->shuttingDown = true;
+  }
+
+  state->workAvailable->Wake((uint32_t)state->workers.size());
+
+  for(ThreadHandle t : state->workers)
+  {
+    JoinThread(t);
+    CloseThread(t);
+  }
+
+  state->workAvailable->Destroy();
+
+  delete state;
+  state = NULL;
+}
+
+uint32_t NumWorkers()
+{
+  return (uint32_t)GetState()->workers.size();
+}
+
+Job *AddJob(std::function<void()> callback)
+{
+  JobSystemState *s = GetState();
+
+  Job *job = new Job;
+  job->callback = callback;
+  job->done = Semaphore::Create();
+
+  // with no workers the job will be executed whenever it's synced
+  if(s->workers.empty())
+    return job;
+
+  {
+    SCOPED_LOCK(s->queueLock);
+
+    job->queued = true;
+    job->prev = s->queueTail;
+    if(s->queueTail)
+      s->queueTail->next = job;
+    else
+      s->queueHead = job;
+    s->queueTail = job;
+  }
+
+  s->workAvailable->Wake(1);
+
+  return job;
+}
+
+void SyncJob(Job *job)
+{
+  if(!job)
+    return;
+
+  JobSystemState *s = GetState();
+
+  bool runInline = s->workers.empty();
+
+  if(!runInline)
+  {
+    SCOPED_LOCK(s->queueLock);
+
+    // if no worker has taken this job yet, take it ourselves rather than waiting for it to reach
+    // the front of the queue. The spare wake on workAvailable is harmless.
+    if(job->queued)
+    {
+      Unlink(job);
+      runInline = true;
+    }
+  }
+
+  if(runInline)
+    job->callback();
+  else
+    job->done->WaitForWake();
+
+  job->done->Destroy();
+  delete job;
+}
+
+void SyncJobs(rdcarray<Job *> &jobs)
+{
+  for(Job *job : jobs)
+    SyncJob(job);
+  jobs.clear();
+}
+};
+};
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test job system", "[threading]")
+{
+  SECTION("All jobs execute exactly once")
+  {
+    const int numJobs = 500;
+
+    rdcarray<int32_t> counts;
+    counts.resize(numJobs);
+
+    rdcarray<Threading::JobSystem::Job *> jobs;
+
+    for(int i = 0; i < numJobs; i++)
+    {
+      int32_t *count = &counts[i];
+      jobs.push_back(Threading::JobSystem::AddJob([count]() { Atomic::Inc32(count); }));
+    }
+
+    Threading::JobSystem::SyncJobs(jobs);
+
+    CHECK(jobs.empty());
+
+    for(int i = 0; i < numJobs; i++)
+    {
+      CHECK(counts[i] == 1);
+    }
+  };
+
+  SECTION("Synced job results are visible")
+  {
+    rdcarray<uint64_t> results;
+    results.resize(64);
+
+    rdcarray<Threading::JobSystem::Job *> jobs;
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+      uint64_t *result = &results[i];
+      jobs.push_back(Threading::JobSystem::AddJob([result, i]() {
+        uint64_t sum = 0;
+        for(uint64_t x = 0; x <= i * 1000; x++)
+          sum += x;
+        *result = sum;
+      }));
+    }
+
+    // sync in reverse order to exercise syncing jobs that are still queued
+    for(size_t i = jobs.size(); i > 0; i--)
+      Threading::JobSystem::SyncJob(jobs[i - 1]);
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+      uint64_t n = i * 1000;
+      CHECK(results[i] == n * (n + 1) / 2);
+    }
+  };
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
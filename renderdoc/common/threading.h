@@ -110,6 +110,30 @@ public:
 private:
   SpinLock *m_Spin = NULL;
 };
+
+// A small pool of worker threads for farming out independent pieces of work, e.g. compressing
+// blocks of a capture file. Workers are created lazily the first time a job is added so that
+// processes which never need them don't pay for idle threads.
+namespace JobSystem
+{
+struct Job;
+
+void Shutdown();
+
+// the number of worker threads available to process jobs, may be 0 on single-core machines. In
+// that case jobs are executed when they are synced.
+uint32_t NumWorkers();
+
+// queues a job for execution on a worker thread
+Job *AddJob(std::function<void()> callback);
+
+// waits for the given job to complete, then frees it. If the job hasn't been picked up by a
+// worker yet, it is executed on the calling thread instead of waiting.
+void SyncJob(Job *job);
+
+// waits for all of the given jobs to complete, in order, then frees them.
+void SyncJobs(rdcarray<Job *> &jobs);
+};
 };
 
 #define SCOPED_LOCK(cs) Threading::ScopedLock CONCAT(scopedlock, __LINE__)(&cs);
@@ -48,6 +48,14 @@
 RDOC_DEBUG_CONFIG(bool, Capture_Debug_SnapshotDiagnosticLog, false,
                   "Snapshot the diagnostic log at capture time and embed in the capture.");
 
+RDOC_CONFIG(bool, Capture_BackgroundFileWriting, false,
+            "Compress and write capture files to disk on a background thread, so that the "
+            "application can continue as soon as the frame has been serialised in memory.");
+
+RDOC_CONFIG(uint32_t, Capture_MapDiffMergeGap, 4096,
+            "When only the changed parts of persistently mapped memory are captured, changes "
+            "no more than this many bytes apart are captured as one region.");
+
 void LogReplayOptions(const ReplayOptions &opts)
 {
   RDCLOG("%s API validation during replay", (opts.apiValidation ? "Enabling" : "Not enabling"));
@@ -470,6 +478,8 @@ void RenderDoc::Initialise()
 
 RenderDoc::~RenderDoc()
 {
+  SyncCaptureWriteThread();
+
   if(m_ExHandler)
   {
     UnloadCrashHandler();
@@ -512,6 +522,8 @@ RenderDoc::~RenderDoc()
 
   Network::Shutdown();
 
+  Threading::JobSystem::Shutdown();
+
   Threading::Shutdown();
 
   StringFormat::Shutdown();
@@ -664,6 +676,7 @@ void RenderDoc::InitialiseReplay(GlobalEnvironment env, const rdcarray<rdcstr> &
 void RenderDoc::ShutdownReplay()
 {
   SyncAvailableGPUThread();
+  SyncCaptureWriteThread();
 
   // call shutdown functions early, as we only want to do these in the RenderDoc destructor if we
   // have no other choice (i.e. we're capturing).
@@ -754,6 +767,10 @@ void RenderDoc::StartFrameCapture(void *dev, void *wnd)
   IFrameCapturer *frameCap = MatchFrameCapturer(dev, wnd);
   if(frameCap)
   {
+    // each capture interns its callstacks into a new table
+    if(m_CapturesActive == 0)
+      CallstackTable::BeginCapture();
+
     frameCap->StartFrameCapture(dev, wnd);
     m_CapturesActive++;
   }
@@ -780,6 +797,8 @@ bool RenderDoc::EndFrameCapture(void *dev, void *wnd)
   {
     bool ret = frameCap->EndFrameCapture(dev, wnd);
     m_CapturesActive--;
+    if(m_CapturesActive == 0)
+      CallstackTable::EndCapture();
     return ret;
   }
   return false;
@@ -792,6 +811,8 @@ bool RenderDoc::DiscardFrameCapture(void *dev, void *wnd)
   {
     bool ret = frameCap->DiscardFrameCapture(dev, wnd);
     m_CapturesActive--;
+    if(m_CapturesActive == 0)
+      CallstackTable::EndCapture();
     return ret;
   }
   return false;
@@ -1260,6 +1281,14 @@ void RenderDoc::RegisterStructuredProcessor(RDCDriver driver, StructuredProcesso
   m_StructProcesssors[driver] = provider;
 }
 
+void RenderDoc::RegisterStructuredChunkDecoder(RDCDriver driver,
+                                               StructuredChunkDecoderProvider provider)
+{
+  RDCASSERT(m_StructDecoders.find(driver) == m_StructDecoders.end());
+
+  m_StructDecoders[driver] = provider;
+}
+
 void RenderDoc::RegisterCaptureExporter(CaptureExporter exporter, CaptureFileFormat description)
 {
   rdcstr filetype = description.extension;
@@ -1324,6 +1353,28 @@ StructuredProcessor RenderDoc::GetStructuredProcessor(RDCDriver driver)
   return it->second;
 }
 
+StructuredChunkDecoderProvider RenderDoc::GetStructuredChunkDecoder(RDCDriver driver)
+{
+  auto it = m_StructDecoders.find(driver);
+
+  if(it == m_StructDecoders.end())
+    return NULL;
+
+  return it->second;
+}
+
+void RenderDoc::RegisterCaptureStreamExporter(const rdcstr &filetype,
+                                              CaptureStreamExporter exporter)
+{
+  if(m_StreamExporters.find(filetype) != m_StreamExporters.end())
+  {
+    RDCERR("Duplicate stream exporter for '%s' found", filetype.c_str());
+    return;
+  }
+
+  m_StreamExporters[filetype] = exporter;
+}
+
 CaptureExporter RenderDoc::GetCaptureExporter(const char *filetype)
 {
   if(!filetype)
@@ -1337,6 +1388,19 @@ CaptureExporter RenderDoc::GetCaptureExporter(const char *filetype)
   return it->second;
 }
 
+CaptureStreamExporter RenderDoc::GetCaptureStreamExporter(const char *filetype)
+{
+  if(!filetype)
+    return NULL;
+
+  auto it = m_StreamExporters.find(filetype);
+
+  if(it == m_StreamExporters.end())
+    return NULL;
+
+  return it->second;
+}
+
 CaptureImporter RenderDoc::GetCaptureImporter(const char *filetype)
 {
   if(!filetype)
@@ -1642,10 +1706,93 @@ void RenderDoc::FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber)
 {
   RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 0.0f);
 
+  CallstackTable *callstacks = CallstackTable::GetCapture();
+
+  WriteCaptureFileSections(rdc, frameNumber, m_Options, callstacks, m_CaptureCallstackIDs);
+
+  if(callstacks)
+    callstacks->Release();
+
+  m_CaptureCallstackIDs.clear();
+}
+
+void RenderDoc::FinishCaptureWritingAsync(RDCDriver driver, uint32_t frameNumber, FramePixels &fp,
+                                          const SectionProperties &props, StreamWriter *frameData)
+{
+  // only write one capture at a time, as choosing the filename and m_CurrentLogFile aren't
+  // thread-safe. This only blocks if captures are made faster than they can be written.
+  SyncCaptureWriteThread();
+
+  RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 0.0f);
+
+  // take ownership of the pixel data so the caller can go on without waiting for the thumbnail
+  FramePixels *pixels = new FramePixels(fp);
+  fp.data = NULL;
+
+  // the next capture can start referencing callstacks, in its own table, while this one is written
+  rdchashset<uint32_t> *callstackIDs = new rdchashset<uint32_t>();
+  callstackIDs->swap(m_CaptureCallstackIDs);
+  CallstackTable *callstacks = CallstackTable::GetCapture();
+
+  // the file is written with the options the frame was captured with, even if they change before
+  // the thread is done
+  const CaptureOptions opts = m_Options;
+
+  m_CaptureWriteThread = Threading::CreateThread([this, driver, frameNumber, pixels, props,
+                                                  frameData, callstacks, callstackIDs, opts]() {
+    RDCFile *rdc = CreateRDC(driver, frameNumber, *pixels);
+
+    delete pixels;
+
+    if(rdc)
+    {
+      StreamWriter *w = rdc->WriteSection(props);
+
+      const byte *data = frameData->GetData();
+      const uint64_t size = frameData->GetOffset();
+
+      // write in blocks so we can report progress while compressing
+      const uint64_t blockSize = 4 * 1024 * 1024;
+
+      for(uint64_t offs = 0; offs < size; offs += blockSize)
+      {
+        RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, float(offs) / float(size));
+        w->Write(data + offs, RDCMIN(blockSize, size - offs));
+      }
+
+      w->Finish();
+
+      delete w;
+    }
+
+    delete frameData;
+
+    WriteCaptureFileSections(rdc, frameNumber, opts, callstacks, *callstackIDs);
+
+    if(callstacks)
+      callstacks->Release();
+    delete callstackIDs;
+  });
+}
+
+void RenderDoc::SyncCaptureWriteThread()
+{
+  if(m_CaptureWriteThread)
+  {
+    Threading::JoinThread(m_CaptureWriteThread);
+    Threading::CloseThread(m_CaptureWriteThread);
+    m_CaptureWriteThread = 0;
+  }
+}
+
+void RenderDoc::WriteCaptureFileSections(RDCFile *rdc, uint32_t frameNumber,
+                                         const CaptureOptions &opts, CallstackTable *callstacks,
+                                         const rdchashset<uint32_t> &callstackIDs)
+{
   if(rdc)
   {
     // add the resolve database if we were capturing callstacks.
-    if(m_Options.captureCallstacks)
+    if(opts.captureCallstacks)
     {
       SectionProperties props = {};
       props.type = SectionType::ResolveDatabase;
@@ -1660,6 +1807,26 @@ void RenderDoc::FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber)
 
       w->Write(buf, sz);
 
+      delete[] buf;
+
+      w->Finish();
+
+      delete w;
+    }
+
+    // chunks refer to their callstacks in this table
+    if(opts.captureCallstacks && callstacks)
+    {
+      SectionProperties props = {};
+      props.type = SectionType::CallstackTable;
+      props.version = 1;
+      props.flags = SectionFlags::LZ4Compressed;
+      StreamWriter *w = rdc->WriteSection(props);
+
+      // only the callstacks this capture refers to, chunks from earlier captures were remapped into
+      // this table as they were written
+      callstacks->Write(w, callstackIDs);
+
       w->Finish();
 
       delete w;
@@ -32,6 +32,7 @@
 #include "api/replay/apidefs.h"
 #include "api/replay/capture_options.h"
 #include "api/replay/control_types.h"
+#include "api/replay/rdchashmap.h"
 #include "api/replay/stringise.h"
 #include "common/timing.h"
 #include "os/os_specific.h"
@@ -51,8 +52,12 @@ class IRemoteDriver;
 class IReplayDriver;
 
 class StreamReader;
+class StreamWriter;
 class RDCFile;
+class CallstackTable;
 struct SDFile;
+class IStructuredChunkDecoder;
+struct SectionProperties;
 enum class VulkanLayerFlags : uint32_t;
 
 namespace Callstack
@@ -329,12 +334,19 @@ typedef ReplayStatus (*ReplayDriverProvider)(RDCFile *rdc, const ReplayOptions &
                                              IReplayDriver **driver);
 
 typedef void (*StructuredProcessor)(RDCFile *rdc, SDFile &structData);
+// creates a decoder for single chunks of a capture, so that its structured data can be decoded
+// lazily. See ReadLazyStructuredFile
+typedef IStructuredChunkDecoder *(*StructuredChunkDecoderProvider)(RDCFile *rdc);
 
 typedef ReplayStatus (*CaptureImporter)(const char *filename, StreamReader &reader, RDCFile *rdc,
                                         SDFile &structData, RENDERDOC_ProgressCallback progress);
 typedef ReplayStatus (*CaptureExporter)(const char *filename, const RDCFile &rdc,
                                         const SDFile &structData,
                                         RENDERDOC_ProgressCallback progress);
+// converts a capture directly from its frame capture section, writing structured data out as it's
+// read rather than needing the whole structured file first
+typedef ReplayStatus (*CaptureStreamExporter)(const char *filename, RDCFile *rdc,
+                                              RENDERDOC_ProgressCallback progress);
 typedef IDeviceProtocolHandler *(*ProtocolHandler)();
 
 typedef bool (*VulkanLayerCheck)(VulkanLayerFlags &flags, rdcarray<rdcstr> &myJSONs,
@@ -444,6 +456,17 @@ public:
   RDCFile *CreateRDC(RDCDriver driver, uint32_t frameNum, const FramePixels &fp);
   void FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber);
 
+  // the IDs of the callstacks referenced by the capture being written, so that its callstack table
+  // only contains those. Drivers point their capture file serialiser at this set.
+  rdchashset<uint32_t> &GetCaptureCallstackIDs() { return m_CaptureCallstackIDs; }
+
+  // creates the capture file and writes it out on a background thread. frameData holds the
+  // already-serialised frame capture section and ownership of it passes to this function, as does
+  // ownership of fp's pixel data.
+  void FinishCaptureWritingAsync(RDCDriver driver, uint32_t frameNumber, FramePixels &fp,
+                                 const SectionProperties &props, StreamWriter *frameData);
+  void SyncCaptureWriteThread();
+
   void AddChildProcess(uint32_t pid, uint32_t ident);
   rdcarray<rdcpair<uint32_t, uint32_t>> GetChildProcesses();
 
@@ -458,16 +481,20 @@ public:
   void RegisterRemoteProvider(RDCDriver driver, RemoteDriverProvider provider);
 
   void RegisterStructuredProcessor(RDCDriver driver, StructuredProcessor provider);
+  void RegisterStructuredChunkDecoder(RDCDriver driver, StructuredChunkDecoderProvider provider);
 
   void RegisterCaptureExporter(CaptureExporter exporter, CaptureFileFormat description);
   void RegisterCaptureImportExporter(CaptureImporter importer, CaptureExporter exporter,
                                      CaptureFileFormat description);
+  void RegisterCaptureStreamExporter(const rdcstr &filetype, CaptureStreamExporter exporter);
   void RegisterDeviceProtocol(const rdcstr &protocol, ProtocolHandler handler);
 
   StructuredProcessor GetStructuredProcessor(RDCDriver driver);
+  StructuredChunkDecoderProvider GetStructuredChunkDecoder(RDCDriver driver);
 
   CaptureExporter GetCaptureExporter(const char *filetype);
   CaptureImporter GetCaptureImporter(const char *filetype);
+  CaptureStreamExporter GetCaptureStreamExporter(const char *filetype);
 
   rdcarray<rdcstr> GetSupportedDeviceProtocols();
   IDeviceProtocolHandler *GetDeviceProtocol(const rdcstr &protocol);
@@ -584,6 +611,9 @@ private:
   ~RenderDoc();
 
   void SyncAvailableGPUThread();
+  void WriteCaptureFileSections(RDCFile *rdc, uint32_t frameNumber, const CaptureOptions &opts,
+                                CallstackTable *callstacks,
+                                const rdchashset<uint32_t> &callstackIDs);
 
   static RenderDoc *m_Inst;
 
@@ -608,6 +638,8 @@ private:
   CaptureOptions m_Options;
   uint32_t m_Overlay;
 
+  rdchashset<uint32_t> m_CaptureCallstackIDs;
+
   rdcarray<uint32_t> m_QueuedFrameCaptures;
 
   uint32_t m_RemoteIdent;
@@ -618,6 +650,7 @@ private:
   std::map<RDCDriver, uint64_t> m_ActiveDrivers;
 
   Threading::ThreadHandle m_AvailableGPUThread = 0;
+  Threading::ThreadHandle m_CaptureWriteThread = 0;
   rdcarray<GPUDevice> m_AvailableGPUs;
 
   std::map<rdcstr, RENDERDOC_ProgressCallback> m_ProgressCallbacks;
@@ -633,10 +666,12 @@ private:
   std::map<RDCDriver, RemoteDriverProvider> m_RemoteDriverProviders;
 
   std::map<RDCDriver, StructuredProcessor> m_StructProcesssors;
+  std::map<RDCDriver, StructuredChunkDecoderProvider> m_StructDecoders;
 
   rdcarray<CaptureFileFormat> m_ImportExportFormats;
   std::map<rdcstr, CaptureImporter> m_Importers;
   std::map<rdcstr, CaptureExporter> m_Exporters;
+  std::map<rdcstr, CaptureStreamExporter> m_StreamExporters;
 
   std::map<rdcstr, ProtocolHandler> m_Protocols;
 
@@ -731,6 +766,12 @@ struct StructuredProcessRegistration
   {
     RenderDoc::Inst().RegisterStructuredProcessor(driver, provider);
   }
+  StructuredProcessRegistration(RDCDriver driver, StructuredProcessor provider,
+                                StructuredChunkDecoderProvider decoder)
+  {
+    RenderDoc::Inst().RegisterStructuredProcessor(driver, provider);
+    RenderDoc::Inst().RegisterStructuredChunkDecoder(driver, decoder);
+  }
 };
 
 struct ConversionRegistration
@@ -740,10 +781,22 @@ struct ConversionRegistration
   {
     RenderDoc::Inst().RegisterCaptureImportExporter(importer, exporter, description);
   }
+  ConversionRegistration(CaptureImporter importer, CaptureExporter exporter,
+                         CaptureStreamExporter streamExporter, CaptureFileFormat description)
+  {
+    RenderDoc::Inst().RegisterCaptureImportExporter(importer, exporter, description);
+    RenderDoc::Inst().RegisterCaptureStreamExporter(description.extension, streamExporter);
+  }
   ConversionRegistration(CaptureExporter exporter, CaptureFileFormat description)
   {
     RenderDoc::Inst().RegisterCaptureExporter(exporter, description);
   }
+  ConversionRegistration(CaptureExporter exporter, CaptureStreamExporter streamExporter,
+                         CaptureFileFormat description)
+  {
+    RenderDoc::Inst().RegisterCaptureExporter(exporter, description);
+    RenderDoc::Inst().RegisterCaptureStreamExporter(description.extension, streamExporter);
+  }
 };
 
 struct DeviceProtocolRegistration
@@ -36,11 +36,18 @@
 #include "serialise/rdcfile.h"
 #include "serialise/serialiser.h"
 #include "strings/string_utils.h"
+#include "lz4/lz4.h"
+#include "zstd/zstd.h"
 #include "replay_proxy.h"
 
 RDOC_CONFIG(uint32_t, RemoteServer_TimeoutMS, 5000,
             "Timeout in milliseconds for remote server operations.");
 
+RDOC_CONFIG(uint32_t, RemoteServer_TransferCompression, 1,
+            "How captures are compressed when copying them to or from a remote server. 0 sends "
+            "them uncompressed, 1 uses LZ4 which is best on fast local networks, and 2 uses zstd "
+            "which is slower to compress but sends less data over slow links.");
+
 RDOC_CONFIG(bool, RemoteServer_DebugLogging, false,
             "Output a verbose logging file in the system's temporary folder containing the "
             "traffic to and from the remote server.");
@@ -136,6 +143,374 @@ rdcstr GetRemoteServerChunkName(uint32_t idx)
   return ToStr((ReplayProxyPacket)idx);
 }
 
+enum class TransferCompression : uint32_t
+{
+  None = 0,
+  LZ4 = 1,
+  ZSTD = 2,
+  Count,
+  // sent in place of a block if the sender can't continue
+  Abort = ~0U,
+};
+
+// captures are copied in independently compressed blocks. Blocks are compressed or decompressed on
+// worker threads while others are being sent or received, and an interrupted copy of the same
+// file resumes from the last block that the receiver has written.
+static const uint64_t TransferBlockSize = 4 * 1024 * 1024;
+
+struct TransferBlock
+{
+  TransferBlock()
+  {
+    data.resize((size_t)TransferBlockSize);
+    packed.resize(RDCMAX((size_t)LZ4_compressBound((int)TransferBlockSize),
+                         ZSTD_compressBound((size_t)TransferBlockSize)));
+  }
+  ~TransferBlock()
+  {
+    ZSTD_freeCCtx(cctx);
+    ZSTD_freeDCtx(dctx);
+  }
+
+  bytebuf data;
+  bytebuf packed;
+  uint32_t dataSize = 0;
+  uint32_t packedSize = 0;
+  TransferCompression compression = TransferCompression::None;
+  bool success = true;
+
+  ZSTD_CCtx *cctx = NULL;
+  ZSTD_DCtx *dctx = NULL;
+
+  Threading::JobSystem::Job *job = NULL;
+};
+
+// a ring of blocks in flight
+struct TransferPipeline
+{
+  TransferPipeline()
+  {
+    // each block holds 8MB or so, so don't scale without bound with the number of workers
+    blocks.resize(RDCMIN(RDCMAX(Threading::JobSystem::NumWorkers(), 1U) + 1, 8U));
+    for(TransferBlock *&b : blocks)
+      b = new TransferBlock;
+  }
+  ~TransferPipeline()
+  {
+    for(TransferBlock *b : blocks)
+    {
+      Threading::JobSystem::SyncJob(b->job);
+      delete b;
+    }
+  }
+
+  TransferBlock *operator[](uint64_t idx) { return blocks[idx % blocks.size()]; }
+  uint64_t size() const { return blocks.size(); }
+  rdcarray<TransferBlock *> blocks;
+};
+
+static uint64_t NumTransferBlocks(uint64_t fileSize)
+{
+  return (fileSize + TransferBlockSize - 1) / TransferBlockSize;
+}
+
+static uint32_t TransferBlockDataSize(uint64_t fileSize, uint64_t block)
+{
+  return (uint32_t)RDCMIN(TransferBlockSize, fileSize - block * TransferBlockSize);
+}
+
+// identifies a file so that a partial copy of it can be resumed
+static uint64_t GetTransferIdentity(const rdcstr &path, uint64_t fileSize)
+{
+  rdcstr key = StringFormat::Fmt("%s|%llu|%llu", path.c_str(), fileSize,
+                                 FileIO::GetModifiedTimestamp(path));
+
+  return (uint64_t(strhash(key.c_str())) << 32) | strhash(key.c_str(), 0x9e3779b9);
+}
+
+static void CompressTransferBlock(TransferBlock *b)
+{
+  size_t size = 0;
+
+  if(b->compression == TransferCompression::LZ4)
+  {
+    int ret = LZ4_compress_default((const char *)b->data.data(), (char *)b->packed.data(),
+                                   (int)b->dataSize, (int)b->packed.size());
+    if(ret > 0)
+      size = (size_t)ret;
+  }
+  else if(b->compression == TransferCompression::ZSTD)
+  {
+    if(!b->cctx)
+      b->cctx = ZSTD_createCCtx();
+
+    size_t ret = ZSTD_compressCCtx(b->cctx, b->packed.data(), b->packed.size(), b->data.data(),
+                                   b->dataSize, 3);
+    if(!ZSTD_isError(ret))
+      size = ret;
+  }
+
+  // blocks that don't compress (or failed to) are sent as-is
+  if(size == 0 || size >= b->dataSize)
+  {
+    b->compression = TransferCompression::None;
+    size = b->dataSize;
+  }
+
+  b->packedSize = (uint32_t)size;
+}
+
+static void DecompressTransferBlock(TransferBlock *b)
+{
+  size_t size = 0;
+
+  if(b->compression == TransferCompression::LZ4)
+  {
+    int ret = LZ4_decompress_safe((const char *)b->packed.data(), (char *)b->data.data(),
+                                  (int)b->packedSize, (int)b->dataSize);
+    if(ret > 0)
+      size = (size_t)ret;
+  }
+  else if(b->compression == TransferCompression::ZSTD)
+  {
+    if(!b->dctx)
+      b->dctx = ZSTD_createDCtx();
+
+    size_t ret =
+        ZSTD_decompressDCtx(b->dctx, b->data.data(), b->dataSize, b->packed.data(), b->packedSize);
+    if(!ZSTD_isError(ret))
+      size = ret;
+  }
+
+  b->success = (size == b->dataSize);
+}
+
+// sends the file from firstBlock onwards. The receiver must be expecting every remaining block.
+static bool SendFileBlocks(StreamWriter *writer, FILE *file, uint64_t fileSize, uint64_t firstBlock,
+                           TransferCompression compression, RENDERDOC_ProgressCallback progress)
+{
+  const uint64_t numBlocks = NumTransferBlocks(fileSize);
+
+  if(compression >= TransferCompression::Count)
+    compression = TransferCompression::LZ4;
+
+  if(firstBlock < numBlocks)
+    FileIO::fseek64(file, firstBlock * TransferBlockSize, SEEK_SET);
+
+  TransferPipeline pipeline;
+
+  uint64_t submitted = firstBlock;
+
+  for(uint64_t retired = firstBlock; retired < numBlocks; retired++)
+  {
+    // read ahead and compress as many blocks as we have room for while earlier ones are sent
+    while(submitted < numBlocks && submitted - retired < pipeline.size())
+    {
+      TransferBlock *b = pipeline[submitted];
+      b->dataSize = TransferBlockDataSize(fileSize, submitted);
+
+      if(FileIO::fread(b->data.data(), 1, b->dataSize, file) != b->dataSize)
+      {
+        RDCERR("Error reading block %llu of file to send", submitted);
+
+        TransferCompression abort = TransferCompression::Abort;
+        writer->Write(abort);
+        return false;
+      }
+
+      b->compression = compression;
+      if(compression != TransferCompression::None)
+        b->job = Threading::JobSystem::AddJob([b]() { CompressTransferBlock(b); });
+      else
+        b->packedSize = b->dataSize;
+
+      submitted++;
+    }
+
+    TransferBlock *b = pipeline[retired];
+    Threading::JobSystem::SyncJob(b->job);
+    b->job = NULL;
+
+    writer->Write(b->compression);
+    writer->Write(b->packedSize);
+    if(b->compression == TransferCompression::None)
+      writer->Write(b->data.data(), b->packedSize);
+    else
+      writer->Write(b->packed.data(), b->packedSize);
+
+    if(writer->IsErrored())
+      return false;
+
+    if(progress)
+      progress(float(retired + 1) / float(numBlocks));
+  }
+
+  if(progress)
+    progress(1.0f);
+
+  return true;
+}
+
+// receives the remaining blocks of a file from firstBlock onwards, writing them in order. If file
+// is NULL or can't be written the blocks are still consumed, so that the stream stays in sync.
+static bool ReceiveFileBlocks(StreamReader *reader, FILE *file, uint64_t fileSize,
+                              uint64_t firstBlock, RENDERDOC_ProgressCallback progress)
+{
+  const uint64_t numBlocks = NumTransferBlocks(fileSize);
+
+  TransferPipeline pipeline;
+
+  bool success = (file != NULL);
+
+  uint64_t received = firstBlock;
+
+  for(uint64_t retired = firstBlock; retired < numBlocks; retired++)
+  {
+    // read ahead while earlier blocks are decompressed
+    while(received < numBlocks && received - retired < pipeline.size())
+    {
+      TransferBlock *b = pipeline[received];
+
+      // if we stopped writing, blocks are skipped without being retired so wait for any that were
+      // still decompressing before reusing them
+      Threading::JobSystem::SyncJob(b->job);
+      b->job = NULL;
+
+      b->dataSize = TransferBlockDataSize(fileSize, received);
+
+      reader->Read(b->compression);
+
+      if(b->compression == TransferCompression::Abort)
+      {
+        RDCERR("Sender aborted file transfer at block %llu", received);
+        return false;
+      }
+
+      reader->Read(b->packedSize);
+
+      if(reader->IsErrored() || b->compression >= TransferCompression::Count ||
+         b->packedSize > b->packed.size() ||
+         (b->compression == TransferCompression::None && b->packedSize != b->dataSize))
+      {
+        RDCERR("Invalid header for block %llu of file transfer", received);
+        reader->SetErrored();
+        return false;
+      }
+
+      if(!success)
+      {
+        reader->SkipBytes(b->packedSize);
+      }
+      else if(b->compression == TransferCompression::None)
+      {
+        reader->Read(b->data.data(), b->dataSize);
+        b->success = true;
+      }
+      else
+      {
+        reader->Read(b->packed.data(), b->packedSize);
+        b->job = Threading::JobSystem::AddJob([b]() { DecompressTransferBlock(b); });
+      }
+
+      if(reader->IsErrored())
+        return false;
+
+      received++;
+    }
+
+    if(!success)
+      continue;
+
+    TransferBlock *b = pipeline[retired];
+    Threading::JobSystem::SyncJob(b->job);
+    b->job = NULL;
+
+    if(!b->success)
+    {
+      RDCERR("Failed to decompress block %llu of file transfer", retired);
+      success = false;
+    }
+    else if(FileIO::fwrite(b->data.data(), 1, b->dataSize, file) != b->dataSize)
+    {
+      RDCERR("Error writing block %llu of received file", retired);
+      success = false;
+    }
+
+    if(progress)
+      progress(float(retired + 1) / float(numBlocks));
+  }
+
+  if(progress)
+    progress(1.0f);
+
+  return success;
+}
+
+// opens a partially received copy of a file, returning the first block that is still needed. If
+// the file can't be opened, no blocks are needed and NULL is returned.
+static FILE *OpenPartialTransfer(const rdcstr &partialPath, uint64_t fileSize, uint64_t &firstBlock)
+{
+  uint64_t partialSize = FileIO::exists(partialPath.c_str()) ? FileIO::GetFileSize(partialPath) : 0;
+
+  firstBlock = 0;
+
+  FileIO::CreateParentDirectory(partialPath);
+
+  FILE *f = FileIO::fopen(partialPath.c_str(), partialSize > 0 ? "r+b" : "wb");
+
+  if(!f)
+  {
+    RDCERR("Can't open '%s' to receive file", partialPath.c_str());
+    firstBlock = NumTransferBlocks(fileSize);
+    return NULL;
+  }
+
+  // only whole blocks are kept, in case the last one was cut off
+  if(partialSize >= fileSize)
+    firstBlock = NumTransferBlocks(fileSize);
+  else
+    firstBlock = partialSize / TransferBlockSize;
+
+  uint64_t offset = RDCMIN(fileSize, firstBlock * TransferBlockSize);
+
+  FileIO::ftruncateat(f, offset);
+  FileIO::fseek64(f, offset, SEEK_SET);
+
+  if(firstBlock > 0)
+    RDCLOG("Resuming copy of '%s' from block %llu of %llu", partialPath.c_str(), firstBlock,
+           NumTransferBlocks(fileSize));
+
+  return f;
+}
+
+// partial copies that haven't been written to for this long are from transfers that were abandoned
+// rather than interrupted, so aren't worth keeping around to resume.
+static const uint64_t PartialTransferTimeout = 24 * 60 * 60;
+
+// deletes any partially received copies in folder that are older than the timeout, as of the unix
+// timestamp now.
+static void DeleteStalePartialTransfers(const rdcstr &folder, uint64_t now)
+{
+  rdcarray<PathEntry> entries;
+  FileIO::GetFilesInDirectory(folder.c_str(), entries);
+
+  for(const PathEntry &entry : entries)
+  {
+    if(entry.flags & (PathProperty::Directory | PathProperty::ErrorAccessDenied |
+                      PathProperty::ErrorInvalidPath | PathProperty::ErrorUnknown))
+      continue;
+
+    if(!entry.filename.beginsWith("remotecopy_") || !entry.filename.endsWith(".partial"))
+      continue;
+
+    if(uint64_t(entry.lastmod) + PartialTransferTimeout > now)
+      continue;
+
+    RDCLOG("Deleting abandoned partial copy '%s'", entry.filename.c_str());
+    FileIO::Delete((folder + entry.filename).c_str());
+  }
+}
+
 #define WRITE_DATA_SCOPE() WriteSerialiser &ser = writer;
 #define READ_DATA_SCOPE() ReadSerialiser &ser = reader;
 
@@ -374,53 +749,135 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     else if(type == eRemoteServer_CopyCaptureFromRemote)
     {
       rdcstr path;
+      uint32_t compression = 0;
 
       {
         READ_DATA_SCOPE();
         SERIALISE_ELEMENT(path);
+        SERIALISE_ELEMENT(compression);
       }
 
       reader.EndChunk();
 
+      FILE *file = FileIO::fopen(path.c_str(), "rb");
+      uint64_t fileSize = file ? FileIO::GetFileSize(path) : 0;
+      uint64_t identity = GetTransferIdentity(path, fileSize);
+
       {
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
+        SERIALISE_ELEMENT(fileSize);
+        SERIALISE_ELEMENT(identity);
+      }
+
+      // the client replies with the first block it doesn't already have
+      uint64_t firstBlock = 0;
 
-        StreamReader fileStream(FileIO::fopen(path.c_str(), "rb"));
-        ser.SerialiseStream(path, fileStream);
+      type = reader.ReadChunk<RemoteServerPacket>();
+
+      if(type == eRemoteServer_CopyCaptureFromRemote)
+      {
+        READ_DATA_SCOPE();
+        SERIALISE_ELEMENT(firstBlock);
       }
+
+      reader.EndChunk();
+
+      if(reader.IsErrored() || type != eRemoteServer_CopyCaptureFromRemote)
+      {
+        if(file)
+          FileIO::fclose(file);
+
+        RDCERR("Network error sending file");
+        break;
+      }
+
+      {
+        WRITE_DATA_SCOPE();
+        SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
+
+        if(file)
+          SendFileBlocks(ser.GetWriter(), file, fileSize, firstBlock,
+                         (TransferCompression)compression, NULL);
+      }
+
+      if(file)
+        FileIO::fclose(file);
     }
     else if(type == eRemoteServer_CopyCaptureToRemote)
     {
-      rdcstr path;
-      rdcstr dummy, dummy2;
-      FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
-
-      RDCLOG("Copying file to local path '%s'.", path.c_str());
-
-      FileIO::CreateParentDirectory(path);
+      uint64_t fileSize = 0, identity = 0;
 
       {
         READ_DATA_SCOPE();
+        SERIALISE_ELEMENT(fileSize);
+        SERIALISE_ELEMENT(identity);
+      }
 
-        StreamWriter streamWriter(FileIO::fopen(path.c_str(), "wb"), Ownership::Stream);
+      reader.EndChunk();
+
+      // copies are received into a partial file named for the source file, so if the connection
+      // drops a later copy of the same file picks up where this one left off
+      rdcstr partialPath = StringFormat::Fmt("%sRenderDoc/remotecopy_%016llx.partial",
+                                             FileIO::GetTempFolderFilename().c_str(), identity);
+
+      DeleteStalePartialTransfers(FileIO::GetTempFolderFilename() + "RenderDoc/",
+                                  Timing::GetUnixTimestamp());
 
-        ser.SerialiseStream(path.c_str(), streamWriter, NULL);
+      uint64_t firstBlock = 0;
+      FILE *partial = OpenPartialTransfer(partialPath, fileSize, firstBlock);
+
+      {
+        WRITE_DATA_SCOPE();
+        SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+        SERIALISE_ELEMENT(firstBlock);
       }
 
+      bool success = false;
+
+      type = reader.ReadChunk<RemoteServerPacket>();
+
+      if(type == eRemoteServer_CopyCaptureToRemote)
+        success = ReceiveFileBlocks(reader.GetReader(), partial, fileSize, firstBlock, NULL);
+
       reader.EndChunk();
 
+      if(partial)
+        FileIO::fclose(partial);
+
       if(reader.IsErrored())
       {
-        FileIO::Delete(path.c_str());
-
         RDCERR("Network error receiving file");
         break;
       }
 
-      RDCLOG("File received.");
+      rdcstr path;
 
-      tempFiles.push_back(path);
+      if(success)
+      {
+        rdcstr dummy, dummy2;
+        FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
+
+        RDCLOG("Copying file to local path '%s'.", path.c_str());
+
+        FileIO::CreateParentDirectory(path);
+
+        if(FileIO::Move(partialPath.c_str(), path.c_str(), true))
+        {
+          RDCLOG("File received.");
+
+          tempFiles.push_back(path);
+        }
+        else
+        {
+          RDCERR("Couldn't move received file to '%s'", path.c_str());
+          path.clear();
+        }
+      }
+      else
+      {
+        RDCERR("Error receiving file");
+      }
 
       {
         WRITE_DATA_SCOPE();
@@ -1011,6 +1468,10 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
   else
     RDCLOG("Blocking execution commands");
 
+  // clean up after any copies that were abandoned part-way the last time the server ran
+  DeleteStalePartialTransfers(FileIO::GetTempFolderFilename() + "RenderDoc/",
+                              Timing::GetUnixTimestamp());
+
   RDCLOG("Replay host ready for requests...");
 
   ActiveClient activeClientData;
@@ -1476,28 +1937,25 @@ void RemoteServer::CopyCaptureFromRemote(const char *remotepath, const char *loc
                                          RENDERDOC_ProgressCallback progress)
 {
   rdcstr path = remotepath;
+  uint32_t compression = RemoteServer_TransferCompression();
 
   {
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
     SERIALISE_ELEMENT(path);
+    SERIALISE_ELEMENT(compression);
   }
 
+  uint64_t fileSize = 0, identity = 0;
+
   {
     READ_DATA_SCOPE();
     RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
 
     if(type == eRemoteServer_CopyCaptureFromRemote)
     {
-      StreamWriter streamWriter(FileIO::fopen(localpath, "wb"), Ownership::Stream);
-
-      ser.SerialiseStream(localpath, streamWriter, progress);
-
-      if(ser.IsErrored())
-      {
-        RDCERR("Network error receiving file");
-        return;
-      }
+      SERIALISE_ELEMENT(fileSize);
+      SERIALISE_ELEMENT(identity);
     }
     else
     {
@@ -1505,7 +1963,49 @@ void RemoteServer::CopyCaptureFromRemote(const char *remotepath, const char *loc
     }
 
     ser.EndChunk();
+
+    if(type != eRemoteServer_CopyCaptureFromRemote)
+      return;
   }
+
+  // receive into a partial file named for the remote file, so that if the connection drops a later
+  // copy of the same file can pick up where this one left off
+  rdcstr partialPath = StringFormat::Fmt("%s.%016llx.partial", localpath, identity);
+
+  uint64_t firstBlock = 0;
+  FILE *partial = OpenPartialTransfer(partialPath, fileSize, firstBlock);
+
+  {
+    WRITE_DATA_SCOPE();
+    SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
+    SERIALISE_ELEMENT(firstBlock);
+  }
+
+  bool success = false;
+
+  {
+    READ_DATA_SCOPE();
+    RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+
+    if(type == eRemoteServer_CopyCaptureFromRemote)
+      success = ReceiveFileBlocks(ser.GetReader(), partial, fileSize, firstBlock, progress);
+    else
+      RDCERR("Unexpected response to capture copy request");
+
+    ser.EndChunk();
+
+    if(partial)
+      FileIO::fclose(partial);
+
+    if(ser.IsErrored())
+    {
+      RDCERR("Network error receiving file");
+      return;
+    }
+  }
+
+  if(success)
+    FileIO::Move(partialPath.c_str(), localpath, true);
 }
 
 rdcstr RemoteServer::CopyCaptureToRemote(const char *filename, RENDERDOC_ProgressCallback progress)
@@ -1518,15 +2018,51 @@ rdcstr RemoteServer::CopyCaptureToRemote(const char *filename, RENDERDOC_Progres
     return "";
   }
 
+  uint64_t fileSize = FileIO::GetFileSize(filename);
+  uint64_t identity = GetTransferIdentity(filename, fileSize);
+
   {
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+    SERIALISE_ELEMENT(fileSize);
+    SERIALISE_ELEMENT(identity);
+  }
+
+  // the server replies with the first block it doesn't already have from an earlier copy
+  uint64_t firstBlock = 0;
 
-    // this will take ownership of and close the file
-    StreamReader fileStream(fileHandle);
-    ser.SerialiseStream(filename, fileStream, progress);
+  {
+    READ_DATA_SCOPE();
+    RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+
+    if(type == eRemoteServer_CopyCaptureToRemote)
+    {
+      SERIALISE_ELEMENT(firstBlock);
+    }
+    else
+    {
+      RDCERR("Unexpected response to capture copy request");
+    }
+
+    ser.EndChunk();
+
+    if(type != eRemoteServer_CopyCaptureToRemote)
+    {
+      FileIO::fclose(fileHandle);
+      return "";
+    }
   }
 
+  {
+    WRITE_DATA_SCOPE();
+    SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+
+    SendFileBlocks(ser.GetWriter(), fileHandle, fileSize, firstBlock,
+                   (TransferCompression)RemoteServer_TransferCompression(), progress);
+  }
+
+  FileIO::fclose(fileHandle);
+
   rdcstr path;
 
   {
@@ -2041,3 +2577,153 @@ rdcarray<rdcstr> RemoteServer::GetResolve(const rdcarray<uint64_t> &callstack)
 
   return StackFrames;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Capture file block transfer", "[remoteserver]")
+{
+  // a few blocks with a partial one on the end, half compressible and half noise
+  const uint64_t fileSize = TransferBlockSize * 3 + 12345;
+
+  bytebuf contents;
+  contents.resize((size_t)fileSize);
+
+  uint32_t seed = 0x1234;
+  for(size_t i = 0; i < contents.size(); i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    contents[i] = (i / 65536) % 2 ? byte(seed >> 16) : byte(i / 1024);
+  }
+
+  rdcstr dir = FileIO::GetTempFolderFilename() + "RenderDoc/";
+  rdcstr srcPath = dir + "transfer_test_src.bin";
+  rdcstr dstPath = dir + "transfer_test_dst.bin";
+
+  FileIO::CreateParentDirectory(srcPath);
+
+  FILE *f = FileIO::fopen(srcPath.c_str(), "wb");
+  REQUIRE(f);
+  FileIO::fwrite(contents.data(), 1, contents.size(), f);
+  FileIO::fclose(f);
+
+  FileIO::Delete(dstPath.c_str());
+
+  auto transfer = [&](TransferCompression compression, uint64_t expectedFirstBlock) {
+    uint64_t firstBlock = 0;
+    FILE *dst = OpenPartialTransfer(dstPath, fileSize, firstBlock);
+    REQUIRE(dst);
+    CHECK(firstBlock == expectedFirstBlock);
+
+    StreamWriter writer(StreamWriter::DefaultScratchSize);
+
+    FILE *src = FileIO::fopen(srcPath.c_str(), "rb");
+    REQUIRE(src);
+    CHECK(SendFileBlocks(&writer, src, fileSize, firstBlock, compression, NULL));
+    FileIO::fclose(src);
+
+    StreamReader reader(writer.GetData(), writer.GetOffset());
+    CHECK(ReceiveFileBlocks(&reader, dst, fileSize, firstBlock, NULL));
+    CHECK(reader.AtEnd());
+    FileIO::fclose(dst);
+
+    bytebuf received;
+    FileIO::ReadAll(dstPath, received);
+    CHECK((received == contents));
+
+    return writer.GetOffset();
+  };
+
+  SECTION("Compression modes")
+  {
+    uint64_t rawSize = transfer(TransferCompression::None, 0);
+    FileIO::Delete(dstPath.c_str());
+
+    uint64_t lz4Size = transfer(TransferCompression::LZ4, 0);
+    FileIO::Delete(dstPath.c_str());
+
+    uint64_t zstdSize = transfer(TransferCompression::ZSTD, 0);
+    FileIO::Delete(dstPath.c_str());
+
+    CHECK(rawSize > fileSize);
+    CHECK(lz4Size < rawSize);
+    CHECK(zstdSize < rawSize);
+  };
+
+  SECTION("Resume from a partial copy")
+  {
+    // a partial copy with one whole block and part of the next, which is discarded
+    f = FileIO::fopen(dstPath.c_str(), "wb");
+    REQUIRE(f);
+    FileIO::fwrite(contents.data(), 1, (size_t)TransferBlockSize + 1000, f);
+    FileIO::fclose(f);
+
+    transfer(TransferCompression::LZ4, 1);
+
+    // a complete copy has nothing left to transfer
+    transfer(TransferCompression::LZ4, NumTransferBlocks(fileSize));
+
+    FileIO::Delete(dstPath.c_str());
+  };
+
+  SECTION("Blocks are consumed if they can't be written")
+  {
+    StreamWriter writer(StreamWriter::DefaultScratchSize);
+
+    FILE *src = FileIO::fopen(srcPath.c_str(), "rb");
+    REQUIRE(src);
+    CHECK(SendFileBlocks(&writer, src, fileSize, 0, TransferCompression::LZ4, NULL));
+    FileIO::fclose(src);
+
+    StreamReader reader(writer.GetData(), writer.GetOffset());
+    CHECK_FALSE(ReceiveFileBlocks(&reader, NULL, fileSize, 0, NULL));
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+  };
+
+  FileIO::Delete(srcPath.c_str());
+};
+
+TEST_CASE("Abandoned partial copies are deleted", "[remoteserver]")
+{
+  rdcstr dir = FileIO::GetTempFolderFilename() + "RenderDoc/partial_test/";
+
+  const rdcstr partials[] = {
+      dir + "remotecopy_0123456789abcdef.partial", dir + "remotecopy_fedcba9876543210.partial",
+  };
+  const rdcstr other = dir + "remotecopy_0123456789abcdef.rdc";
+
+  for(const rdcstr &path : partials)
+  {
+    FileIO::CreateParentDirectory(path);
+    FILE *f = FileIO::fopen(path.c_str(), "wb");
+    REQUIRE(f);
+    FileIO::fwrite("partial", 1, 7, f);
+    FileIO::fclose(f);
+  }
+
+  FILE *f = FileIO::fopen(other.c_str(), "wb");
+  REQUIRE(f);
+  FileIO::fclose(f);
+
+  const uint64_t now = Timing::GetUnixTimestamp();
+
+  // recent partial copies are kept so they can be resumed
+  DeleteStalePartialTransfers(dir, now);
+
+  for(const rdcstr &path : partials)
+    CHECK(FileIO::exists(path.c_str()));
+
+  DeleteStalePartialTransfers(dir, now + PartialTransferTimeout + 60);
+
+  for(const rdcstr &path : partials)
+    CHECK_FALSE(FileIO::exists(path.c_str()));
+
+  // only partial copies are deleted
+  CHECK(FileIO::exists(other.c_str()));
+
+  FileIO::Delete(other.c_str());
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -25,8 +25,10 @@
 
 #include "replay_proxy.h"
 #include <list>
+#include <unordered_map>
 #include "lz4/lz4.h"
 #include "serialise/lz4io.h"
+#include "serialise/zstdio.h"
 
 template <>
 rdcstr DoStringise(const ReplayProxyPacket &el)
@@ -103,23 +105,35 @@ rdcstr DoStringise(const ReplayProxyPacket &el)
 // utility macros for implementing proxied functions
 
 // begins a chunk with the given packet type, and if reading verifies that the
-// read type was what was expected - otherwise sets an error flag
+// read type was what was expected - otherwise sets an error flag. The request ID the response
+// belongs to follows the type.
 #define PACKET_HEADER(packet)                                         \
   ReplayProxyPacket p = (ReplayProxyPacket)ser.BeginChunk(packet, 0); \
   if(ser.IsReading() && p != packet)                                  \
-    m_IsErrored = true;
+    m_IsErrored = true;                                               \
+  SerialiseRequestID(ser, true, true);
 
 // begins the set of parameters. Note that we only begin a chunk when writing (sending a request to
 // the remote server), since on reading the chunk has already been begun to read the type to
 // dispatch to the correct function.
-#define BEGIN_PARAMS()             \
-  ParamSerialiser &ser = paramser; \
-  if(ser.IsWriting())              \
-    ser.BeginChunk(packet, 0);
+// When completing a pipelined request on the host, the parameters were already sent when it was
+// issued so they're skipped.
+#define BEGIN_PARAMS()                                                \
+  ParamSerialiser &ser = paramser;                                    \
+  if(ser.IsReading() || m_PipelineMode != PipelineMode::Complete)     \
+  {                                                                   \
+    if(ser.IsWriting())                                               \
+      ser.BeginChunk(packet, 0);
 
 // end the set of parameters, and that chunk.
-#define END_PARAMS()                                \
-  {                                                 \
+#define END_PARAMS() END_REQUEST_PARAMS(true)
+
+// as above, for requests the remote server doesn't send a response to. These mustn't be tracked
+// as waiting for one, or the next response would be matched against them.
+#define END_PARAMS_NO_RESPONSE() END_REQUEST_PARAMS(false)
+
+#define END_REQUEST_PARAMS(hasResponse)             \
+    SerialiseRequestID(ser, false, hasResponse);    \
     GET_SERIALISER.Serialise("packet"_lit, packet); \
     ser.EndChunk();                                 \
     CheckError(packet, expectedPacket);             \
@@ -278,6 +292,9 @@ APIProperties ReplayProxy::Proxied_GetAPIProperties(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  if(PipelineRequest(paramser, [this]() { GetAPIProperties(); }))
+    return ret;
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -640,7 +657,8 @@ template <typename ParamSerialiser, typename ReturnSerialiser>
 ResourceId ReplayProxy::Proxied_GetLiveID(ParamSerialiser &paramser, ReturnSerialiser &retser,
                                           ResourceId id)
 {
-  if(paramser.IsWriting())
+  // a pipelined request that's being completed must read its response even if it's cached
+  if(paramser.IsWriting() && m_PipelineMode != PipelineMode::Complete)
   {
     if(m_LiveIDs.find(id) != m_LiveIDs.end())
       return m_LiveIDs[id];
@@ -662,6 +680,9 @@ ResourceId ReplayProxy::Proxied_GetLiveID(ParamSerialiser &paramser, ReturnSeria
     END_PARAMS();
   }
 
+  if(PipelineRequest(paramser, [this, id]() { GetLiveID(id); }))
+    return ret;
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -1133,7 +1154,9 @@ ShaderReflection *ReplayProxy::Proxied_GetShader(ParamSerialiser &paramser,
   // only consider eventID part of the key on APIs where shaders are mutable
   ShaderReflKey key(m_APIProps.shadersMutable ? m_EventID : 0, pipeline, shader, entry);
 
-  if(retser.IsReading() && m_ShaderReflectionCache.find(key) != m_ShaderReflectionCache.end())
+  // a pipelined request that's being completed must read its response even if it's cached
+  if(retser.IsReading() && m_PipelineMode != PipelineMode::Complete &&
+     m_ShaderReflectionCache.find(key) != m_ShaderReflectionCache.end())
     return m_ShaderReflectionCache[key];
 
   {
@@ -1144,6 +1167,10 @@ ShaderReflection *ReplayProxy::Proxied_GetShader(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  if(PipelineRequest(paramser,
+                     [this, pipeline, shader, entry]() { GetShader(pipeline, shader, entry); }))
+    return ret;
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -1161,7 +1188,12 @@ ShaderReflection *ReplayProxy::Proxied_GetShader(ParamSerialiser &paramser,
     // serialised pointer here into our cache
     if(ser.IsReading())
     {
-      m_ShaderReflectionCache[key] = ret;
+      // the same shader may have been requested more than once in a pipeline
+      ShaderReflection *&cached = m_ShaderReflectionCache[key];
+      if(cached)
+        delete ret;
+      else
+        cached = ret;
       ret = NULL;
     }
   }
@@ -1612,7 +1644,7 @@ void ReplayProxy::Proxied_FreeDebugger(ParamSerialiser &paramser, ReturnSerialis
     uint64_t debugger_ptr = (uint64_t)(uintptr_t)debugger;
     SERIALISE_ELEMENT(debugger_ptr);
     debugger = (ShaderDebugger *)(uintptr_t)debugger_ptr;
-    END_PARAMS();
+    END_PARAMS_NO_RESPONSE();
   }
 
   {
@@ -1683,6 +1715,18 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
     if(retser.IsReading())
     {
+      // gather the bound shaders to fetch reflection for. The original IDs are kept and mapped to
+      // live IDs below
+      struct ShaderFetch
+      {
+        ResourceId pipeline;
+        ResourceId shader;
+        ShaderEntryPoint entry;
+        ShaderReflection **reflection;
+      };
+
+      rdcarray<ShaderFetch> fetches;
+
       if(m_APIProps.pipelineType == GraphicsAPI::D3D11)
       {
         D3D11Pipe::Shader *stages[] = {
@@ -1693,13 +1737,12 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->resourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(ResourceId(), GetLiveID(stages[i]->resourceId), ShaderEntryPoint());
+            fetches.push_back(
+                {ResourceId(), stages[i]->resourceId, ShaderEntryPoint(), &stages[i]->reflection});
 
         if(m_D3D11PipelineState.inputAssembly.resourceId != ResourceId())
-          m_D3D11PipelineState.inputAssembly.bytecode =
-              GetShader(ResourceId(), GetLiveID(m_D3D11PipelineState.inputAssembly.resourceId),
-                        ShaderEntryPoint());
+          fetches.push_back({ResourceId(), m_D3D11PipelineState.inputAssembly.resourceId,
+                             ShaderEntryPoint(), &m_D3D11PipelineState.inputAssembly.bytecode});
       }
       else if(m_APIProps.pipelineType == GraphicsAPI::D3D12)
       {
@@ -1709,12 +1752,12 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
             &m_D3D12PipelineState.pixelShader,  &m_D3D12PipelineState.computeShader,
         };
 
-        ResourceId pipe = GetLiveID(m_D3D12PipelineState.pipelineResourceId);
+        ResourceId pipe = m_D3D12PipelineState.pipelineResourceId;
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->resourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(pipe, GetLiveID(stages[i]->resourceId), ShaderEntryPoint());
+            fetches.push_back(
+                {pipe, stages[i]->resourceId, ShaderEntryPoint(), &stages[i]->reflection});
       }
       else if(m_APIProps.pipelineType == GraphicsAPI::OpenGL)
       {
@@ -1726,8 +1769,8 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->shaderResourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(ResourceId(), GetLiveID(stages[i]->shaderResourceId), ShaderEntryPoint());
+            fetches.push_back({ResourceId(), stages[i]->shaderResourceId, ShaderEntryPoint(),
+                               &stages[i]->reflection});
       }
       else if(m_APIProps.pipelineType == GraphicsAPI::Vulkan)
       {
@@ -1737,19 +1780,40 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
             &m_VulkanPipelineState.fragmentShader, &m_VulkanPipelineState.computeShader,
         };
 
-        ResourceId pipe = GetLiveID(m_VulkanPipelineState.graphics.pipelineResourceId);
+        ResourceId pipe = m_VulkanPipelineState.graphics.pipelineResourceId;
 
         for(int i = 0; i < 6; i++)
         {
           if(i == 5)
-            pipe = GetLiveID(m_VulkanPipelineState.compute.pipelineResourceId);
+            pipe = m_VulkanPipelineState.compute.pipelineResourceId;
 
           if(stages[i]->resourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(pipe, GetLiveID(stages[i]->resourceId),
-                          ShaderEntryPoint(stages[i]->entryPoint, stages[i]->stage));
+            fetches.push_back({pipe, stages[i]->resourceId,
+                               ShaderEntryPoint(stages[i]->entryPoint, stages[i]->stage),
+                               &stages[i]->reflection});
         }
       }
+
+      // each of these is otherwise a round trip per shader, so pipeline the live ID lookups and
+      // then the reflection fetches. The final calls are then served from the caches.
+      BeginPipeline();
+      for(const ShaderFetch &f : fetches)
+      {
+        if(f.pipeline != ResourceId())
+          GetLiveID(f.pipeline);
+        GetLiveID(f.shader);
+      }
+      EndPipeline();
+
+      BeginPipeline();
+      for(const ShaderFetch &f : fetches)
+        GetShader(f.pipeline != ResourceId() ? GetLiveID(f.pipeline) : ResourceId(),
+                  GetLiveID(f.shader), f.entry);
+      EndPipeline();
+
+      for(const ShaderFetch &f : fetches)
+        *f.reflection = GetShader(f.pipeline != ResourceId() ? GetLiveID(f.pipeline) : ResourceId(),
+                                  GetLiveID(f.shader), f.entry);
     }
   }
 
@@ -1808,6 +1872,9 @@ void ReplayProxy::Proxied_FetchStructuredFile(ParamSerialiser &paramser, ReturnS
     END_PARAMS();
   }
 
+  if(PipelineRequest(paramser, [this]() { FetchStructuredFile(); }))
+    return;
+
   SDFile *file = &m_StructuredFile;
 
   {
@@ -1884,10 +1951,259 @@ void DoSerialise(SerialiserType &ser, DeltaSection &el)
   SERIALISE_MEMBER(contents);
 }
 
+// a run of the new data when it's block matched against the reference data. If contents is empty
+// then length bytes are copied from refOffs in the reference data, otherwise contents is new data.
+struct DeltaBlock
+{
+  uint64_t refOffs = 0;
+  uint64_t length = 0;
+  bytebuf contents;
+};
+
+DECLARE_REFLECTION_STRUCT(DeltaBlock);
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, DeltaBlock &el)
+{
+  SERIALISE_MEMBER(refOffs);
+  SERIALISE_MEMBER(length);
+  SERIALISE_MEMBER(contents);
+}
+
+// the granularity at which the reference data is indexed for block matching. Matches are extended
+// byte-wise in both directions once found, so this is only the minimum size of a match.
+static const size_t DeltaMatchBlockSize = 256;
+
+// rsync-style weak checksum, which can be rolled forward one byte at a time
+static uint32_t DeltaBlockHash(uint32_t a, uint32_t b)
+{
+  return (a & 0xffff) | (b << 16);
+}
+
+static void DeltaBlockSums(const byte *data, uint32_t &a, uint32_t &b)
+{
+  a = b = 0;
+  for(size_t i = 0; i < DeltaMatchBlockSize; i++)
+  {
+    a += data[i];
+    b += uint32_t(DeltaMatchBlockSize - i) * data[i];
+  }
+}
+
+// build newData out of blocks copied from anywhere in referenceData, and literal data where no
+// match is found. Unlike the positional diff this still finds the common data when it has moved or
+// the size has changed. Returns the number of literal bytes that need to be sent.
+static uint64_t MatchDeltaBlocks(const bytebuf &referenceData, const bytebuf &newData,
+                                 rdcarray<DeltaBlock> &blocks)
+{
+  const size_t L = DeltaMatchBlockSize;
+
+  const byte *ref = referenceData.data();
+  const size_t refSize = referenceData.size();
+  const byte *src = newData.data();
+  const size_t srcSize = newData.size();
+
+  blocks.clear();
+
+  uint64_t literalBytes = 0;
+  size_t literalStart = 0;
+
+  auto flushLiteral = [&](size_t end) {
+    if(end > literalStart)
+    {
+      blocks.push_back(DeltaBlock());
+      blocks.back().contents.append(src + literalStart, end - literalStart);
+      literalBytes += end - literalStart;
+    }
+  };
+
+  if(refSize < L || srcSize < L)
+  {
+    flushLiteral(srcSize);
+    return literalBytes;
+  }
+
+  // index the reference data by the hash of each aligned block. Only the first block with any
+  // given hash is kept, collisions just mean a missed match since every match is verified.
+  std::unordered_map<uint32_t, size_t> index;
+  index.reserve(refSize / L);
+
+  // most positions in the new data don't start a match, so a bitset of the hashes in the index
+  // rejects them before the hash lookup. It has at least 8 bits per block to keep false positives
+  // rare.
+  uint32_t filterShift = 32 - 16;
+  while(filterShift > 6 && (size_t(1) << (32 - filterShift)) < (refSize / L) * 8)
+    filterShift--;
+
+  rdcarray<uint64_t> filter;
+  filter.fill(size_t(1) << (32 - filterShift - 6), 0);
+
+  auto filterBit = [filterShift](uint32_t hash) { return (hash * 0x9E3779B1U) >> filterShift; };
+
+  for(size_t offs = 0; offs + L <= refSize; offs += L)
+  {
+    uint32_t a, b;
+    DeltaBlockSums(ref + offs, a, b);
+
+    const uint32_t hash = DeltaBlockHash(a, b);
+    index.insert(std::make_pair(hash, offs));
+
+    const uint32_t bit = filterBit(hash);
+    filter[bit >> 6] |= 1ULL << (bit & 63);
+  }
+
+  size_t pos = 0;
+  uint32_t a, b;
+  DeltaBlockSums(src, a, b);
+
+  while(pos + L <= srcSize)
+  {
+    const uint32_t hash = DeltaBlockHash(a, b);
+    const uint32_t bit = filterBit(hash);
+
+    auto it = index.end();
+    if(filter[bit >> 6] & (1ULL << (bit & 63)))
+      it = index.find(hash);
+
+    if(it != index.end() && memcmp(ref + it->second, src + pos, L) == 0)
+    {
+      size_t refOffs = it->second;
+      size_t len = L;
+
+      // grow the match as far as it goes in either direction
+      while(pos + len < srcSize && refOffs + len < refSize && src[pos + len] == ref[refOffs + len])
+        len++;
+
+      while(pos > literalStart && refOffs > 0 && src[pos - 1] == ref[refOffs - 1])
+      {
+        pos--;
+        refOffs--;
+        len++;
+      }
+
+      flushLiteral(pos);
+
+      // coalesce with the previous copy if it's contiguous in the reference data
+      if(!blocks.empty() && blocks.back().contents.empty() &&
+         blocks.back().refOffs + blocks.back().length == refOffs)
+      {
+        blocks.back().length += len;
+      }
+      else
+      {
+        blocks.push_back(DeltaBlock());
+        blocks.back().refOffs = refOffs;
+        blocks.back().length = len;
+      }
+
+      pos += len;
+      literalStart = pos;
+
+      if(pos + L <= srcSize)
+        DeltaBlockSums(src + pos, a, b);
+    }
+    else
+    {
+      if(pos + L == srcSize)
+        break;
+
+      // roll the checksum forward one byte
+      a = a - src[pos] + src[pos + L];
+      b = b - uint32_t(L) * src[pos] + a;
+      pos++;
+    }
+  }
+
+  flushLiteral(srcSize);
+
+  return literalBytes;
+}
+
+static bool ApplyDeltaBlocks(const bytebuf &referenceData, const rdcarray<DeltaBlock> &blocks,
+                             bytebuf &result)
+{
+  uint64_t size = 0;
+  for(const DeltaBlock &block : blocks)
+    size += block.contents.empty() ? block.length : block.contents.size();
+
+  result.clear();
+  result.reserve((size_t)size);
+
+  for(const DeltaBlock &block : blocks)
+  {
+    if(!block.contents.empty())
+    {
+      result.append(block.contents);
+    }
+    else if(block.refOffs + block.length > referenceData.size())
+    {
+      RDCERR("{%llu, %llu} copy is outside reference data (%llu bytes)", block.refOffs,
+             block.length, (uint64_t)referenceData.size());
+      return false;
+    }
+    else
+    {
+      result.append(referenceData.data() + (size_t)block.refOffs, (size_t)block.length);
+    }
+  }
+
+  return true;
+}
+
+// the delta list is compressed separately from the outer stream, padded up to a size that's
+// calculated up front so the reader knows how much to decompress.
+template <typename DeltaType>
+static uint64_t GetDeltaStreamSize(rdcarray<DeltaType> &deltas)
+{
+  // serialise to an invalid writer, to get the size of the data that will be written.
+  WriteSerialiser ser(new StreamWriter(StreamWriter::InvalidStream), Ownership::Stream);
+
+  SERIALISE_ELEMENT(deltas);
+
+  return ser.GetWriter()->GetOffset() + ser.GetChunkAlignment();
+}
+
+template <typename DeltaType>
+static void WriteDeltaStream(Compressor *comp, uint64_t uncompSize, rdcarray<DeltaType> &deltas)
+{
+  WriteSerialiser ser(new StreamWriter(comp, Ownership::Stream), Ownership::Stream);
+
+  SERIALISE_ELEMENT(deltas);
+
+  char empty[128] = {};
+
+  // add any necessary padding.
+  uint64_t offs = ser.GetWriter()->GetOffset();
+  RDCASSERT(offs <= uncompSize, offs, uncompSize);
+  RDCASSERT(uncompSize - offs < sizeof(empty), offs, uncompSize);
+
+  if(offs < uncompSize)
+    ser.GetWriter()->Write(empty, uncompSize - offs);
+}
+
+template <typename DeltaType>
+static void ReadDeltaStream(Decompressor *decomp, uint64_t uncompSize, rdcarray<DeltaType> &deltas)
+{
+  ReadSerialiser ser(new StreamReader(decomp, uncompSize, Ownership::Stream), Ownership::Stream);
+
+  SERIALISE_ELEMENT(deltas);
+
+  // add any necessary padding.
+  uint64_t offs = ser.GetReader()->GetOffset();
+  RDCASSERT(offs <= uncompSize, offs, uncompSize);
+
+  if(offs < uncompSize)
+  {
+    if(uncompSize - offs > 128)
+      RDCERR("Unexpected amount of padding: %llu", uncompSize - offs);
+    ser.GetReader()->Read(NULL, uncompSize - offs);
+  }
+}
+
 template <typename SerialiserType>
 void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData, bytebuf &newData)
 {
-  // lz4 compress
+  // deltas are sent compressed, see WriteDeltaStream
   if(xferser.IsReading())
   {
     uint64_t uncompSize = 0;
@@ -1901,28 +2217,41 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
     }
     else
     {
-      rdcarray<DeltaSection> deltas;
+      bool blockMatched = false;
+      xferser.Serialise("blockMatched"_lit, blockMatched);
 
+      if(blockMatched)
       {
-        ReadSerialiser ser(
-            new StreamReader(new LZ4Decompressor(xferser.GetReader(), Ownership::Nothing),
-                             uncompSize, Ownership::Stream),
-            Ownership::Stream);
-
-        SERIALISE_ELEMENT(deltas);
+        rdcarray<DeltaBlock> blocks;
 
-        // add any necessary padding.
-        uint64_t offs = ser.GetReader()->GetOffset();
-        RDCASSERT(offs <= uncompSize, offs, uncompSize);
+        ReadDeltaStream(new ZSTDDecompressor(xferser.GetReader(), Ownership::Nothing), uncompSize,
+                        blocks);
 
-        if(offs < uncompSize)
+        bytebuf result;
+        if(ApplyDeltaBlocks(referenceData, blocks, result))
         {
-          if(uncompSize - offs > 128)
-            RDCERR("Unexpected amount of padding: %llu", uncompSize - offs);
-          ser.GetReader()->Read(NULL, uncompSize - offs);
+          RDCDEBUG("Applied %u matched blocks, %llu bytes from %llu bytes of reference data",
+                   (uint32_t)blocks.size(), (uint64_t)result.size(),
+                   (uint64_t)referenceData.size());
+          referenceData.swap(result);
         }
+        else
+        {
+          // the other side now has reference data we don't, and every later delta would be applied
+          // to the wrong data. There's no way to ask for the whole data again mid-transfer
+          RDCERR("Couldn't apply matched blocks, proxy data is out of sync");
+          referenceData.clear();
+          m_IsErrored = true;
+        }
+
+        return;
       }
 
+      rdcarray<DeltaSection> deltas;
+
+      ReadDeltaStream(new LZ4Decompressor(xferser.GetReader(), Ownership::Nothing), uncompSize,
+                      deltas);
+
       if(deltas.empty())
       {
         RDCERR("Unexpected empty delta list");
@@ -1969,6 +2298,11 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
   {
     uint64_t uncompSize = 0;
 
+    // if the data has changed size or moved around, it's sent as blocks matched from anywhere in
+    // the reference data instead of positional deltas
+    bool blockMatched = false;
+    rdcarray<DeltaBlock> blocks;
+
     // we use a list so that we don't have to reserve and pushing new sections will never cause
     // previous ones to be reallocated and move around lots of data.
     std::list<DeltaSection> deltasList;
@@ -1983,12 +2317,12 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
     {
       if(referenceData.size() != newData.size())
       {
-        RDCERR("Reference data existed at %llu bytes, but new data is now %llu bytes",
-               referenceData.size(), newData.size());
+        RDCDEBUG("Reference data existed at %llu bytes, but new data is now %llu bytes",
+                 (uint64_t)referenceData.size(), (uint64_t)newData.size());
 
-        // re-transfer the whole block, something went seriously wrong if the resource changed size.
-        deltasList.resize(1);
-        deltasList.back().contents = newData;
+        // the positional diff can't be used, match whatever data we can from anywhere instead.
+        MatchDeltaBlocks(referenceData, newData, blocks);
+        blockMatched = true;
       }
       else
       {
@@ -2077,6 +2411,32 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
           deltasList.back().offs = src - srcBegin;
           deltasList.back().contents.append(src, bytesRemain);
         }
+
+        uint64_t deltaBytes = 0;
+        for(const DeltaSection &delta : deltasList)
+          deltaBytes += delta.contents.size();
+
+        // if a large part of the data changed, it may be that most of it just moved (e.g. a buffer
+        // that had data inserted or a texture that scrolled). See if block matching does better.
+        if(deltaBytes > newData.size() / 4)
+        {
+          uint64_t literalBytes = MatchDeltaBlocks(referenceData, newData, blocks);
+
+          // each block has some overhead, be conservative and count it as a full match block.
+          literalBytes += blocks.size() * DeltaMatchBlockSize;
+
+          if(literalBytes < deltaBytes)
+          {
+            RDCDEBUG("Block matching for %llu bytes instead of %llu delta bytes", literalBytes,
+                     deltaBytes);
+            blockMatched = true;
+            deltasList.clear();
+          }
+          else
+          {
+            blocks.clear();
+          }
+        }
       }
     }
 
@@ -2093,40 +2453,28 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
       }
     }
 
-    // fast path - no changes.
-    if(deltas.empty())
-    {
+    // fast path - no changes. A block matched transfer is always sent as the size may have changed
+    if(blockMatched)
+      uncompSize = GetDeltaStreamSize(blocks);
+    else if(deltas.empty())
       uncompSize = 0;
-    }
     else
-    {
-      // serialise to an invalid writer, to get the size of the data that will be written.
-      WriteSerialiser ser(new StreamWriter(StreamWriter::InvalidStream), Ownership::Stream);
-
-      SERIALISE_ELEMENT(deltas);
-
-      uncompSize = ser.GetWriter()->GetOffset() + ser.GetChunkAlignment();
-    }
+      uncompSize = GetDeltaStreamSize(deltas);
 
     xferser.Serialise("uncompSize"_lit, uncompSize);
 
     if(uncompSize > 0)
     {
-      WriteSerialiser ser(new StreamWriter(new LZ4Compressor(xferser.GetWriter(), Ownership::Nothing),
-                                           Ownership::Stream),
-                          Ownership::Stream);
-
-      SERIALISE_ELEMENT(deltas);
-
-      char empty[128] = {};
+      xferser.Serialise("blockMatched"_lit, blockMatched);
 
-      // add any necessary padding.
-      uint64_t offs = ser.GetWriter()->GetOffset();
-      RDCASSERT(offs <= uncompSize, offs, uncompSize);
-      RDCASSERT(uncompSize - offs < sizeof(empty), offs, uncompSize);
-
-      if(offs < uncompSize)
-        ser.GetWriter()->Write(empty, uncompSize - offs);
+      // block matching is only used when there's a lot of data to send, so spend more time
+      // compressing it.
+      if(blockMatched)
+        WriteDeltaStream(new ZSTDCompressor(xferser.GetWriter(), Ownership::Nothing), uncompSize,
+                         blocks);
+      else
+        WriteDeltaStream(new LZ4Compressor(xferser.GetWriter(), Ownership::Nothing), uncompSize,
+                         deltas);
     }
 
     // This is the proxy side, so we have the complete newest contents in data. Swap the new data
@@ -2614,7 +2962,11 @@ void ReplayProxy::BeginRemoteExecution()
   }
   else
   {
-    // don't do anything, we go immediately to EndRemoteExecution and start reading packets
+    // a call that can't be pipelined was made while pipelining. Its request was sent after the
+    // pending ones, so read their responses first. Otherwise we go immediately to
+    // EndRemoteExecution and start reading packets
+    if(m_PipelineMode == PipelineMode::Issue && !m_PipelineCompletions.empty())
+      CompletePipelinedRequests();
   }
 }
 
@@ -2716,6 +3068,85 @@ void ReplayProxy::RemoteExecutionThreadEntry()
   }
 }
 
+void ReplayProxy::BeginPipeline()
+{
+  if(!m_RemoteServer)
+    m_PipelineMode = PipelineMode::Issue;
+}
+
+void ReplayProxy::EndPipeline()
+{
+  if(!m_RemoteServer)
+  {
+    CompletePipelinedRequests();
+    m_PipelineMode = PipelineMode::Immediate;
+  }
+}
+
+void ReplayProxy::CompletePipelinedRequests()
+{
+  rdcarray<std::function<void()>> completions;
+  completions.swap(m_PipelineCompletions);
+
+  // the responses arrive in the order the requests were sent, so complete them in the same order
+  PipelineMode prevMode = m_PipelineMode;
+  m_PipelineMode = PipelineMode::Complete;
+  for(std::function<void()> &complete : completions)
+    complete();
+  m_PipelineMode = prevMode;
+}
+
+template <typename ParamSerialiser>
+bool ReplayProxy::PipelineRequest(ParamSerialiser &paramser, std::function<void()> completion)
+{
+  if(!paramser.IsWriting() || m_PipelineMode != PipelineMode::Issue)
+    return false;
+
+  m_PipelineCompletions.push_back(completion);
+  return true;
+}
+
+uint32_t ProxyRequestTracker::Issue(bool hasResponse)
+{
+  uint32_t requestID = ++lastID;
+  if(hasResponse)
+    pending.push_back(requestID);
+  return requestID;
+}
+
+bool ProxyRequestTracker::Receive(uint32_t requestID)
+{
+  if(pending.empty() || pending[0] != requestID)
+  {
+    RDCERR("Received response for request %u, expected %u", requestID,
+           pending.empty() ? 0 : pending[0]);
+    return false;
+  }
+
+  pending.erase(0);
+  return true;
+}
+
+template <typename SerialiserType>
+void ReplayProxy::SerialiseRequestID(SerialiserType &ser, bool response, bool hasResponse)
+{
+  uint32_t requestID = 0;
+
+  // the host numbers each request, and the remote server echoes the number in the response
+  if(ser.IsWriting())
+    requestID = response ? m_Requests.lastID : m_Requests.Issue(hasResponse);
+
+  ser.Serialise("requestID"_lit, requestID).Hidden();
+
+  if(ser.IsReading())
+  {
+    if(!response)
+      m_Requests.lastID = requestID;
+    else if(!m_Requests.Receive(requestID))
+      m_IsErrored = true;
+  }
+}
+
 bool ReplayProxy::CheckError(ReplayProxyPacket receivedPacket, ReplayProxyPacket expectedPacket)
 {
   if(m_Writer.IsErrored() || m_Reader.IsErrored() || m_IsErrored)
@@ -2854,3 +3285,166 @@ bool ReplayProxy::Tick(int type)
 
   return true;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Block matched delta transfer", "[proxy]")
+{
+  bytebuf reference;
+  reference.resize(64 * 1024);
+
+  uint32_t seed = 12345;
+  for(byte &b : reference)
+  {
+    seed = seed * 1103515245 + 12345;
+    b = byte(seed >> 16);
+  }
+
+  rdcarray<DeltaBlock> blocks;
+  bytebuf result;
+
+  auto literalSize = [&blocks]() {
+    uint64_t ret = 0;
+    for(const DeltaBlock &block : blocks)
+      ret += block.contents.size();
+    return ret;
+  };
+
+  SECTION("Identical data is copied entirely")
+  {
+    CHECK(MatchDeltaBlocks(reference, reference, blocks) == 0);
+    REQUIRE(blocks.size() == 1);
+    CHECK(blocks[0].refOffs == 0);
+    CHECK(blocks[0].length == reference.size());
+
+    REQUIRE(ApplyDeltaBlocks(reference, blocks, result));
+    CHECK(result == reference);
+  };
+
+  SECTION("Inserted data")
+  {
+    bytebuf newData;
+    newData.append(reference.data(), 1000);
+    newData.append((const byte *)"inserted bytes", 14);
+    newData.append(reference.data() + 1000, reference.size() - 1000);
+
+    uint64_t literalBytes = MatchDeltaBlocks(reference, newData, blocks);
+    CHECK(literalBytes == literalSize());
+    CHECK(literalBytes == 14);
+
+    REQUIRE(ApplyDeltaBlocks(reference, blocks, result));
+    CHECK(result == newData);
+  };
+
+  SECTION("Shifted and truncated data")
+  {
+    bytebuf newData;
+    newData.append(reference.data() + 333, 40000);
+    newData[20000] ^= 0xff;
+
+    uint64_t literalBytes = MatchDeltaBlocks(reference, newData, blocks);
+    CHECK(literalBytes == 1);
+
+    REQUIRE(ApplyDeltaBlocks(reference, blocks, result));
+    CHECK(result == newData);
+  };
+
+  SECTION("Unmatched data is sent literally")
+  {
+    bytebuf newData;
+    newData.resize(5000);
+    for(size_t i = 0; i < newData.size(); i++)
+      newData[i] = byte(i * 7);
+
+    CHECK(MatchDeltaBlocks(reference, newData, blocks) == newData.size());
+
+    REQUIRE(ApplyDeltaBlocks(reference, blocks, result));
+    CHECK(result == newData);
+
+    bytebuf tiny;
+    tiny.append(reference.data(), 10);
+
+    CHECK(MatchDeltaBlocks(reference, tiny, blocks) == tiny.size());
+    CHECK(MatchDeltaBlocks(tiny, reference, blocks) == reference.size());
+
+    REQUIRE(ApplyDeltaBlocks(tiny, blocks, result));
+    CHECK(result == reference);
+  };
+
+  SECTION("Out of bounds copies are rejected")
+  {
+    blocks.resize(1);
+    blocks[0].refOffs = reference.size() - 10;
+    blocks[0].length = 20;
+
+    CHECK_FALSE(ApplyDeltaBlocks(reference, blocks, result));
+  };
+};
+
+TEST_CASE("Proxy request IDs", "[proxy]")
+{
+  ProxyRequestTracker host, remote;
+
+  // sends a request from the host, and returns the ID the remote server echoes in its response
+  auto send = [&host, &remote](bool hasResponse) {
+    remote.lastID = host.Issue(hasResponse);
+    return remote.lastID;
+  };
+
+  SECTION("Responses match their requests")
+  {
+    uint32_t a = send(true);
+    CHECK(host.Receive(a));
+
+    uint32_t b = send(true);
+    CHECK(b != a);
+    CHECK(host.Receive(b));
+    CHECK(host.pending.empty());
+  };
+
+  SECTION("Requests without a response aren't waited on")
+  {
+    // e.g. FreeDebugger, followed by a normal request
+    send(false);
+    CHECK(host.pending.empty());
+
+    uint32_t a = send(true);
+    CHECK(host.Receive(a));
+
+    send(false);
+    send(false);
+    uint32_t b = send(true);
+    CHECK(host.Receive(b));
+    CHECK(host.pending.empty());
+  };
+
+  SECTION("Pipelined responses are read in order")
+  {
+    uint32_t a = send(true);
+    uint32_t b = send(true);
+    send(false);
+    uint32_t c = send(true);
+
+    CHECK(host.pending.size() == 3);
+    CHECK(host.Receive(a));
+    CHECK(host.Receive(b));
+    CHECK(host.Receive(c));
+    CHECK(host.pending.empty());
+  };
+
+  SECTION("Mismatched responses are rejected")
+  {
+    CHECK_FALSE(host.Receive(1));
+
+    uint32_t a = send(true);
+    uint32_t b = send(true);
+
+    CHECK_FALSE(host.Receive(b));
+    CHECK(host.Receive(a));
+    CHECK(host.Receive(b));
+  };
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <functional>
 #include "os/os_specific.h"
 #include "replay/replay_driver.h"
 #include "serialise/serialiser.h"
@@ -113,6 +114,21 @@ DECLARE_REFLECTION_ENUM(ReplayProxyPacket);
   rettype CONCAT(Proxied_, name)(ParamSerialiser & paramser, ReturnSerialiser & retser, \
                                  ##__VA_ARGS__);
 
+// tracks the IDs of requests sent from the host to the remote server. Each response carries the ID
+// of its request, and must belong to the oldest request that's still waiting for one.
+struct ProxyRequestTracker
+{
+  // returns the ID for a new request. If the remote server will respond, it's tracked until then
+  uint32_t Issue(bool hasResponse);
+  // checks a response against the oldest outstanding request. Returns false if it doesn't match
+  bool Receive(uint32_t requestID);
+
+  // the last request ID sent on the host, or received on the remote server
+  uint32_t lastID = 0;
+  // requests sent from the host that haven't had their response read yet, oldest first
+  rdcarray<uint32_t> pending;
+};
+
 // This class implements IReplayDriver. On the local machine where the UI is, this can then act like
 // a full local replay by farming out over the network to a remote replay where necessary to
 // implement some functions, and using a local proxy where necessary.
@@ -130,8 +146,11 @@ public:
         m_Replay(NULL),
         m_RemoteServer(false)
   {
+    // these don't depend on each other, so send both requests before waiting on either
+    BeginPipeline();
     ReplayProxy::GetAPIProperties();
     ReplayProxy::FetchStructuredFile();
+    EndPipeline();
   }
 
   ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRemoteDriver *remoteDriver,
@@ -164,6 +183,13 @@ public:
   void EndRemoteExecution();
   void RemoteExecutionThreadEntry();
 
+  // on the host, requests made between these calls are sent back to back without waiting for each
+  // response. Calls that support this (those with results cached on the host) return a default
+  // value when issued, and EndPipeline() then reads all of the responses in order into the caches.
+  // Any other call completes the pending requests before waiting on its own response.
+  void BeginPipeline();
+  void EndPipeline();
+
   bool IsRemoteProxy() { return !m_RemoteServer; }
   void Shutdown() { delete this; }
   ReplayStatus ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers)
@@ -588,6 +614,12 @@ private:
 
   bool CheckError(ReplayProxyPacket receivedPacket, ReplayProxyPacket expectedPacket);
 
+  template <typename SerialiserType>
+  void SerialiseRequestID(SerialiserType &ser, bool response, bool hasResponse);
+  template <typename ParamSerialiser>
+  bool PipelineRequest(ParamSerialiser &paramser, std::function<void()> completion);
+  void CompletePipelinedRequests();
+
   struct TextureCacheEntry
   {
     ResourceId replayid;
@@ -709,6 +741,19 @@ private:
 
   bool m_IsErrored = false;
 
+  enum class PipelineMode
+  {
+    Immediate,
+    Issue,
+    Complete,
+  };
+
+  PipelineMode m_PipelineMode = PipelineMode::Immediate;
+  // calls to make to read the responses of pipelined requests, in the order they were sent
+  rdcarray<std::function<void()>> m_PipelineCompletions;
+
+  ProxyRequestTracker m_Requests;
+
   FrameRecord m_FrameRecord;
   APIProperties m_APIProps;
   std::map<ResourceId, TextureDescription> m_TextureInfo;
@@ -204,3 +204,140 @@ void ResourceRecord::Delete(ResourceRecordHandler *mgr)
     mgr->DestroyResourceRecord(this);
   }
 }
+
+void RecordChunkList::AddChunks(const rdcarray<StoredChunk> &chunks)
+{
+  if(chunks.empty())
+    return;
+
+  m_Runs.push_back(m_Chunks.size());
+  m_Chunks.reserve(m_Chunks.size() + chunks.size());
+  for(const StoredChunk &c : chunks)
+    m_Chunks.push_back({c.id, c.chunk});
+}
+
+rdcarray<Chunk *> RecordChunkList::Merge()
+{
+  rdcarray<Chunk *> ret;
+  ret.reserve(m_Chunks.size());
+
+  typedef rdcpair<int64_t, Chunk *> IDChunk;
+
+  auto idLess = [](const IDChunk &a, const IDChunk &b) { return a.first < b.first; };
+
+  // the current position in each run
+  struct Cursor
+  {
+    int64_t id;
+    size_t run;
+    size_t idx;
+    size_t end;
+  };
+
+  rdcarray<Cursor> heap;
+  heap.reserve(m_Runs.size());
+
+  for(size_t r = 0; r < m_Runs.size(); r++)
+  {
+    size_t begin = m_Runs[r];
+    size_t end = r + 1 < m_Runs.size() ? m_Runs[r + 1] : m_Chunks.size();
+
+    // chunks added from several threads can get IDs slightly out of order within a record. Keep the
+    // original order of any duplicate IDs so the last one added still wins.
+    if(!std::is_sorted(m_Chunks.begin() + begin, m_Chunks.begin() + end, idLess))
+      std::stable_sort(m_Chunks.begin() + begin, m_Chunks.begin() + end, idLess);
+
+    heap.push_back({m_Chunks[begin].first, r, begin, end});
+  }
+
+  // std heaps are max-heaps, so order by the greatest ID first. Ties go to the earliest run so that
+  // later runs overwrite earlier ones below.
+  auto cursorGreater = [](const Cursor &a, const Cursor &b) {
+    if(a.id != b.id)
+      return a.id > b.id;
+    return a.run > b.run;
+  };
+
+  std::make_heap(heap.begin(), heap.end(), cursorGreater);
+
+  int64_t lastID = 0;
+
+  while(!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), cursorGreater);
+    Cursor &cur = heap.back();
+
+    if(!ret.empty() && cur.id == lastID)
+      ret.back() = m_Chunks[cur.idx].second;
+    else
+      ret.push_back(m_Chunks[cur.idx].second);
+
+    lastID = cur.id;
+
+    cur.idx++;
+    if(cur.idx < cur.end)
+    {
+      cur.id = m_Chunks[cur.idx].first;
+      std::push_heap(heap.begin(), heap.end(), cursorGreater);
+    }
+    else
+    {
+      heap.pop_back();
+    }
+  }
+
+  return ret;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Merge record chunks in ID order", "[resourcemanager]")
+{
+  WriteSerialiser ser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+
+  auto makeChunk = [&ser]() {
+    ScopedChunk scope(ser, 1U);
+    return scope.Get();
+  };
+
+  ResourceRecord a(ResourceIDGen::GetNewUniqueID(), false);
+  ResourceRecord b(ResourceIDGen::GetNewUniqueID(), false);
+  ResourceRecord c(ResourceIDGen::GetNewUniqueID(), false);
+
+  // a's chunks are out of order, as if appended from several threads
+  Chunk *a5 = makeChunk(), *a1 = makeChunk(), *a9 = makeChunk(), *a3 = makeChunk();
+  a.AddChunk(a5, 5);
+  a.AddChunk(a1, 1);
+  a.AddChunk(a9, 9);
+  a.AddChunk(a3, 3);
+
+  Chunk *b2 = makeChunk(), *b7 = makeChunk(), *b9 = makeChunk();
+  b.AddChunk(b2, 2);
+  b.AddChunk(b7, 7);
+  b.AddChunk(b9, 9);
+
+  Chunk *c4 = makeChunk();
+  c.AddChunk(c4, 4);
+
+  RecordChunkList recordlist;
+  a.Insert(recordlist);
+  b.Insert(recordlist);
+  c.Insert(recordlist);
+
+  // inserting again does nothing, as the record's data has been written
+  b.Insert(recordlist);
+
+  CHECK(recordlist.size() == 8);
+
+  // the duplicated ID 9 comes from b, which was added last
+  rdcarray<Chunk *> expected = {a1, b2, a3, c4, a5, b7, b9};
+  CHECK(recordlist.Merge() == expected);
+
+  a.DeleteChunks();
+  b.DeleteChunks();
+  c.DeleteChunks();
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -31,6 +31,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include "api/replay/rdcflatmap.h"
+#include "api/replay/rdchashmap.h"
 #include "api/replay/resourceid.h"
 #include "common/threading.h"
 #include "core/core.h"
@@ -259,9 +260,8 @@ inline InitReqType InitReq(FrameRefType refType, InitPolicy policy, bool initial
 }
 
 // handle marking a resource referenced for read or write and storing RAW access etc.
-template <typename Compose>
-bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id, FrameRefType refType,
-                    Compose comp)
+template <typename RefMap, typename Compose>
+bool MarkReferenced(RefMap &refs, ResourceId id, FrameRefType refType, Compose comp)
 {
   auto refit = refs.find(id);
   if(refit == refs.end())
@@ -276,8 +276,8 @@ bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id, Fra
   return false;
 }
 
-inline bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id,
-                           FrameRefType refType)
+template <typename RefMap>
+bool MarkReferenced(RefMap &refs, ResourceId id, FrameRefType refType)
 {
   return MarkReferenced(refs, id, refType, ComposeFrameRefs);
 }
@@ -303,6 +303,43 @@ public:
   virtual void DestroyResourceRecord(ResourceRecord *record) = 0;
 };
 
+// a chunk stored in a resource record, with the ID that orders it against chunks in other records
+struct StoredChunk
+{
+  StoredChunk(int64_t i, Chunk *c)
+  {
+    id = i;
+    // we store this here because by the time it comes to delete the chunks the allocator may have
+    // already been reset and the contents trashed.
+    fromAllocator = c->IsFromAllocator() ? 1 : 0;
+    chunk = c;
+  }
+  int64_t id : 63;
+  int64_t fromAllocator : 1;
+  Chunk *chunk;
+};
+
+// gathers the chunks of each record to be written to a capture, and returns them in ID order. Each
+// record's chunks are added as one run, which is nearly always already sorted since IDs are
+// allocated in increasing order. The runs are then combined in a single k-way merge, instead of
+// inserting every chunk into one tree.
+class RecordChunkList
+{
+public:
+  void AddChunks(const rdcarray<StoredChunk> &chunks);
+
+  // the number of chunks added so far
+  size_t size() const { return m_Chunks.size(); }
+  // returns the chunks in ID order. If the same ID was added more than once, the chunk added last
+  // is returned.
+  rdcarray<Chunk *> Merge();
+
+private:
+  rdcarray<rdcpair<int64_t, Chunk *>> m_Chunks;
+  // the start of each run in m_Chunks
+  rdcarray<size_t> m_Runs;
+};
+
 // This is a generic resource record, that APIs can inherit from and use.
 // A resource is an API object that gets tracked on its own, has dependencies on other resources
 // and has its own stream of chunks.
@@ -364,7 +401,7 @@ struct ResourceRecord
   }
 
   void MarkDataUnwritten() { DataWritten = false; }
-  void Insert(std::map<int64_t, Chunk *> &recordlist)
+  void Insert(RecordChunkList &recordlist)
   {
     bool dataWritten = DataWritten;
 
@@ -379,10 +416,7 @@ struct ResourceRecord
     }
 
     if(!dataWritten)
-    {
-      for(auto it = m_Chunks.begin(); it != m_Chunks.end(); ++it)
-        recordlist[it->id] = it->chunk;
-    }
+      recordlist.AddChunks(m_Chunks);
   }
 
   void AddRef() { Atomic::Inc32(&RefCount); }
@@ -509,21 +543,6 @@ protected:
     return Atomic::Inc64(&globalIDCounter);
   }
 
-  struct StoredChunk
-  {
-    StoredChunk(int64_t i, Chunk *c)
-    {
-      id = i;
-      // we store this here because by the time it comes to delete the chunks the allocator may have
-      // already been reset and the contents trashed.
-      fromAllocator = c->IsFromAllocator() ? 1 : 0;
-      chunk = c;
-    }
-    int64_t id : 63;
-    int64_t fromAllocator : 1;
-    Chunk *chunk;
-  };
-
   rdcarray<StoredChunk> m_Chunks;
   Threading::CriticalSection *m_ChunkLock;
 
@@ -708,18 +727,18 @@ protected:
   // we only need to lock during capturing, on replay we have single threaded access.
   bool m_Capturing;
 
-  // easy optimisation win - don't use maps everywhere. It's convenient but not optimal, and
-  // profiling will likely prove that some or all of these could be a problem
+  // the maps below are hit on every wrap/unwrap and reference, so they use open-addressing hash
+  // maps. Anything that's serialised from them is sorted by ID first so captures are deterministic.
 
   // used during capture - map from real resource to its wrapper (other way can be done just with an
   // Unwrap)
-  std::map<RealResourceType, WrappedResourceType> m_WrapperMap;
+  rdchashmap<RealResourceType, WrappedResourceType> m_WrapperMap;
 
   // used during capture - holds resources referenced in current frame (and how they're referenced)
-  std::map<ResourceId, FrameRefType> m_FrameReferencedResources;
+  rdchashmap<ResourceId, FrameRefType> m_FrameReferencedResources;
 
   // used during capture - holds resources marked as dirty, needing initial contents
-  std::set<ResourceId> m_DirtyResources;
+  rdchashset<ResourceId> m_DirtyResources;
 
   struct InitialContentDataOrChunk
   {
@@ -739,7 +758,18 @@ protected:
   };
 
   // used during capture or replay - holds initial contents
-  std::map<ResourceId, InitialContentDataOrChunk> m_InitialContents;
+  rdchashmap<ResourceId, InitialContentDataOrChunk> m_InitialContents;
+
+  template <typename Map>
+  static rdcarray<ResourceId> SortedIDs(const Map &map)
+  {
+    rdcarray<ResourceId> ret;
+    ret.reserve(map.size());
+    for(auto it = map.begin(); it != map.end(); ++it)
+      ret.push_back(it->first);
+    std::sort(ret.begin(), ret.end());
+    return ret;
+  }
 
   // used during capture or replay - map of resources currently alive with their real IDs, used in
   // capture and replay.
@@ -1051,12 +1081,12 @@ void ResourceManager<Configuration>::Serialise_InitialContentsNeeded(WriteSerial
 
   // all resources that were recorded as being modified should be included in the list of those
   // needing initial contents
-  for(auto it = m_FrameReferencedResources.begin(); it != m_FrameReferencedResources.end(); ++it)
+  for(ResourceId id : SortedIDs(m_FrameReferencedResources))
   {
-    RecordType *record = GetResourceRecord(it->first);
-    if(IsDirtyFrameRef(it->second))
+    RecordType *record = GetResourceRecord(id);
+    if(IsDirtyFrameRef(m_FrameReferencedResources[id]))
     {
-      WrittenRecord wr = {it->first, record ? record->DataInSerialiser : true};
+      WrittenRecord wr = {id, record ? record->DataInSerialiser : true};
 
       NeededInitials.push_back(wr);
     }
@@ -1066,11 +1096,10 @@ void ResourceManager<Configuration>::Serialise_InitialContentsNeeded(WriteSerial
   // referenced read-only, as anything not in this list will have its initial contents freed on
   // replay (see CreateInitialContents). However we only need to keep resources that are referenced
   // (unless we have ref all resources on)
-  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+  for(ResourceId id : SortedIDs(m_InitialContents))
   {
     bool include = RenderDoc::Inst().GetCaptureOptions().refAllResources;
 
-    ResourceId id = it->first;
     if(m_FrameReferencedResources.find(id) != m_FrameReferencedResources.end())
       include = true;
 
@@ -1091,13 +1120,9 @@ void ResourceManager<Configuration>::Serialise_InitialContentsNeeded(WriteSerial
 template <typename Configuration>
 void ResourceManager<Configuration>::FreeInitialContents()
 {
-  while(!m_InitialContents.empty())
-  {
-    auto it = m_InitialContents.begin();
+  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
     it->second.Free(this);
-    if(!m_InitialContents.empty())
-      m_InitialContents.erase(m_InitialContents.begin());
-  }
+  m_InitialContents.clear();
   m_PostponedResourceIDs.clear();
   m_SkippedResourceIDs.clear();
 }
@@ -1348,10 +1373,8 @@ template <typename Configuration>
 rdcarray<ResourceId> ResourceManager<Configuration>::InitialContentResources()
 {
   rdcarray<ResourceId> resources;
-  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+  for(ResourceId id : SortedIDs(m_InitialContents))
   {
-    ResourceId id = it->first;
-
     if(HasLiveResource(id))
     {
       resources.push_back(id);
@@ -1372,7 +1395,7 @@ void ResourceManager<Configuration>::MarkUnwrittenResources()
 template <typename Configuration>
 void ResourceManager<Configuration>::InsertReferencedChunks(WriteSerialiser &ser)
 {
-  std::map<int64_t, Chunk *> sortedChunks;
+  RecordChunkList sortedChunks;
 
   SCOPED_LOCK_OPTIONAL(m_Lock, m_Capturing);
 
@@ -1415,8 +1438,8 @@ void ResourceManager<Configuration>::InsertReferencedChunks(WriteSerialiser &ser
 
   RDCDEBUG("%u frame resource chunks", (uint32_t)sortedChunks.size());
 
-  for(auto it = sortedChunks.begin(); it != sortedChunks.end(); it++)
-    it->second->Write(ser);
+  for(Chunk *chunk : sortedChunks.Merge())
+    chunk->Write(ser);
 
   RDCDEBUG("inserted to serialiser");
 }
@@ -1431,12 +1454,18 @@ void ResourceManager<Configuration>::PrepareInitialContents()
   uint32_t postponed = 0;
   uint32_t skipped = 0;
 
-  float num = float(m_DirtyResources.size());
+  // preparing may dirty other resources, so snapshot the list to iterate
+  rdcarray<ResourceId> dirtyResources;
+  dirtyResources.reserve(m_DirtyResources.size());
+  for(ResourceId id : m_DirtyResources)
+    dirtyResources.push_back(id);
+  std::sort(dirtyResources.begin(), dirtyResources.end());
+
+  float num = float(dirtyResources.size());
   float idx = 0.0f;
 
-  for(auto it = m_DirtyResources.begin(); it != m_DirtyResources.end(); ++it)
+  for(ResourceId id : dirtyResources)
   {
-    ResourceId id = *it;
 
     RenderDoc::Inst().SetProgress(CaptureProgress::PrepareInitialStates, idx / num);
     idx += 1.0f;
@@ -1495,10 +1524,8 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
   float num = float(m_InitialContents.size());
   float idx = 0.0f;
 
-  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+  for(ResourceId id : SortedIDs(m_InitialContents))
   {
-    ResourceId id = it->first;
-
     RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseInitialStates, idx / num);
     idx += 1.0f;
 
@@ -1539,6 +1566,9 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
 
     dirty++;
 
+    // look this up after preparing, which may have set new contents
+    auto it = m_InitialContents.find(id);
+
     if(!Need_InitialStateChunk(id, it->second.data))
     {
       // this was handled in ApplyInitialContentsNonChunks(), do nothing as there's no point copying
@@ -1571,16 +1601,16 @@ void ResourceManager<Configuration>::ApplyInitialContentsNonChunks(WriteSerialis
 {
   SCOPED_LOCK_OPTIONAL(m_Lock, m_Capturing);
 
-  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+  for(ResourceId id : SortedIDs(m_InitialContents))
   {
-    ResourceId id = it->first;
-
     if(m_FrameReferencedResources.find(id) == m_FrameReferencedResources.end() &&
        !RenderDoc::Inst().GetCaptureOptions().refAllResources)
     {
       continue;
     }
 
+    auto it = m_InitialContents.find(id);
+
     RecordType *record = GetResourceRecord(id);
 
     if(!record || record->InternalResource)
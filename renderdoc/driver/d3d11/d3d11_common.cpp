@@ -520,6 +520,10 @@ bool D3D11InitParams::IsSupportedVersion(uint64_t ver)
   if(ver == 0x10)
     return true;
 
+  // 0x11 -> 0x12 - chunk callstacks captured in the frame are stored as IDs into a callstack table
+  if(ver == 0x11)
+    return true;
+
   return false;
 }
 
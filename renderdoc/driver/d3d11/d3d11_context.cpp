@@ -1227,6 +1227,7 @@ ReplayStatus WrappedID3D11DeviceContext::ReplayLog(CaptureState readType, uint32
 
   if(IsLoading(m_State) || IsStructuredExporting(m_State))
   {
+    ser.SetCallstackTable(m_pDevice->GetCallstackTable());
     ser.ConfigureStructuredExport(&GetChunkName, IsStructuredExporting(m_State),
                                   m_pDevice->GetTimeBase(), m_pDevice->GetTimeFrequency());
 
@@ -1225,6 +1225,9 @@ ReplayStatus WrappedID3D11Device::ReadLogInitialisation(RDCFile *rdc, bool store
   ser.SetStringDatabase(&m_StringDB);
   ser.SetUserData(GetResourceManager());
 
+  m_CallstackTable = rdc->GetCallstackTable();
+  ser.SetCallstackTable(m_CallstackTable);
+
   ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers, m_TimeBase, m_TimeFrequency);
 
   m_StructuredFile = &ser.GetStructuredFile();
@@ -1988,6 +1991,7 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
       WriteSerialiser ser(captureWriter, Ownership::Stream);
 
       ser.SetChunkMetadataRecording(m_ScratchSerialiser.GetChunkMetadataRecording());
+      ser.SetCallstackIDs(&RenderDoc::Inst().GetCaptureCallstackIDs());
 
       ser.SetUserData(GetResourceManager());
 
@@ -2034,19 +2038,21 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
 
         RDCDEBUG("Accumulating context resource list");
 
-        std::map<int64_t, Chunk *> recordlist;
+        RecordChunkList recordlist;
         record->Insert(recordlist);
 
         RDCDEBUG("Flushing %u records to file serialiser", (uint32_t)recordlist.size());
 
-        float num = float(recordlist.size());
+        rdcarray<Chunk *> chunks = recordlist.Merge();
+
+        float num = float(chunks.size());
         float idx = 0.0f;
 
-        for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
+        for(Chunk *chunk : chunks)
         {
           RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
           idx += 1.0f;
-          it->second->Write(ser);
+          chunk->Write(ser);
         }
 
         RDCDEBUG("Done");
@@ -25,6 +25,9 @@
 #include "d3d12_command_queue.h"
 #include "d3d12_command_list.h"
 #include "d3d12_resources.h"
+#include "core/settings.h"
+
+RDOC_EXTERN_CONFIG(uint32_t, Capture_MapDiffMergeGap);
 
 template <typename SerialiserType>
 bool WrappedID3D12CommandQueue::Serialise_UpdateTileMappings(
@@ -501,8 +504,8 @@ void WrappedID3D12CommandQueue::ExecuteCommandListsInternal(UINT NumCommandLists
         // here AND serialise them there, but we'll play it safe.
         res->LockMaps();
 
-        size_t diffStart = 0, diffEnd = 0;
-        bool found = true;
+        DiffRange diffs[MaxMapDiffRanges];
+        size_t numDiffs = 0;
 
         byte *ref = res->GetShadow(subres);
         byte *data = res->GetMap(subres);
@@ -512,18 +515,29 @@ void WrappedID3D12CommandQueue::ExecuteCommandListsInternal(UINT NumCommandLists
         if(data)
         {
           if(ref)
-            found = FindDiffRange(data, ref, size, diffStart, diffEnd);
+          {
+            numDiffs = FindDiffRanges(data, ref, size, Capture_MapDiffMergeGap(), diffs,
+                                      ARRAY_COUNT(diffs));
+          }
           else
-            diffEnd = size;
+          {
+            diffs[0].start = 0;
+            diffs[0].end = size;
+            numDiffs = 1;
+          }
 
-          if(found)
+          if(numDiffs > 0)
           {
-            RDCLOG("Persistent map flush forced for %s (%llu -> %llu)",
-                   ToStr(res->GetResourceID()).c_str(), (uint64_t)diffStart, (uint64_t)diffEnd);
+            RDCLOG("Persistent map flush forced for %s (%u ranges, %llu -> %llu)",
+                   ToStr(res->GetResourceID()).c_str(), (uint32_t)numDiffs,
+                   (uint64_t)diffs[0].start, (uint64_t)diffs[numDiffs - 1].end);
 
-            D3D12_RANGE range = {diffStart, diffEnd};
+            for(size_t d = 0; d < numDiffs; d++)
+            {
+              D3D12_RANGE range = {diffs[d].start, diffs[d].end};
 
-            m_pDevice->MapDataWrite(res, subres, data, range);
+              m_pDevice->MapDataWrite(res, subres, data, range);
+            }
 
             if(ref == NULL)
             {
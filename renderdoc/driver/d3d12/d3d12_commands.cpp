@@ -843,6 +843,7 @@ ReplayStatus WrappedID3D12CommandQueue::ReplayLog(CaptureState readType, uint32_
 
   if(IsLoading(m_State) || IsStructuredExporting(m_State))
   {
+    ser.SetCallstackTable(m_pDevice->GetCallstackTable());
     ser.ConfigureStructuredExport(&GetChunkName, IsStructuredExporting(m_State),
                                   m_pDevice->GetTimeBase(), m_pDevice->GetTimeFrequency());
 
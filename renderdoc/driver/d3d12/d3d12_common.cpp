@@ -219,6 +219,10 @@ bool D3D12InitParams::IsSupportedVersion(uint64_t ver)
   if(ver == 0x8)
     return true;
 
+  // 0x9 -> 0xA - chunk callstacks captured in the frame are stored as IDs into a callstack table
+  if(ver == 0x9)
+    return true;
+
   return false;
 }
 
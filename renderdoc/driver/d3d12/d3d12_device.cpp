@@ -2153,6 +2153,7 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
     WriteSerialiser ser(captureWriter, Ownership::Stream);
 
     ser.SetChunkMetadataRecording(GetThreadSerialiser().GetChunkMetadataRecording());
+    ser.SetCallstackIDs(&RenderDoc::Inst().GetCaptureCallstackIDs());
 
     ser.SetUserData(GetResourceManager());
 
@@ -2191,7 +2192,7 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
     // in capframe (the transition is thread-protected) so nothing will be
     // pushed to the vector
 
-    std::map<int64_t, Chunk *> recordlist;
+    RecordChunkList recordlist;
 
     for(auto it = queues.begin(); it != queues.end(); ++it)
     {
@@ -2223,14 +2224,16 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
     RDCDEBUG("Flushing %u chunks to file serialiser from context record",
              (uint32_t)recordlist.size());
 
-    float num = float(recordlist.size());
+    rdcarray<Chunk *> chunks = recordlist.Merge();
+
+    float num = float(chunks.size());
     float idx = 0.0f;
 
-    for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
+    for(Chunk *chunk : chunks)
     {
       RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
       idx += 1.0f;
-      it->second->Write(ser);
+      chunk->Write(ser);
     }
 
     RDCDEBUG("Done");
@@ -3320,6 +3323,9 @@ ReplayStatus WrappedID3D12Device::ReadLogInitialisation(RDCFile *rdc, bool store
   ser.SetStringDatabase(&m_StringDB);
   ser.SetUserData(GetResourceManager());
 
+  m_CallstackTable = rdc->GetCallstackTable();
+  ser.SetCallstackTable(m_CallstackTable);
+
   ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers, m_TimeBase, m_TimeFrequency);
 
   m_StructuredFile = &ser.GetStructuredFile();
@@ -46,7 +46,7 @@ struct D3D12InitParams
   bool usedDXIL = false;
 
   // check if a frame capture section version is supported
-  static const uint64_t CurrentVersion = 0x9;
+  static const uint64_t CurrentVersion = 0xA;
 
   static bool IsSupportedVersion(uint64_t ver);
 };
@@ -546,6 +546,8 @@ private:
 
   D3D12InitParams m_InitParams;
   uint64_t m_SectionVersion;
+  // deduplicated chunk callstacks, owned by the RDCFile and only valid while loading
+  const CallstackTable *m_CallstackTable = NULL;
   ReplayOptions m_ReplayOptions;
   ID3D12InfoQueue *m_pInfoQueue;
 
@@ -673,6 +675,7 @@ public:
   }
   const ReplayOptions &GetReplayOptions() { return m_ReplayOptions; }
   uint64_t GetLogVersion() { return m_SectionVersion; }
+  const CallstackTable *GetCallstackTable() { return m_CallstackTable; }
   CaptureState GetState() { return m_State; }
   D3D12Replay *GetReplay() { return m_Replay; }
   WrappedID3D12CommandQueue *GetQueue() { return m_Queue; }
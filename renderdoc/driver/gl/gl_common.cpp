@@ -1198,6 +1198,10 @@ bool GLInitParams::IsSupportedVersion(uint64_t ver)
   if(ver == 0x22)
     return true;
 
+  // 0x23 -> 0x24 - chunk callstacks captured in the frame are stored as IDs into a callstack table
+  if(ver == 0x23)
+    return true;
+
   return false;
 }
 
@@ -2300,6 +2300,7 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
       WriteSerialiser ser(captureWriter, Ownership::Stream);
 
       ser.SetChunkMetadataRecording(m_ScratchSerialiser.GetChunkMetadataRecording());
+      ser.SetCallstackIDs(&RenderDoc::Inst().GetCaptureCallstackIDs());
 
       ser.SetUserData(GetResourceManager());
 
@@ -2350,7 +2351,7 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
       {
         RDCDEBUG("Accumulating context resource list");
 
-        std::map<int64_t, Chunk *> recordlist;
+        RecordChunkList recordlist;
         m_ContextRecord->Insert(recordlist);
 
         for(auto it = m_ContextData.begin(); it != m_ContextData.end(); ++it)
@@ -2369,14 +2370,16 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
 
         RDCDEBUG("Flushing %u records to file serialiser", (uint32_t)recordlist.size());
 
-        float num = float(recordlist.size());
+        rdcarray<Chunk *> chunks = recordlist.Merge();
+
+        float num = float(chunks.size());
         float idx = 0.0f;
 
-        for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
+        for(Chunk *chunk : chunks)
         {
           RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
           idx += 1.0f;
-          it->second->Write(ser);
+          chunk->Write(ser);
         }
 
         RDCDEBUG("Done");
@@ -3277,6 +3280,9 @@ ReplayStatus WrappedOpenGL::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
   ser.SetStringDatabase(&m_StringDB);
   ser.SetUserData(GetResourceManager());
 
+  m_CallstackTable = rdc->GetCallstackTable();
+  ser.SetCallstackTable(m_CallstackTable);
+
   ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers, m_TimeBase, m_TimeFrequency);
 
   m_StructuredFile = &ser.GetStructuredFile();
@@ -5037,6 +5043,7 @@ ReplayStatus WrappedOpenGL::ContextReplayLog(CaptureState readType, uint32_t sta
 
   if(IsLoading(m_State) || IsStructuredExporting(m_State))
   {
+    ser.SetCallstackTable(m_CallstackTable);
     ser.ConfigureStructuredExport(&GetChunkName, IsStructuredExporting(m_State), m_TimeBase,
                                   m_TimeFrequency);
 
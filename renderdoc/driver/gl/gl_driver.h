@@ -59,7 +59,7 @@ struct GLInitParams
   rdcstr renderer, version;
 
   // check if a frame capture section version is supported
-  static const uint64_t CurrentVersion = 0x23;
+  static const uint64_t CurrentVersion = 0x24;
   static bool IsSupportedVersion(uint64_t ver);
 };
 
@@ -164,6 +164,8 @@ private:
                                GLint arraySize, GLint samples, GLenum intFormat);
 
   uint64_t m_SectionVersion;
+  // deduplicated chunk callstacks, owned by the RDCFile and only valid while loading
+  const CallstackTable *m_CallstackTable = NULL;
   GLInitParams m_GlobalInitParams;
   ReplayOptions m_ReplayOptions;
 
@@ -596,6 +598,7 @@ public:
   APIProperties APIProps;
 
   uint64_t GetLogVersion() { return m_SectionVersion; }
+  const CallstackTable *GetCallstackTable() { return m_CallstackTable; }
   static rdcstr GetChunkName(uint32_t idx);
   GLResourceManager *GetResourceManager() { return m_ResourceManager; }
   CaptureState GetState() { return m_State; }
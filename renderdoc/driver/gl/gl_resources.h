@@ -142,6 +142,20 @@ struct GLResource
 
 DECLARE_REFLECTION_STRUCT(GLResource);
 
+// used for the wrapper map lookup
+namespace std
+{
+template <>
+struct hash<GLResource>
+{
+  std::size_t operator()(const GLResource &res) const
+  {
+    return std::hash<uint64_t>()(uint64_t(uintptr_t(res.ContextShareGroup)) ^
+                                 (uint64_t(res.Namespace) << 40) ^ uint64_t(res.name));
+  }
+};
+}
+
 struct ContextPair
 {
   void *ctx;
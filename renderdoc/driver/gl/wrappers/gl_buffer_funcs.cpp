@@ -25,9 +25,12 @@
 
 #include "../gl_driver.h"
 #include "common/common.h"
+#include "core/settings.h"
 #include "strings/string_utils.h"
 #include "tinyfiledialogs/tinyfiledialogs.h"
 
+RDOC_EXTERN_CONFIG(uint32_t, Capture_MapDiffMergeGap);
+
 enum GLbufferbitfield
 {
 };
@@ -2942,21 +2945,33 @@ void WrappedOpenGL::PersistentMapMemoryBarrier(const std::set<GLResourceRecord *
 
     if(record->Map.ptr)
     {
-      size_t diffStart = 0, diffEnd = record->Map.length;
-      bool found = true;
+      DiffRange diffs[MaxMapDiffRanges];
+      size_t numDiffs = 1;
+
+      diffs[0].start = 0;
+      diffs[0].end = (size_t)record->Map.length;
 
       if(record->GetShadowPtr(0))
-        found = FindDiffRange(record->GetShadowPtr(0), record->Map.ptr, (size_t)record->Map.length,
-                              diffStart, diffEnd);
+        numDiffs = FindDiffRanges(record->GetShadowPtr(0), record->Map.ptr,
+                                  (size_t)record->Map.length, Capture_MapDiffMergeGap(), diffs,
+                                  ARRAY_COUNT(diffs));
+      else if(record->Map.length > 0)
+        record->AllocShadowStorage(record->Map.length);
+      else
+        numDiffs = 0;
 
-      if(found && diffEnd > diffStart)
+      if(numDiffs > 0)
+        RDCLOG("Persistent map flush forced for %s (%u ranges, %llu -> %llu)",
+               ToStr(record->GetResourceID()).c_str(), (uint32_t)numDiffs,
+               (uint64_t)diffs[0].start, (uint64_t)diffs[numDiffs - 1].end);
+
+      for(size_t d = 0; d < numDiffs; d++)
       {
+        size_t diffStart = diffs[d].start, diffEnd = diffs[d].end;
+
         // update the modified region in the 'comparison' shadow buffer for next check
-        if(record->GetShadowPtr(0) == NULL)
-          record->AllocShadowStorage(record->Map.length);
-        else
-          memcpy(record->GetShadowPtr(0) + diffStart, record->Map.ptr + diffStart,
-                 diffEnd - diffStart);
+        memcpy(record->GetShadowPtr(0) + diffStart, record->Map.ptr + diffStart,
+               diffEnd - diffStart);
 
         // we use our own flush function so it will serialise chunks when necessary, and it
         // also handles copying into the persistent mapped pointer and flushing the real GL
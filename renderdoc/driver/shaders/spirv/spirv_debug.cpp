@@ -84,6 +84,11 @@ bool ThreadState::Finished() const
   return killed || callstack.empty();
 }
 
+bool ThreadState::IsDebuggedLane() const
+{
+  return &debugger.GetActiveLane() == this;
+}
+
 void ThreadState::FillCallstack(ShaderDebugState &state)
 {
   for(const StackFrame *frame : callstack)
@@ -101,7 +106,7 @@ void ThreadState::EnterFunction(const rdcarray<Id> &arguments)
   frame->function = func.result;
 
   // if there's a previous stack frame, save its live list
-  if(!callstack.empty())
+  if(!callstack.empty() && IsDebuggedLane())
   {
     // process the outgoing scope
     ProcessScopeChange(live, {});
@@ -110,8 +115,11 @@ void ThreadState::EnterFunction(const rdcarray<Id> &arguments)
   }
 
   // start with just globals
-  live = debugger.GetLiveGlobals();
-  sourceVars = debugger.GetGlobalSourceVars();
+  if(IsDebuggedLane())
+  {
+    live = debugger.GetLiveGlobals();
+    sourceVars = debugger.GetGlobalSourceVars();
+  }
 
   callstack.push_back(frame);
 
@@ -311,14 +319,25 @@ void ThreadState::SetDst(Id id, const ShaderVariable &val)
   ids[id] = val;
   ids[id].name = debugger.GetRawName(id);
 
+  // the other lanes in the workgroup only run to provide values to the debugged lane (e.g. for
+  // derivatives). Their live IDs and pointer aliases are never reported, so don't track them.
+  if(!IsDebuggedLane())
+    return;
+
+  // IDs inside loops are assigned again on each iteration, only track them once
   auto it = std::lower_bound(live.begin(), live.end(), id);
-  live.insert(it - live.begin(), id);
+  if(it == live.end() || *it != id)
+    live.insert(it - live.begin(), id);
 
   if(val.type == VarType::GPUPointer)
   {
     Id ptrId = debugger.GetPointerBaseId(val);
     if(ptrId != Id() && ptrId != id)
-      pointersForId[ptrId].push_back(id);
+    {
+      rdcarray<Id> &pointers = pointersForId[ptrId];
+      if(!pointers.contains(id))
+        pointers.push_back(id);
+    }
   }
 
   if(m_State)
@@ -538,38 +557,16 @@ void ThreadState::SkipIgnoredInstructions()
   // skip OpLine/OpNoLine now, so that nextInstruction points to the next real instruction
   // Also for structured control flow we just save the merge block in case we need it for converging
   // in pixel shaders, but otherwise skip them.
-  while(true)
-  {
-    Iter it = debugger.GetIterForInstruction(nextInstruction);
-    rdcspv::Op op = it.opcode();
-    if(op == Op::Line || op == Op::NoLine)
-    {
-      nextInstruction++;
-      continue;
-    }
-
-    if(op == Op::SelectionMerge)
-    {
-      OpSelectionMerge merge(it);
-
-      mergeBlock = merge.mergeBlock;
-
-      nextInstruction++;
-      continue;
-    }
+  // The instructions to skip are pre-computed by the debugger.
+  if(nextInstruction >= debugger.GetNumInstructions())
+    return;
 
-    if(op == Op::LoopMerge)
-    {
-      OpLoopMerge merge(it);
+  const Debugger::InstructionInfo &info = debugger.GetInstructionInfo(nextInstruction);
 
-      mergeBlock = merge.mergeBlock;
+  if(info.skippedMerge != Id())
+    mergeBlock = info.skippedMerge;
 
-      nextInstruction++;
-      continue;
-    }
-
-    break;
-  }
+  nextInstruction = info.nextExecutable;
 }
 
 void ThreadState::EnterEntryPoint(ShaderDebugState *state)
@@ -3437,26 +3434,13 @@ void ThreadState::StepNext(ShaderDebugState *state, const rdcarray<ThreadState>
   }
 
   // skip over any degenerate branches
-  while(true)
+  while(nextInstruction < debugger.GetNumInstructions())
   {
-    it = debugger.GetIterForInstruction(nextInstruction);
-    if(it.opcode() == Op::Branch)
-    {
-      Id target = OpBranch(it).targetLabel;
-
-      it++;
-
-      while(it.opcode() == Op::Line || it.opcode() == Op::NoLine)
-        it++;
-
-      if(target == OpLabel(it).result)
-      {
-        JumpToLabel(target);
-        continue;
-      }
-    }
+    Id target = debugger.GetInstructionInfo(nextInstruction).degenerateTarget;
+    if(target == Id())
+      break;
 
-    break;
+    JumpToLabel(target);
   }
 
   SkipIgnoredInstructions();
@@ -199,6 +199,7 @@ struct ThreadState
   void FillCallstack(ShaderDebugState &state);
 
   bool Finished() const;
+  bool IsDebuggedLane() const;
 
   uint32_t nextInstruction;
 
@@ -266,12 +267,26 @@ public:
 
   rdcarray<ShaderDebugState> ContinueDebug();
 
+  struct InstructionInfo
+  {
+    // the first instruction at or after this one that isn't an OpLine/OpNoLine or a merge
+    // declaration, and the merge block declared by the last merge skipped to get there (if any)
+    uint32_t nextExecutable = 0;
+    Id skippedMerge;
+    // for an OpBranch that jumps to the label directly following it, the target label
+    Id degenerateTarget;
+    // true if executing this instruction only reads and writes the executing lane's own state, so
+    // lanes can run it concurrently without touching the API wrapper or each other
+    bool laneLocal = false;
+  };
+
   Iter GetIterForInstruction(uint32_t inst);
+  const InstructionInfo &GetInstructionInfo(uint32_t inst) const { return instructionInfo[inst]; }
   uint32_t GetInstructionForIter(Iter it);
   uint32_t GetInstructionForFunction(Id id);
   uint32_t GetInstructionForLabel(Id id);
-  const DataType &GetType(Id typeId);
-  const DataType &GetTypeForId(Id ssaId);
+  const DataType &GetType(Id typeId) const;
+  const DataType &GetTypeForId(Id ssaId) const;
   const Decorations &GetDecorations(Id typeId);
   rdcstr GetRawName(Id id) const;
   rdcstr GetHumanName(Id id);
@@ -295,6 +310,7 @@ public:
   const rdcarray<SourceVariableMapping> &GetGlobalSourceVars() { return globalSourceVars; }
   ThreadState &GetActiveLane() { return workgroup[activeLaneIndex]; }
   const ThreadState &GetActiveLane() const { return workgroup[activeLaneIndex]; }
+  void SetParallelLanes(bool parallel) { parallelLanes = parallel; }
 private:
   virtual void PreParse(uint32_t maxId);
   virtual void PostParse();
@@ -311,6 +327,11 @@ private:
                             callback) const;
 
   void MakeSignatureNames(const rdcarray<SPIRVInterfaceAccess> &sigList, rdcarray<rdcstr> &sigNames);
+  bool IsLaneLocalOp(Iter it) const;
+
+  void StepActiveLane(rdcarray<ShaderDebugState> &ret);
+  bool CanStepLanesInParallel() const;
+  int StepLanesInParallel(rdcarray<ShaderDebugState> &ret, int maxSteps);
 
   /////////////////////////////////////////////////////////
   // debug data
@@ -325,6 +346,10 @@ private:
   uint32_t activeLaneIndex = 0;
   ShaderStage stage;
 
+  // if enabled, the other lanes in the workgroup run lane-local instructions on worker threads
+  // while the active lane is stepped
+  bool parallelLanes = false;
+
   int steps = 0;
 
   /////////////////////////////////////////////////////////
@@ -341,13 +366,13 @@ private:
   rdcarray<MemberName> memberNames;
   std::map<rdcstr, Id> entryLookup;
 
-  SparseIdMap<size_t> idDeathOffset;
+  DenseIdMap<size_t> idDeathOffset;
 
   SparseIdMap<size_t> m_Files;
   LineColumnInfo m_CurLineCol;
   std::map<size_t, LineColumnInfo> m_LineColInfo;
 
-  SparseIdMap<uint32_t> labelInstruction;
+  DenseIdMap<uint32_t> labelInstruction;
 
   // the live mutable global variables, to initialise a stack frame's live list
   rdcarray<Id> liveGlobals;
@@ -365,6 +390,13 @@ private:
 
   rdcarray<size_t> instructionOffsets;
 
+  // decoded once after parsing so stepping doesn't need to re-walk the SPIR-V words to skip
+  // non-executable instructions, or re-format every ID's name each time it's assigned
+  rdcarray<InstructionInfo> instructionInfo;
+  DenseIdMap<rdcstr> rawNames;
+
+  uint32_t GetInstructionForOffset(size_t offs) const;
+
   std::set<rdcstr> usedNames;
   std::map<Id, rdcstr> dynamicNames;
   void CalcActiveMask(rdcarray<bool> &activeMask);
@@ -24,9 +24,15 @@
 
 #include "spirv_debug.h"
 #include "common/formatting.h"
+#include "common/threading.h"
+#include "core/settings.h"
 #include "spirv_op_helpers.h"
 #include "spirv_reflect.h"
 
+RDOC_CONFIG(bool, SPIRV_Debug_ParallelLanes, false,
+            "Step the helper lanes of a pixel quad on worker threads while debugging, between the "
+            "points where lanes need to interact.");
+
 static ShaderVariable *pointerIfMutable(const ShaderVariable &var)
 {
   return NULL;
@@ -107,14 +113,23 @@ Iter Debugger::GetIterForInstruction(uint32_t inst)
   return Iter(m_SPIRV, instructionOffsets[inst]);
 }
 
+uint32_t Debugger::GetInstructionForOffset(size_t offs) const
+{
+  // instructions are registered in order, so the offsets are sorted
+  auto it = std::lower_bound(instructionOffsets.begin(), instructionOffsets.end(), offs);
+  if(it == instructionOffsets.end() || *it != offs)
+    return ~0U;
+  return uint32_t(it - instructionOffsets.begin());
+}
+
 uint32_t Debugger::GetInstructionForIter(Iter it)
 {
-  return instructionOffsets.indexOf(it.offs());
+  return GetInstructionForOffset(it.offs());
 }
 
 uint32_t Debugger::GetInstructionForFunction(Id id)
 {
-  return instructionOffsets.indexOf(functions[id].begin);
+  return GetInstructionForOffset(functions[id].begin);
 }
 
 uint32_t Debugger::GetInstructionForLabel(Id id)
@@ -124,12 +139,12 @@ uint32_t Debugger::GetInstructionForLabel(Id id)
   return ret;
 }
 
-const rdcspv::DataType &Debugger::GetType(Id typeId)
+const rdcspv::DataType &Debugger::GetType(Id typeId) const
 {
   return dataTypes[typeId];
 }
 
-const rdcspv::DataType &Debugger::GetTypeForId(Id ssaId)
+const rdcspv::DataType &Debugger::GetTypeForId(Id ssaId) const
 {
   return dataTypes[idTypes[ssaId]];
 }
@@ -499,6 +514,7 @@ ShaderDebugTrace *Debugger::BeginDebug(DebugAPIWrapper *api, const ShaderStage s
   activeLaneIndex = activeIndex;
   stage = shaderStage;
   apiWrapper = api;
+  parallelLanes = SPIRV_Debug_ParallelLanes();
 
   uint32_t workgroupSize = shaderStage == ShaderStage::Pixel ? 4 : 1;
   for(uint32_t i = 0; i < workgroupSize; i++)
@@ -506,7 +522,7 @@ ShaderDebugTrace *Debugger::BeginDebug(DebugAPIWrapper *api, const ShaderStage s
 
   ThreadState &active = GetActiveLane();
 
-  active.nextInstruction = instructionOffsets.indexOf(functions[entryId].begin);
+  active.nextInstruction = GetInstructionForFunction(entryId);
 
   active.ids.resize(idOffsets.size());
 
@@ -1131,6 +1147,16 @@ rdcarray<ShaderDebugState> Debugger::ContinueDebug()
   // more steps if our target thread is inactive
   for(int stepEnd = steps + 100; steps < stepEnd;)
   {
+    if(parallelLanes && CanStepLanesInParallel())
+    {
+      int parallelSteps = StepLanesInParallel(ret, stepEnd - steps);
+      if(parallelSteps > 0)
+      {
+        global.clock += parallelSteps;
+        continue;
+      }
+    }
+
     global.clock++;
 
     if(active.Finished())
@@ -1155,49 +1181,116 @@ rdcarray<ShaderDebugState> Debugger::ContinueDebug()
         }
 
         if(lane == activeLaneIndex)
-        {
-          ShaderDebugState state;
+          StepActiveLane(ret);
+        else
+          thread.StepNext(NULL, workgroup);
+      }
+    }
+  }
 
-          // see if we're retiring any IDs at this state
-          for(size_t l = 0; l < thread.live.size();)
-          {
-            Id id = thread.live[l];
-            if(idDeathOffset[id] < instructionOffsets[thread.nextInstruction])
-            {
-              thread.live.erase(l);
-              ShaderVariableChange change;
-              change.before = GetPointerValue(thread.ids[id]);
-              state.changes.push_back(change);
+  return ret;
+}
 
-              rdcstr name = GetRawName(id);
+void Debugger::StepActiveLane(rdcarray<ShaderDebugState> &ret)
+{
+  ThreadState &thread = GetActiveLane();
 
-              thread.sourceVars.removeIf([name](const SourceVariableMapping &var) {
-                return var.variables[0].name.beginsWith(name);
-              });
+  ShaderDebugState state;
 
-              continue;
-            }
+  // see if we're retiring any IDs at this state
+  for(size_t l = 0; l < thread.live.size();)
+  {
+    Id id = thread.live[l];
+    if(idDeathOffset[id] < instructionOffsets[thread.nextInstruction])
+    {
+      thread.live.erase(l);
+      ShaderVariableChange change;
+      change.before = GetPointerValue(thread.ids[id]);
+      state.changes.push_back(change);
 
-            l++;
-          }
+      rdcstr name = GetRawName(id);
 
-          thread.StepNext(&state, workgroup);
-          state.stepIndex = steps;
-          state.sourceVars = thread.sourceVars;
-          thread.FillCallstack(state);
-          ret.push_back(state);
+      thread.sourceVars.removeIf([name](const SourceVariableMapping &var) {
+        return var.variables[0].name.beginsWith(name);
+      });
 
-          steps++;
-        }
-        else
-        {
-          thread.StepNext(NULL, workgroup);
-        }
-      }
+      continue;
     }
+
+    l++;
   }
 
-  return ret;
+  thread.StepNext(&state, workgroup);
+  state.stepIndex = steps;
+  state.sourceVars = thread.sourceVars;
+  thread.FillCallstack(state);
+  ret.push_back(state);
+
+  steps++;
+}
+
+bool Debugger::CanStepLanesInParallel() const
+{
+  if(workgroup.size() <= 1)
+    return false;
+
+  // while diverged, lanes are stepped selectively to reconverge so they must go one clock at a time
+  if(convergeBlock != Id())
+    return false;
+
+  const uint32_t next = GetActiveLane().nextInstruction;
+  if(next >= instructionOffsets.size() || !instructionInfo[next].laneLocal)
+    return false;
+
+  // all lanes must be active and at the same point, as they would be stepped in lockstep anyway
+  for(const ThreadState &thread : workgroup)
+    if(thread.Finished() || thread.nextInstruction != next)
+      return false;
+
+  return true;
+}
+
+int Debugger::StepLanesInParallel(rdcarray<ShaderDebugState> &ret, int maxSteps)
+{
+  // Every lane starts from the same instruction, and lane-local instructions never branch
+  // conditionally, so each lane follows the same path and stops at the same instruction after the
+  // same number of steps. That's the next point where lanes could interact (a derivative, barrier,
+  // divergent branch, or API wrapper access) or the end of this chunk of steps, whichever is first.
+  // The results are identical to stepping each clock serially.
+  auto runLane = [this, maxSteps](ThreadState &thread) {
+    int count = 0;
+    while(count < maxSteps && thread.nextInstruction < instructionOffsets.size() &&
+          instructionInfo[thread.nextInstruction].laneLocal)
+    {
+      thread.StepNext(NULL, workgroup);
+      count++;
+    }
+  };
+
+  rdcarray<Threading::JobSystem::Job *> jobs;
+  for(size_t lane = 0; lane < workgroup.size(); lane++)
+  {
+    if(lane == activeLaneIndex)
+      continue;
+
+    ThreadState *thread = &workgroup[lane];
+    jobs.push_back(Threading::JobSystem::AddJob([runLane, thread]() { runLane(*thread); }));
+  }
+
+  // the active lane records its states on this thread since building them touches shared data
+  // like the human-readable names
+  ThreadState &active = GetActiveLane();
+  int count = 0;
+  while(count < maxSteps && active.nextInstruction < instructionOffsets.size() &&
+        instructionInfo[active.nextInstruction].laneLocal)
+  {
+    StepActiveLane(ret);
+    count++;
+  }
+
+  Threading::JobSystem::SyncJobs(jobs);
+
+  return count;
 }
 
 ShaderVariable Debugger::MakePointerVariable(Id id, const ShaderVariable *v, uint32_t scalar0,
@@ -1773,6 +1866,8 @@ void Debugger::WriteThroughPointer(const ShaderVariable &ptr, const ShaderVariab
 
 rdcstr Debugger::GetRawName(Id id) const
 {
+  if(id.value() < rawNames.size())
+    return rawNames[id];
   return StringFormat::Fmt("_%u", id.value());
 }
 
@@ -2254,6 +2349,8 @@ void Debugger::PreParse(uint32_t maxId)
   Processor::PreParse(maxId);
 
   strings.resize(idTypes.size());
+  idDeathOffset.resize(idTypes.size());
+  labelInstruction.resize(idTypes.size());
 }
 
 void Debugger::PostParse()
@@ -2268,6 +2365,232 @@ void Debugger::PostParse()
     idDeathOffset[v.id] = ~0U;
 
   memberNames.clear();
+
+  rawNames.resize(idTypes.size());
+  for(uint32_t i = 0; i < rawNames.size(); i++)
+    rawNames[i] = StringFormat::Fmt("_%u", i);
+
+  const uint32_t numInstructions = (uint32_t)instructionOffsets.size();
+
+  instructionInfo.resize(numInstructions);
+
+  // walk backwards so each instruction can chain onto the next one's skip target
+  for(uint32_t i = numInstructions; i-- > 0;)
+  {
+    Iter it = GetIterForInstruction(i);
+    InstructionInfo &info = instructionInfo[i];
+    const InstructionInfo *next = i + 1 < numInstructions ? &instructionInfo[i + 1] : NULL;
+
+    const Op op = it.opcode();
+
+    if(op == Op::Line || op == Op::NoLine || op == Op::SelectionMerge || op == Op::LoopMerge)
+    {
+      info.nextExecutable = next ? next->nextExecutable : numInstructions;
+      info.skippedMerge = next ? next->skippedMerge : Id();
+
+      // the last merge skipped is the one that sticks
+      if(info.skippedMerge == Id())
+      {
+        if(op == Op::SelectionMerge)
+          info.skippedMerge = OpSelectionMerge(it).mergeBlock;
+        else if(op == Op::LoopMerge)
+          info.skippedMerge = OpLoopMerge(it).mergeBlock;
+      }
+    }
+    else
+    {
+      info.nextExecutable = i;
+    }
+
+    if(op == Op::Branch)
+    {
+      Id target = OpBranch(it).targetLabel;
+
+      it++;
+
+      while(it.opcode() == Op::Line || it.opcode() == Op::NoLine)
+        it++;
+
+      if(it.opcode() == Op::Label && OpLabel(it).result == target)
+        info.degenerateTarget = target;
+    }
+
+    info.laneLocal = IsLaneLocalOp(GetIterForInstruction(i));
+  }
+}
+
+bool Debugger::IsLaneLocalOp(Iter it) const
+{
+  // storage which each lane has its own copy of, and which can't be backed by a buffer
+  auto isLocalPointer = [this](Id pointer) {
+    const DataType &type = GetTypeForId(pointer);
+    if(type.type != DataType::PointerType)
+      return false;
+    StorageClass storage = type.pointerType.storage;
+    return storage == StorageClass::Function || storage == StorageClass::Private ||
+           storage == StorageClass::Input || storage == StorageClass::Output;
+  };
+
+  switch(it.opcode())
+  {
+    // control flow that can't diverge. Anything that can diverge or leave the current function
+    // needs the workgroup to be considered together
+    case Op::Nop:
+    case Op::Undef:
+    case Op::Phi:
+    case Op::Branch:
+
+    // plain value manipulation
+    case Op::CopyObject:
+    case Op::CopyLogical:
+    case Op::CompositeExtract:
+    case Op::CompositeInsert:
+    case Op::CompositeConstruct:
+    case Op::VectorShuffle:
+    case Op::VectorExtractDynamic:
+    case Op::VectorInsertDynamic:
+    case Op::Select:
+    case Op::ConvertFToS:
+    case Op::ConvertFToU:
+    case Op::ConvertSToF:
+    case Op::ConvertUToF:
+    case Op::QuantizeToF16:
+    case Op::UConvert:
+    case Op::SConvert:
+    case Op::FConvert:
+    case Op::Bitcast:
+    case Op::LogicalEqual:
+    case Op::LogicalNotEqual:
+    case Op::LogicalOr:
+    case Op::LogicalAnd:
+    case Op::LogicalNot:
+    case Op::IEqual:
+    case Op::INotEqual:
+    case Op::UGreaterThan:
+    case Op::UGreaterThanEqual:
+    case Op::ULessThan:
+    case Op::ULessThanEqual:
+    case Op::SGreaterThan:
+    case Op::SGreaterThanEqual:
+    case Op::SLessThan:
+    case Op::SLessThanEqual:
+    case Op::FOrdEqual:
+    case Op::FOrdNotEqual:
+    case Op::FOrdGreaterThan:
+    case Op::FOrdGreaterThanEqual:
+    case Op::FOrdLessThan:
+    case Op::FOrdLessThanEqual:
+    case Op::FUnordEqual:
+    case Op::FUnordNotEqual:
+    case Op::FUnordGreaterThan:
+    case Op::FUnordGreaterThanEqual:
+    case Op::FUnordLessThan:
+    case Op::FUnordLessThanEqual:
+    case Op::Any:
+    case Op::All:
+    case Op::IsNan:
+    case Op::IsInf:
+    case Op::BitCount:
+    case Op::BitReverse:
+    case Op::BitFieldUExtract:
+    case Op::BitFieldSExtract:
+    case Op::BitFieldInsert:
+    case Op::BitwiseOr:
+    case Op::BitwiseAnd:
+    case Op::BitwiseXor:
+    case Op::ShiftLeftLogical:
+    case Op::ShiftRightArithmetic:
+    case Op::ShiftRightLogical:
+    case Op::Not:
+    case Op::FMul:
+    case Op::FDiv:
+    case Op::FMod:
+    case Op::FRem:
+    case Op::FAdd:
+    case Op::FSub:
+    case Op::IMul:
+    case Op::SDiv:
+    case Op::UDiv:
+    case Op::UMod:
+    case Op::SMod:
+    case Op::SRem:
+    case Op::IAdd:
+    case Op::ISub:
+    case Op::UMulExtended:
+    case Op::SMulExtended:
+    case Op::IAddCarry:
+    case Op::ISubBorrow:
+    case Op::FNegate:
+    case Op::SNegate:
+    case Op::Dot:
+    case Op::VectorTimesScalar:
+    case Op::MatrixTimesScalar:
+    case Op::VectorTimesMatrix:
+    case Op::MatrixTimesVector:
+    case Op::MatrixTimesMatrix:
+    case Op::OuterProduct:
+    case Op::Transpose: return true;
+
+    // memory access is only local if it can't reach a buffer or shared memory
+    case Op::Load: return isLocalPointer(OpLoad(it).pointer);
+    case Op::Store: return isLocalPointer(OpStore(it).pointer);
+    case Op::AccessChain:
+    case Op::InBoundsAccessChain:
+    {
+      OpAccessChain chain(it);
+
+      if(!isLocalPointer(chain.base))
+        return false;
+
+      // the chain must be fully known and in bounds, otherwise it may need to report a message
+      // through the API wrapper.
+      const DataType *type = &GetType(GetTypeForId(chain.base).InnerType());
+      for(Id index : chain.indexes)
+      {
+        auto c = constants.find(index);
+        if(c == constants.end() || c->second.op != Op::Constant)
+          return false;
+
+        uint32_t idx = c->second.value.value.uv[0];
+        uint32_t count = 0;
+        Id child;
+
+        switch(type->type)
+        {
+          case DataType::StructType:
+            count = (uint32_t)type->children.size();
+            child = idx < count ? type->children[idx].type : Id();
+            break;
+          case DataType::ArrayType:
+          {
+            auto len = constants.find(type->length);
+            count = len != constants.end() ? len->second.value.value.uv[0] : 0;
+            child = type->InnerType();
+            break;
+          }
+          case DataType::MatrixType:
+            count = type->matrix().count;
+            child = type->InnerType();
+            break;
+          case DataType::VectorType:
+            count = type->vector().count;
+            child = type->InnerType();
+            break;
+          default: break;
+        }
+
+        if(idx >= count)
+          return false;
+
+        type = &GetType(child);
+      }
+
+      return true;
+    }
+
+    // everything else may use the API wrapper, other lanes, or shared debugger state
+    default: return false;
+  }
 }
 
 void Debugger::RegisterOp(Iter it)
@@ -2411,3 +2734,175 @@ void Debugger::RegisterOp(Iter it)
 }
 
 };    // namespace rdcspv
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+#include "core/core.h"
+#include "glslang_compile.h"
+
+// only provides interpolated inputs, anything which needs the GPU is unsupported
+class TestAPIWrapper : public rdcspv::DebugAPIWrapper
+{
+public:
+  void AddDebugMessage(MessageCategory c, MessageSeverity sv, MessageSource src, rdcstr d) override
+  {
+  }
+  uint64_t GetBufferLength(BindpointIndex bind) override { return 0; }
+  void ReadBufferValue(BindpointIndex bind, uint64_t offset, uint64_t byteSize, void *dst) override
+  {
+    memset(dst, 0, (size_t)byteSize);
+  }
+  void WriteBufferValue(BindpointIndex bind, uint64_t offset, uint64_t byteSize,
+                        const void *src) override
+  {
+  }
+  bool ReadTexel(BindpointIndex imageBind, const ShaderVariable &coord, uint32_t sample,
+                 ShaderVariable &output) override
+  {
+    return false;
+  }
+  bool WriteTexel(BindpointIndex imageBind, const ShaderVariable &coord, uint32_t sample,
+                  const ShaderVariable &value) override
+  {
+    return false;
+  }
+  void FillInputValue(ShaderVariable &var, ShaderBuiltin builtin, uint32_t location,
+                      uint32_t component) override
+  {
+    for(uint8_t c = 0; c < var.columns; c++)
+    {
+      if(var.type == VarType::Float)
+        var.value.fv[c] = float(location * 4 + component + c) * 0.25f;
+      else
+        var.value.uv[c] = location * 4 + component + c + 3;
+    }
+  }
+  bool CalculateSampleGather(rdcspv::ThreadState &lane, rdcspv::Op opcode, TextureType texType,
+                             BindpointIndex imageBind, BindpointIndex samplerBind,
+                             const ShaderVariable &uv, const ShaderVariable &ddxCalc,
+                             const ShaderVariable &ddyCalc, const ShaderVariable &compare,
+                             rdcspv::GatherChannel gatherChannel,
+                             const rdcspv::ImageOperandsAndParamDatas &operands,
+                             ShaderVariable &output) override
+  {
+    return false;
+  }
+  bool CalculateMathOp(rdcspv::ThreadState &lane, rdcspv::GLSLstd450 op,
+                       const rdcarray<ShaderVariable> &params, ShaderVariable &output) override
+  {
+    return false;
+  }
+  DerivativeDeltas GetDerivative(ShaderBuiltin builtin, uint32_t location,
+                                 uint32_t component) override
+  {
+    DerivativeDeltas ret;
+    ret.ddxcoarse = ret.ddxfine = Vec4f(0.5f, 0.25f, -0.125f, 1.0f);
+    ret.ddycoarse = ret.ddyfine = Vec4f(-0.25f, 0.75f, 0.5f, 0.125f);
+    return ret;
+  }
+};
+
+TEST_CASE("Check SPIR-V debugging is deterministic with parallel lanes", "[spirv][debug]")
+{
+  rdcspv::Init();
+  RenderDoc::Inst().RegisterShutdownFunction(&rdcspv::Shutdown);
+
+  const rdcstr source = R"(
+#version 450 core
+
+layout(location = 0) in vec4 inData;
+layout(location = 1) flat in int inCount;
+
+layout(location = 0) out vec4 outColor;
+
+vec4 accumulate(vec4 v, int n)
+{
+  vec4 ret = vec4(0.0f);
+  for(int i = 0; i < n; i++)
+  {
+    ret += v * float(i);
+    ret.yz = ret.zy;
+  }
+  return ret;
+}
+
+void main()
+{
+  float weights[4] = float[](1.0f, 2.0f, 3.0f, 4.0f);
+  vec4 sum = accumulate(inData, inCount);
+  for(int i = 0; i < 4; i++)
+    sum.x += weights[i] * inData.y;
+
+  vec4 d = dFdx(sum) + dFdy(inData);
+
+  if(inData.x > 0.2f)
+    sum.w = -sum.w;
+
+  outColor = sum + fwidth(d);
+}
+)";
+
+  rdcarray<uint32_t> spirv;
+  rdcspv::CompilationSettings settings(rdcspv::InputLanguage::VulkanGLSL,
+                                       rdcspv::ShaderStage::Fragment);
+  settings.debugInfo = true;
+  rdcstr errors = rdcspv::Compile(settings, {source}, spirv);
+
+  INFO("SPIR-V compile output: " << errors);
+
+  REQUIRE(!spirv.empty());
+
+  ShaderReflection refl;
+  ShaderBindpointMapping mapping;
+  SPIRVPatchData patchData;
+  {
+    rdcspv::Reflector spv;
+    spv.Parse(spirv);
+    spv.MakeReflection(GraphicsAPI::Vulkan, ShaderStage::Pixel, "main", {}, refl, mapping,
+                       patchData);
+  }
+
+  auto debug = [&](uint32_t activeIndex, bool parallel) {
+    rdcarray<ShaderDebugState> ret;
+
+    rdcspv::Debugger *debugger = new rdcspv::Debugger;
+    debugger->Parse(spirv);
+    ShaderDebugTrace *trace = debugger->BeginDebug(new TestAPIWrapper, ShaderStage::Pixel, "main",
+                                                   {}, {}, patchData, activeIndex);
+    debugger->SetParallelLanes(parallel);
+
+    for(;;)
+    {
+      rdcarray<ShaderDebugState> states = debugger->ContinueDebug();
+      if(states.empty())
+        break;
+      ret.append(states);
+    }
+
+    delete trace;
+    delete debugger;
+
+    return ret;
+  };
+
+  for(uint32_t activeIndex = 0; activeIndex < 4; activeIndex++)
+  {
+    rdcarray<ShaderDebugState> serial = debug(activeIndex, false);
+    rdcarray<ShaderDebugState> parallel = debug(activeIndex, true);
+
+    INFO("Active lane " << activeIndex);
+
+    CHECK(serial.size() > 100);
+    REQUIRE(serial.size() == parallel.size());
+
+    for(size_t i = 0; i < serial.size(); i++)
+    {
+      INFO("Step " << i);
+      CHECK(bool(serial[i] == parallel[i]));
+      CHECK(serial[i].callstack == parallel[i].callstack);
+    }
+  }
+}
+
+#endif
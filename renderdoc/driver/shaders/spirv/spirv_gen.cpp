@@ -1898,7 +1898,7 @@ void OpDecoder::ForEachID(const ConstIter &it, const std::function<void(Id,bool)
     case rdcspv::Op::SourceContinued:
       break;
     case rdcspv::Op::Source:
-      callback(Id::fromWord(it.word(3)), false);
+      if(size > 3) callback(Id::fromWord(it.word(3)), false);
       break;
     case rdcspv::Op::SourceExtension:
       break;
@@ -2066,7 +2066,7 @@ void OpDecoder::ForEachID(const ConstIter &it, const std::function<void(Id,bool)
     case rdcspv::Op::Variable:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
-      callback(Id::fromWord(it.word(4)), false);
+      if(size > 4) callback(Id::fromWord(it.word(4)), false);
       break;
     case rdcspv::Op::ImageTexelPointer:
       callback(Id::fromWord(it.word(1)), false);
@@ -3634,112 +3634,112 @@ void OpDecoder::ForEachID(const ConstIter &it, const std::function<void(Id,bool)
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformFAdd:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformIMul:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformFMul:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformSMin:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformUMin:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformFMin:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformSMax:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformUMax:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformFMax:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformBitwiseAnd:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformBitwiseOr:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformBitwiseXor:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformLogicalAnd:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformLogicalOr:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformLogicalXor:
       callback(Id::fromWord(it.word(1)), false);
       callback(Id::fromWord(it.word(2)), true);
       callback(Id::fromWord(it.word(3)), false);
       callback(Id::fromWord(it.word(5)), false);
-      callback(Id::fromWord(it.word(6)), false);
+      if(size > 6) callback(Id::fromWord(it.word(6)), false);
       break;
     case rdcspv::Op::GroupNonUniformQuadBroadcast:
       callback(Id::fromWord(it.word(1)), false);
@@ -28,6 +28,7 @@
 
 #include "catch/catch.hpp"
 
+#include "common/threading.h"
 #include "vk_resources.h"
 
 #include <stdint.h>
@@ -732,4 +733,156 @@ TEST_CASE("Test ImageState type", "[imagestate]")
   };
 };
 
+TEST_CASE("Test ImageStateMap", "[imagestate]")
+{
+  ImageInfo imageInfo(VK_FORMAT_R8G8B8A8_UNORM, {16, 16, 1}, 1, 1, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+                      VK_SHARING_MODE_EXCLUSIVE);
+
+  rdcarray<ResourceId> ids;
+  for(int i = 0; i < 100; i++)
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+
+  ImageStateMap map;
+
+  SECTION("Insert, find and erase")
+  {
+    for(ResourceId id : ids)
+    {
+      bool inserted = false;
+      CHECK(bool(map.Insert(id, LockingImageState(VK_NULL_HANDLE, imageInfo, eFrameRef_None),
+                            &inserted)));
+      CHECK(inserted);
+    }
+
+    CHECK(map.size() == ids.size());
+
+    // inserting again returns the existing state
+    {
+      bool inserted = true;
+      LockedImageStateRef state = map.Insert(
+          ids[5], LockingImageState(VK_NULL_HANDLE, imageInfo, eFrameRef_Read), &inserted);
+      CHECK_FALSE(inserted);
+      CHECK(state->maxRefType == eFrameRef_None);
+      state->maxRefType = eFrameRef_CompleteWrite;
+    }
+
+    CHECK(map.FindRead(ids[5])->maxRefType == eFrameRef_CompleteWrite);
+    CHECK(bool(map.FindWrite(ids[6])));
+    CHECK_FALSE(bool(map.FindRead(ResourceIDGen::GetNewUniqueID())));
+
+    CHECK(map.Erase(ids[6]));
+    CHECK_FALSE(map.Erase(ids[6]));
+    CHECK_FALSE(bool(map.FindWrite(ids[6])));
+    CHECK(map.size() == ids.size() - 1);
+  };
+
+  SECTION("Iteration is in ID order")
+  {
+    // insert in reverse order so the shards don't see sorted inserts
+    for(int i = ids.count() - 1; i >= 0; i--)
+      map.Insert(ids[i], LockingImageState(VK_NULL_HANDLE, imageInfo, eFrameRef_None));
+
+    rdcarray<ResourceId> visited;
+    map.ForEach([&visited](ResourceId id, LockingImageState &) { visited.push_back(id); });
+
+    CHECK(visited == ids);
+  };
+
+  SECTION("Concurrent inserts and lookups")
+  {
+    const int numThreads = 8;
+    rdcarray<Threading::ThreadHandle> threads;
+
+    for(int t = 0; t < numThreads; t++)
+    {
+      threads.push_back(Threading::CreateThread([&map, &ids, &imageInfo, t]() {
+        for(int i = t; i < ids.count(); i += numThreads)
+          map.Insert(ids[i], LockingImageState(VK_NULL_HANDLE, imageInfo, eFrameRef_None));
+
+        // every thread updates every image so the per-image locks are contended too
+        for(int pass = 0; pass < 10; pass++)
+        {
+          for(ResourceId id : ids)
+          {
+            LockedImageStateRef state = map.FindWrite(id);
+            if(state)
+              state->maxRefType = eFrameRef_Read;
+          }
+        }
+      }));
+    }
+
+    for(Threading::ThreadHandle th : threads)
+    {
+      Threading::JoinThread(th);
+      Threading::CloseThread(th);
+    }
+
+    CHECK(map.size() == ids.size());
+    for(ResourceId id : ids)
+      CHECK(map.FindRead(id)->maxRefType == eFrameRef_Read);
+  };
+};
+
+TEST_CASE("Benchmark ImageStateMap contention", "[imagestate][!benchmark]")
+{
+  ImageInfo imageInfo(VK_FORMAT_R8G8B8A8_UNORM, {16, 16, 1}, 1, 1, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+                      VK_SHARING_MODE_EXCLUSIVE);
+
+  const int numThreads = 8;
+  const int numLookups = 20000;
+
+  rdcarray<ResourceId> ids;
+  for(int i = 0; i < 1024; i++)
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+
+  // the previous layout: one map behind a single lock
+  std::map<ResourceId, LockingImageState> singleMap;
+  Threading::CriticalSection singleLock;
+
+  ImageStateMap map;
+
+  for(ResourceId id : ids)
+  {
+    singleMap.insert({id, LockingImageState(VK_NULL_HANDLE, imageInfo, eFrameRef_None)});
+    map.Insert(id, LockingImageState(VK_NULL_HANDLE, imageInfo, eFrameRef_None));
+  }
+
+  // each thread looks up images the way a submit does, as if recording command buffers that
+  // reference a disjoint set of images
+  auto runThreads = [&ids](std::function<void(ResourceId)> lookup) {
+    rdcarray<Threading::ThreadHandle> threads;
+    for(int t = 0; t < numThreads; t++)
+    {
+      threads.push_back(Threading::CreateThread([&ids, lookup, t]() {
+        for(int i = 0; i < numLookups; i++)
+          lookup(ids[(i * numThreads + t) % ids.count()]);
+      }));
+    }
+
+    for(Threading::ThreadHandle th : threads)
+    {
+      Threading::JoinThread(th);
+      Threading::CloseThread(th);
+    }
+  };
+
+  BENCHMARK("Single lock")
+  {
+    runThreads([&singleMap, &singleLock](ResourceId id) {
+      LockedImageStateRef state;
+      {
+        SCOPED_LOCK(singleLock);
+        state = singleMap.find(id)->second.LockWrite();
+      }
+      state->maxRefType = eFrameRef_Read;
+    });
+  }
+
+  BENCHMARK("Sharded map")
+  {
+    runThreads([&map](ResourceId id) { map.FindWrite(id)->maxRefType = eFrameRef_Read; });
+  }
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
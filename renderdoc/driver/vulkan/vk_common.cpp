@@ -344,6 +344,10 @@ bool VkInitParams::IsSupportedVersion(uint64_t ver)
   if(ver == CurrentVersion)
     return true;
 
+  // 0x12 -> 0x13 - chunk callstacks captured in the frame are stored as IDs into a callstack table
+  if(ver == 0x12)
+    return true;
+
   // 0x11 -> 0x12 - added inline uniform block support
   if(ver == 0x11)
     return true;
@@ -26,6 +26,7 @@
 #include <ctype.h>
 #include <algorithm>
 #include "driver/ihv/amd/amd_rgp.h"
+#include "core/settings.h"
 #include "driver/shaders/spirv/spirv_compile.h"
 #include "jpeg-compressor/jpge.h"
 #include "maths/formatpacking.h"
@@ -36,6 +37,8 @@
 
 #include "stb/stb_image_write.h"
 
+RDOC_EXTERN_CONFIG(bool, Capture_BackgroundFileWriting);
+
 uint64_t VkInitParams::GetSerialiseSize()
 {
   // misc bytes and fixed integer members
@@ -168,6 +171,11 @@ WrappedVulkan::WrappedVulkan()
 
 WrappedVulkan::~WrappedVulkan()
 {
+  // make sure any capture still being written in the background is on disk before the application
+  // has a chance to exit.
+  if(IsCaptureMode(m_State))
+    RenderDoc::Inst().SyncCaptureWriteThread();
+
   // records must be deleted before resource manager shutdown
   if(m_FrameCaptureRecord)
   {
@@ -1568,7 +1576,6 @@ void WrappedVulkan::FirstFrame()
 template <typename SerialiserType>
 bool WrappedVulkan::Serialise_BeginCaptureFrame(SerialiserType &ser)
 {
-  SCOPED_LOCK(m_ImageStatesLock);
   GetResourceManager()->SerialiseImageStates(ser, m_ImageStates);
   SERIALISE_CHECK_READ_ERRORS();
 
@@ -1646,13 +1653,8 @@ void WrappedVulkan::StartFrameCapture(void *dev, void *wnd)
 
     RDCDEBUG("Attempting capture");
     m_FrameCaptureRecord->DeleteChunks();
-    {
-      SCOPED_LOCK(m_ImageStatesLock);
-      for(auto it = m_ImageStates.begin(); it != m_ImageStates.end(); ++it)
-      {
-        it->second.LockWrite()->BeginCapture();
-      }
-    }
+    m_ImageStates.ForEach(
+        [](ResourceId, LockingImageState &state) { state.LockWrite()->BeginCapture(); });
 
     m_State = CaptureState::ActiveCapturing;
   }
@@ -1971,31 +1973,40 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
     }
   }
 
-  RDCFile *rdc =
-      RenderDoc::Inst().CreateRDC(RDCDriver::Vulkan, m_CapturedFrames.back().frameNumber, fp);
+  SectionProperties props;
 
-  StreamWriter *captureWriter = NULL;
+  // Compress with LZ4 so that it's fast
+  props.flags = SectionFlags::LZ4Compressed;
+  props.version = m_SectionVersion;
+  props.type = SectionType::FrameCapture;
 
-  if(rdc)
-  {
-    SectionProperties props;
+  const bool backgroundWrite = Capture_BackgroundFileWriting();
+
+  RDCFile *rdc = NULL;
 
-    // Compress with LZ4 so that it's fast
-    props.flags = SectionFlags::LZ4Compressed;
-    props.version = m_SectionVersion;
-    props.type = SectionType::FrameCapture;
+  StreamWriter *captureWriter = NULL;
 
-    captureWriter = rdc->WriteSection(props);
+  if(backgroundWrite)
+  {
+    // serialise the frame into memory, then the file is created, compressed and written on a
+    // background thread once we're done with the frame's resources.
+    captureWriter = new StreamWriter(StreamWriter::DefaultScratchSize);
   }
   else
   {
-    captureWriter = new StreamWriter(StreamWriter::InvalidStream);
+    rdc = RenderDoc::Inst().CreateRDC(RDCDriver::Vulkan, m_CapturedFrames.back().frameNumber, fp);
+
+    if(rdc)
+      captureWriter = rdc->WriteSection(props);
+    else
+      captureWriter = new StreamWriter(StreamWriter::InvalidStream);
   }
 
   {
-    WriteSerialiser ser(captureWriter, Ownership::Stream);
+    WriteSerialiser ser(captureWriter, backgroundWrite ? Ownership::Nothing : Ownership::Stream);
 
     ser.SetChunkMetadataRecording(GetThreadSerialiser().GetChunkMetadataRecording());
+    ser.SetCallstackIDs(&RenderDoc::Inst().GetCaptureCallstackIDs());
 
     ser.SetUserData(GetResourceManager());
 
@@ -2040,7 +2051,7 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
       RDCDEBUG("Flushing %u command buffer records to file serialiser",
                (uint32_t)m_CmdBufferRecords.size());
 
-      std::map<int64_t, Chunk *> recordlist;
+      RecordChunkList recordlist;
 
       // ensure all command buffer records within the frame evne if recorded before, but
       // otherwise order must be preserved (vs. queue submits and desc set updates)
@@ -2057,25 +2068,39 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
       RDCDEBUG("Flushing %u chunks to file serialiser from context record",
                (uint32_t)recordlist.size());
 
-      float num = float(recordlist.size());
+      rdcarray<Chunk *> chunks = recordlist.Merge();
+
+      float num = float(chunks.size());
       float idx = 0.0f;
 
-      for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
+      for(Chunk *chunk : chunks)
       {
         RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
         idx += 1.0f;
-        it->second->Write(ser);
+        chunk->Write(ser);
       }
 
       RDCDEBUG("Done");
     }
   }
 
-  RDCLOG("Captured Vulkan frame with %f MB capture section in %f seconds",
-         double(captureWriter->GetOffset()) / (1024.0 * 1024.0),
-         m_CaptureTimer.GetMilliseconds() / 1000.0);
+  if(backgroundWrite)
+  {
+    RDCLOG("Serialised Vulkan frame with %f MB capture section in %f seconds",
+           double(captureWriter->GetOffset()) / (1024.0 * 1024.0),
+           m_CaptureTimer.GetMilliseconds() / 1000.0);
 
-  RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
+    RenderDoc::Inst().FinishCaptureWritingAsync(
+        RDCDriver::Vulkan, m_CapturedFrames.back().frameNumber, fp, props, captureWriter);
+  }
+  else
+  {
+    RDCLOG("Captured Vulkan frame with %f MB capture section in %f seconds",
+           double(captureWriter->GetOffset()) / (1024.0 * 1024.0),
+           m_CaptureTimer.GetMilliseconds() / 1000.0);
+
+    RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
+  }
 
   m_HeaderChunk->Delete();
   m_HeaderChunk = NULL;
@@ -2296,6 +2321,9 @@ ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
   ser.SetStringDatabase(&m_StringDB);
   ser.SetUserData(GetResourceManager());
 
+  m_CallstackTable = rdc->GetCallstackTable();
+  ser.SetCallstackTable(m_CallstackTable);
+
   ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers, m_TimeBase, m_TimeFrequency);
 
   m_StructuredFile = &ser.GetStructuredFile();
@@ -2485,6 +2513,7 @@ ReplayStatus WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t sta
 
   if(IsLoading(m_State) || IsStructuredExporting(m_State))
   {
+    ser.SetCallstackTable(m_CallstackTable);
     ser.ConfigureStructuredExport(&GetChunkName, IsStructuredExporting(m_State), m_TimeBase,
                                   m_TimeFrequency);
 
@@ -2745,18 +2774,16 @@ void WrappedVulkan::ApplyInitialContents()
   // actually apply the initial contents here
   GetResourceManager()->ApplyInitialContents();
 
-  for(auto it = m_ImageStates.begin(); it != m_ImageStates.end(); ++it)
-  {
-    if(GetResourceManager()->HasCurrentResource(it->first))
-    {
-      it->second.LockWrite()->ResetToOldState(m_cleanupImageBarriers, GetImageTransitionInfo());
-    }
+  rdcarray<ResourceId> deadImages;
+  m_ImageStates.ForEach([this, &deadImages](ResourceId id, LockingImageState &state) {
+    if(GetResourceManager()->HasCurrentResource(id))
+      state.LockWrite()->ResetToOldState(m_cleanupImageBarriers, GetImageTransitionInfo());
     else
-    {
-      it = m_ImageStates.erase(it);
-      --it;
-    }
-  }
+      deadImages.push_back(id);
+  });
+
+  for(ResourceId id : deadImages)
+    m_ImageStates.Erase(id);
 
   // likewise again to make sure the initial states are all applied
   cmd = GetNextCmd();
@@ -2865,6 +2892,27 @@ bool WrappedVulkan::ContextProcessChunk(ReadSerialiser &ser, VulkanChunk chunk)
   return true;
 }
 
+bool WrappedVulkan::ProcessStructuredChunk(ReadSerialiser &ser, VulkanChunk chunk)
+{
+  ser.SetStringDatabase(&m_StringDB);
+  ser.SetUserData(GetResourceManager());
+
+  // the frame's first chunk isn't processed like the others, see ContextReplayLog
+  if((SystemChunk)chunk == SystemChunk::CaptureBegin)
+  {
+#if ENABLED(RDOC_RELEASE)
+    ser.SkipCurrentChunk();
+    return true;
+#else
+    return Serialise_BeginCaptureFrame(ser);
+#endif
+  }
+
+  m_ChunkMetadata = ser.ChunkMetadata();
+
+  return ProcessChunk(ser, chunk);
+}
+
 bool WrappedVulkan::ProcessChunk(ReadSerialiser &ser, VulkanChunk chunk)
 {
   switch(chunk)
@@ -3191,10 +3239,7 @@ bool WrappedVulkan::ProcessChunk(ReadSerialiser &ser, VulkanChunk chunk)
     case VulkanChunk::vkCmdSetLineStippleEXT:
       return Serialise_vkCmdSetLineStippleEXT(ser, VK_NULL_HANDLE, 0, 0);
     case VulkanChunk::ImageRefs:
-    {
-      SCOPED_LOCK(m_ImageStatesLock);
       return GetResourceManager()->Serialise_ImageRefs(ser, m_ImageStates);
-    }
     case VulkanChunk::vkGetSemaphoreCounterValue:
       return Serialise_vkGetSemaphoreCounterValue(ser, VK_NULL_HANDLE, VK_NULL_HANDLE, NULL);
     case VulkanChunk::vkWaitSemaphores:
@@ -4390,55 +4435,24 @@ void WrappedVulkan::InsertCommandQueueFamily(ResourceId cmdId, uint32_t queueFam
 }
 LockedImageStateRef WrappedVulkan::FindImageState(ResourceId id)
 {
-  SCOPED_LOCK(m_ImageStatesLock);
-  auto it = m_ImageStates.find(id);
-  if(it != m_ImageStates.end())
-    return it->second.LockWrite();
-  else
-    return LockedImageStateRef();
+  return m_ImageStates.FindWrite(id);
 }
 
 LockedConstImageStateRef WrappedVulkan::FindConstImageState(ResourceId id)
 {
-  SCOPED_LOCK(m_ImageStatesLock);
-  auto it = m_ImageStates.find(id);
-  if(it != m_ImageStates.end())
-    return it->second.LockRead();
-  else
-    return LockedConstImageStateRef();
+  return m_ImageStates.FindRead(id);
 }
 
 LockedImageStateRef WrappedVulkan::InsertImageState(VkImage wrappedHandle, ResourceId id,
                                                     const ImageInfo &info, FrameRefType refType,
                                                     bool *inserted)
 {
-  SCOPED_LOCK(m_ImageStatesLock);
-  auto it = m_ImageStates.find(id);
-  if(it != m_ImageStates.end())
-  {
-    if(inserted != NULL)
-      *inserted = false;
-    return it->second.LockWrite();
-  }
-  else
-  {
-    if(inserted != NULL)
-      *inserted = true;
-    it = m_ImageStates.insert({id, LockingImageState(wrappedHandle, info, refType)}).first;
-    return it->second.LockWrite();
-  }
+  return m_ImageStates.Insert(id, LockingImageState(wrappedHandle, info, refType), inserted);
 }
 
 bool WrappedVulkan::EraseImageState(ResourceId id)
 {
-  SCOPED_LOCK(m_ImageStatesLock);
-  auto it = m_ImageStates.find(id);
-  if(it != m_ImageStates.end())
-  {
-    m_ImageStates.erase(it);
-    return true;
-  }
-  return false;
+  return m_ImageStates.Erase(id);
 }
 
 void WrappedVulkan::UpdateImageStates(const rdcflatmap<ResourceId, ImageState> &dstStates)
@@ -4447,28 +4461,28 @@ void WrappedVulkan::UpdateImageStates(const rdcflatmap<ResourceId, ImageState> &
   // existing images. If there are a small number of images in total then it doesn't matter much,
   // and if there are a large number of images then it's better to do repeated map lookups rather
   // than spend time iterating linearly across the map for a sparse set of updates.
-  SCOPED_LOCK(m_ImageStatesLock);
   auto dstIt = dstStates.begin();
   ImageTransitionInfo info = GetImageTransitionInfo();
   while(dstIt != dstStates.end())
   {
     // find the entry. This is expected because images are only not in the map if we've never seen
     // them before, a rare case.
-    auto it = m_ImageStates.find(dstIt->first);
+    LockedImageStateRef state = m_ImageStates.FindWrite(dstIt->first);
 
     // insert the initial state if needed.
-    if(it == m_ImageStates.end())
-    {
-      it = m_ImageStates
-               .insert({dstIt->first,
-                        LockingImageState(dstIt->second.wrappedHandle, dstIt->second.GetImageInfo(),
-                                          info.GetDefaultRefType())})
-               .first;
-      dstIt->second.InitialState(*it->second.LockWrite());
+    if(!state)
+    {
+      bool inserted = false;
+      state = m_ImageStates.Insert(
+          dstIt->first, LockingImageState(dstIt->second.wrappedHandle, dstIt->second.GetImageInfo(),
+                                          info.GetDefaultRefType()),
+          &inserted);
+      if(inserted)
+        dstIt->second.InitialState(*state);
     }
 
     // merge in the info into the entry.
-    it->second.LockWrite()->Merge(dstIt->second, info);
+    state->Merge(dstIt->second, info);
     ++dstIt;
   }
 }
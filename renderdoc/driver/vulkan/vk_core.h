@@ -53,7 +53,7 @@ struct VkInitParams
   uint64_t GetSerialiseSize();
 
   // check if a frame capture section version is supported
-  static const uint64_t CurrentVersion = 0x12;
+  static const uint64_t CurrentVersion = 0x13;
   static bool IsSupportedVersion(uint64_t ver);
 };
 
@@ -321,6 +321,8 @@ private:
 
   VkInitParams m_InitParams;
   uint64_t m_SectionVersion;
+  // deduplicated chunk callstacks, owned by the RDCFile and only valid while loading
+  const CallstackTable *m_CallstackTable = NULL;
 
   StreamReader *m_FrameReader = NULL;
 
@@ -797,10 +799,8 @@ private:
   // used on replay side to track the queue family of command buffers and pools
   std::map<ResourceId, uint32_t> m_commandQueueFamilies;
 
-  // used both on capture and replay side to track image state. Only locked
-  // in capture
-  std::map<ResourceId, LockingImageState> m_ImageStates;
-  Threading::CriticalSection m_ImageStatesLock;
+  // used both on capture and replay side to track image state
+  ImageStateMap m_ImageStates;
 
   // find swapchain for an image
   std::map<RENDERDOC_WindowHandle, VkSwapchainKHR> m_SwapLookup;
@@ -1024,11 +1024,18 @@ public:
 
   ReplayStatus Initialise(VkInitParams &params, uint64_t sectionVersion, const ReplayOptions &opts);
   uint64_t GetLogVersion() { return m_SectionVersion; }
+  const CallstackTable *GetCallstackTable() { return m_CallstackTable; }
   void SetStructuredExport(uint64_t sectionVersion)
   {
     m_SectionVersion = sectionVersion;
     m_State = CaptureState::StructuredExport;
+
+    // nothing is created while exporting, so markers and object names can't go to this instance
+    if(VkMarkerRegion::vk == this)
+      VkMarkerRegion::vk = NULL;
   }
+  // decodes any single chunk while structured exporting, without reading any others first
+  bool ProcessStructuredChunk(ReadSerialiser &ser, VulkanChunk chunk);
   void Shutdown();
   void ReplayLog(uint32_t startEventID, uint32_t endEventID, ReplayLogType replayType);
   void ReplayDraw(VkCommandBuffer cmd, const DrawcallDescription &drawcall);
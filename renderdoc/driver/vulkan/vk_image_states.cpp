@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "vk_resources.h"
+#include "common/threading.h"
 
 ImageSubresourceRange ImageInfo::FullRange() const
 {
@@ -1496,3 +1497,70 @@ void ImageState::BeginCapture()
     it->SetState(state);
   }
 }
+
+LockedImageStateRef ImageStateMap::FindWrite(ResourceId id)
+{
+  Shard &shard = GetShard(id);
+  SCOPED_READLOCK(shard.lock);
+  auto it = shard.states.find(id);
+  if(it != shard.states.end())
+    return it->second.LockWrite();
+  else
+    return LockedImageStateRef();
+}
+
+LockedConstImageStateRef ImageStateMap::FindRead(ResourceId id)
+{
+  Shard &shard = GetShard(id);
+  SCOPED_READLOCK(shard.lock);
+  auto it = shard.states.find(id);
+  if(it != shard.states.end())
+    return it->second.LockRead();
+  else
+    return LockedConstImageStateRef();
+}
+
+LockedImageStateRef ImageStateMap::Insert(ResourceId id, const LockingImageState &state,
+                                          bool *inserted)
+{
+  Shard &shard = GetShard(id);
+  SCOPED_WRITELOCK(shard.lock);
+  auto it = shard.states.find(id);
+  if(it != shard.states.end())
+  {
+    if(inserted != NULL)
+      *inserted = false;
+    return it->second.LockWrite();
+  }
+  else
+  {
+    if(inserted != NULL)
+      *inserted = true;
+    it = shard.states.insert({id, state}).first;
+    return it->second.LockWrite();
+  }
+}
+
+bool ImageStateMap::Erase(ResourceId id)
+{
+  Shard &shard = GetShard(id);
+  SCOPED_WRITELOCK(shard.lock);
+  auto it = shard.states.find(id);
+  if(it != shard.states.end())
+  {
+    shard.states.erase(it);
+    return true;
+  }
+  return false;
+}
+
+size_t ImageStateMap::size()
+{
+  size_t ret = 0;
+  for(Shard &shard : m_Shards)
+  {
+    SCOPED_READLOCK(shard.lock);
+    ret += shard.states.size();
+  }
+  return ret;
+}
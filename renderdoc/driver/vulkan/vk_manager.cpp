@@ -265,21 +265,28 @@ void VulkanResourceManager::MergeBarriers(rdcarray<rdcpair<ResourceId, ImageRegi
 
 template <typename SerialiserType>
 void VulkanResourceManager::SerialiseImageStates(SerialiserType &ser,
-                                                 std::map<ResourceId, LockingImageState> &states)
+                                                 ImageStateMap &states)
 {
-  SERIALISE_ELEMENT_LOCAL(NumImages, (uint32_t)states.size());
+  // take a consistent snapshot of the states to write, without holding the map locked while
+  // serialising
+  rdcarray<TaggedImageState> srcStates;
+  if(ser.IsWriting())
+  {
+    states.ForEach([&srcStates](ResourceId id, LockingImageState &state) {
+      srcStates.push_back({id, *state.LockRead()});
+    });
+  }
 
-  auto srcit = states.begin();
+  SERIALISE_ELEMENT_LOCAL(NumImages, (uint32_t)srcStates.size());
 
   for(uint32_t i = 0; i < NumImages; i++)
   {
-    SERIALISE_ELEMENT_LOCAL(Image, (ResourceId)(srcit->first)).TypedAs("VkImage"_lit);
+    SERIALISE_ELEMENT_LOCAL(Image, ser.IsWriting() ? srcStates[i].id : ResourceId())
+        .TypedAs("VkImage"_lit);
     if(ser.IsWriting())
     {
-      LockedImageStateRef lockedState = srcit->second.LockWrite();
-      ::ImageState &ImageState = *lockedState;
+      ::ImageState &ImageState = srcStates[i].state;
       SERIALISE_ELEMENT(ImageState);
-      ++srcit;
     }
     else
     {
@@ -353,23 +360,21 @@ void VulkanResourceManager::SerialiseImageStates(SerialiserType &ser,
 
         if(IsLoading(m_State))
         {
-          auto stit = states.find(liveid);
-          if(stit == states.end())
+          LockedImageStateRef st = states.FindWrite(liveid);
+          if(!st)
           {
             imageState.subresourceStates.Unsplit();
-            states.insert({liveid, LockingImageState(imageState)});
+            states.Insert(liveid, LockingImageState(imageState));
           }
           else
           {
-            auto st = stit->second.LockWrite();
             st->MergeCaptureBeginState(imageState);
             st->subresourceStates.Unsplit();
           }
         }
         else if(IsActiveReplaying(m_State))
         {
-          auto current = states.find(liveid)->second.LockRead();
-          auto stit = states.find(liveid);
+          LockedConstImageStateRef current = states.FindRead(liveid);
           for(auto subit = imageState.subresourceStates.begin();
               subit != imageState.subresourceStates.end(); ++subit)
           {
@@ -395,9 +400,9 @@ void VulkanResourceManager::SerialiseImageStates(SerialiserType &ser,
   }
 }
 template void VulkanResourceManager::SerialiseImageStates(
-    WriteSerialiser &ser, std::map<ResourceId, LockingImageState> &states);
+    WriteSerialiser &ser, ImageStateMap &states);
 template void VulkanResourceManager::SerialiseImageStates(
-    ReadSerialiser &ser, std::map<ResourceId, LockingImageState> &states);
+    ReadSerialiser &ser, ImageStateMap &states);
 
 template <class SerialiserType>
 void DoSerialise(SerialiserType &ser, MemRefInterval &el)
@@ -496,7 +501,7 @@ template bool VulkanResourceManager::Serialise_DeviceMemoryRefs(WriteSerialiser
                                                                 rdcarray<MemRefInterval> &data);
 
 bool VulkanResourceManager::Serialise_ImageRefs(ReadSerialiser &ser,
-                                                std::map<ResourceId, LockingImageState> &states)
+                                                ImageStateMap &states)
 {
   rdcarray<ImgRefsPair> data;
   SERIALISE_ELEMENT(data);
@@ -512,14 +517,13 @@ bool VulkanResourceManager::Serialise_ImageRefs(ReadSerialiser &ser,
         continue;
       ResourceId liveid = GetLiveID(it->image);
 
-      auto stit = states.find(liveid);
-      if(stit == states.end())
+      LockedImageStateRef imst = states.FindWrite(liveid);
+      if(!imst)
       {
         RDCWARN("Found ImgRefs for unknown image");
       }
       else
       {
-        LockedImageStateRef imst = stit->second.LockWrite();
         imst->subresourceStates.FromImgRefs(it->imgRefs);
         FrameRefType maxRefType = eFrameRef_None;
         for(auto subit = imst->subresourceStates.begin(); subit != imst->subresourceStates.end();
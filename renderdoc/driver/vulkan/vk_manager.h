@@ -275,12 +275,12 @@ public:
                       uint32_t numBarriers, const VkImageMemoryBarrier *barriers);
 
   template <typename SerialiserType>
-  void SerialiseImageStates(SerialiserType &ser, std::map<ResourceId, LockingImageState> &states);
+  void SerialiseImageStates(SerialiserType &ser, ImageStateMap &states);
 
   template <typename SerialiserType>
   bool Serialise_DeviceMemoryRefs(SerialiserType &ser, rdcarray<MemRefInterval> &data);
 
-  bool Serialise_ImageRefs(ReadSerialiser &ser, std::map<ResourceId, LockingImageState> &states);
+  bool Serialise_ImageRefs(ReadSerialiser &ser, ImageStateMap &states);
 
   void InsertDeviceMemoryRefs(WriteSerialiser &ser);
 
@@ -299,14 +299,13 @@ rdcarray<TextureDescription> VulkanReplay::GetTextures()
 {
   rdcarray<TextureDescription> texs;
 
-  for(auto it = m_pDriver->m_ImageStates.begin(); it != m_pDriver->m_ImageStates.end(); ++it)
-  {
+  m_pDriver->m_ImageStates.ForEach([this, &texs](ResourceId id, LockingImageState &) {
     // skip textures that aren't from the capture
-    if(m_pDriver->GetResourceManager()->GetOriginalID(it->first) == it->first)
-      continue;
+    if(m_pDriver->GetResourceManager()->GetOriginalID(id) == id)
+      return;
 
-    texs.push_back(GetTexture(it->first));
-  }
+    texs.push_back(GetTexture(id));
+  });
 
   return texs;
 }
@@ -1941,16 +1940,15 @@ void VulkanReplay::SavePipelineState(uint32_t eventId)
   {
     size_t i = 0;
     m_VulkanPipelineState.images.resize(m_pDriver->m_ImageStates.size());
-    for(auto it = m_pDriver->m_ImageStates.begin(); it != m_pDriver->m_ImageStates.end(); ++it)
-    {
+    m_pDriver->m_ImageStates.ForEach([this, rm, &i](ResourceId id, LockingImageState &state) {
       VKPipe::ImageData &img = m_VulkanPipelineState.images[i];
 
-      if(rm->GetOriginalID(it->first) == it->first)
-        continue;
+      if(rm->GetOriginalID(id) == id)
+        return;
 
-      img.resourceId = rm->GetOriginalID(it->first);
+      img.resourceId = rm->GetOriginalID(id);
 
-      LockedConstImageStateRef imState = it->second.LockRead();
+      LockedConstImageStateRef imState = state.LockRead();
       img.layouts.resize(imState->subresourceStates.size());
       auto subIt = imState->subresourceStates.begin();
       for(size_t l = 0; l < img.layouts.size(); ++l, ++subIt)
@@ -1969,7 +1967,7 @@ void VulkanReplay::SavePipelineState(uint32_t eventId)
       }
 
       i++;
-    }
+    });
 
     m_VulkanPipelineState.images.resize(i);
   }
@@ -4265,5 +4263,37 @@ void Vulkan_ProcessStructured(RDCFile *rdc, SDFile &output)
     vulkan.GetStructuredFile().Swap(output);
 }
 
+class VulkanChunkDecoder : public IStructuredChunkDecoder
+{
+public:
+  VulkanChunkDecoder(uint64_t sectionVersion) : m_SectionVersion(sectionVersion)
+  {
+    m_Vulkan.SetStructuredExport(sectionVersion);
+    m_Vulkan.GetResourceManager()->SetState(m_Vulkan.GetState());
+  }
+
+  ChunkLookup GetChunkLookup() { return &WrappedVulkan::GetChunkName; }
+  bool DecodeChunk(ReadSerialiser &ser, uint32_t chunkID)
+  {
+    return m_Vulkan.ProcessStructuredChunk(ser, (VulkanChunk)chunkID);
+  }
+  IStructuredChunkDecoder *Clone() { return new VulkanChunkDecoder(m_SectionVersion); }
+
+private:
+  uint64_t m_SectionVersion;
+  WrappedVulkan m_Vulkan;
+};
+
+IStructuredChunkDecoder *Vulkan_CreateStructuredDecoder(RDCFile *rdc)
+{
+  int sectionIdx = rdc->SectionIndex(SectionType::FrameCapture);
+
+  if(sectionIdx < 0)
+    return NULL;
+
+  return new VulkanChunkDecoder(rdc->GetSectionProperties(sectionIdx).version);
+}
+
 static StructuredProcessRegistration VulkanProcessRegistration(RDCDriver::Vulkan,
-                                                               &Vulkan_ProcessStructured);
+                                                               &Vulkan_ProcessStructured,
+                                                               &Vulkan_CreateStructuredDecoder);
@@ -144,6 +144,21 @@ struct TypedRealHandle
   bool operator!=(const TypedRealHandle o) const { return !(*this == o); }
 };
 
+// used for the wrapper map lookup. NULL hashes the same regardless of type to match operator==
+namespace std
+{
+template <>
+struct hash<TypedRealHandle>
+{
+  std::size_t operator()(const TypedRealHandle &h) const
+  {
+    if(h.real.handle == 0)
+      return 0;
+    return std::hash<uint64_t>()(h.real.handle ^ (uint64_t(h.type) << 56));
+  }
+};
+}
+
 struct WrappedVkNonDispRes : public WrappedVkRes
 {
   template <typename T>
@@ -1791,6 +1806,59 @@ private:
   ImageState m_state;
   Threading::SpinLock m_lock;
 };
+
+// map from image ID to its state, used both on capture and replay side. The map is split into
+// shards by ID, each with its own read-write lock, so lookups from different threads don't contend
+// and only inserting or erasing an image takes a write lock on one shard. The states themselves are
+// protected by their own lock in LockingImageState, as before.
+class ImageStateMap
+{
+public:
+  LockedImageStateRef FindWrite(ResourceId id);
+  LockedConstImageStateRef FindRead(ResourceId id);
+
+  // returns the existing state for id if there is one, otherwise inserts state
+  LockedImageStateRef Insert(ResourceId id, const LockingImageState &state, bool *inserted = NULL);
+  bool Erase(ResourceId id);
+
+  size_t size();
+
+  // calls callback(ResourceId, LockingImageState &) on each image in ID order. Every shard is read
+  // locked for the duration, so the callback must not insert or erase images.
+  template <typename Callback>
+  void ForEach(Callback callback)
+  {
+    rdcarray<rdcpair<ResourceId, LockingImageState *>> states;
+
+    for(Shard &shard : m_Shards)
+      shard.lock.ReadLock();
+
+    for(Shard &shard : m_Shards)
+      for(auto it = shard.states.begin(); it != shard.states.end(); ++it)
+        states.push_back({it->first, &it->second});
+
+    std::sort(states.begin(), states.end());
+
+    for(rdcpair<ResourceId, LockingImageState *> &st : states)
+      callback(st.first, *st.second);
+
+    for(Shard &shard : m_Shards)
+      shard.lock.ReadUnlock();
+  }
+
+private:
+  // a power of two, comfortably more than the number of threads expected to submit at once
+  static const size_t ShardCount = 16;
+
+  struct Shard
+  {
+    Threading::RWLock lock;
+    std::map<ResourceId, LockingImageState> states;
+  };
+
+  Shard &GetShard(ResourceId id) { return m_Shards[std::hash<ResourceId>()(id) % ShardCount]; }
+  Shard m_Shards[ShardCount];
+};
 struct TaggedImageState
 {
   ResourceId id;
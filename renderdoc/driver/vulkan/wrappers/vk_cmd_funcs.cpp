@@ -3225,7 +3225,7 @@ bool WrappedVulkan::Serialise_vkCmdUpdateBuffer(SerialiserType &ser, VkCommandBu
 
   // serialise as void* so it goes through as a buffer, not an actual array of integers.
   const void *Data = (const void *)pData;
-  SERIALISE_ELEMENT_ARRAY(Data, dataSize);
+  SERIALISE_ELEMENT_ARRAY_INPLACE(Data, dataSize);
 
   Serialise_DebugMessages(ser);
 
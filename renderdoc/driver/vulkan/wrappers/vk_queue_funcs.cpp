@@ -25,6 +25,9 @@
 #include <algorithm>
 #include "../vk_core.h"
 #include "../vk_debug.h"
+#include "core/settings.h"
+
+RDOC_EXTERN_CONFIG(uint32_t, Capture_MapDiffMergeGap);
 
 template <typename SerialiserType>
 bool WrappedVulkan::Serialise_vkGetDeviceQueue(SerialiserType &ser, VkDevice device,
@@ -1028,8 +1031,8 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
             continue;
           }
 
-          size_t diffStart = 0, diffEnd = 0;
-          bool found = true;
+          DiffRange diffs[MaxMapDiffRanges];
+          size_t numDiffs = 0;
 
           // this causes vkFlushMappedMemoryRanges call to allocate and copy to refData
           // from serialised buffer. We want to copy *precisely* the serialised data,
@@ -1119,37 +1122,44 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
             state.cpuReadPtr = state.mappedPtr;
           }
 
-          // if we have a previous set of data, compare.
+          // if we have a previous set of data, compare and only serialise the regions that changed.
           // otherwise just serialise it all
           if(state.refData)
-            found = FindDiffRange(((byte *)state.cpuReadPtr) + state.mapOffset, state.refData,
-                                  (size_t)state.mapSize, diffStart, diffEnd);
+          {
+            numDiffs = FindDiffRanges(((byte *)state.cpuReadPtr) + state.mapOffset, state.refData,
+                                      (size_t)state.mapSize, Capture_MapDiffMergeGap(), diffs,
+                                      ARRAY_COUNT(diffs));
+          }
           else
-            diffEnd = (size_t)state.mapSize;
+          {
+            diffs[0].start = 0;
+            diffs[0].end = (size_t)state.mapSize;
+            numDiffs = 1;
+          }
 
-          // sanitise diff start/end. Since the mapped pointer might be written on another thread
-          // (or even the GPU) this could cause a difference to appear and disappear transiently. In
-          // this case FindDiffRange could find the difference when locating the start but not find
-          // it when locating the end. In this case we don't need to write the difference (the
-          // application is responsible for ensuring it's not writing to memory the GPU might need)
-          if(diffEnd <= diffStart)
-            found = false;
+          // Since the mapped pointer might be written on another thread (or even the GPU) this
+          // could cause a difference to appear and disappear transiently. FindDiffRanges drops any
+          // ranges where that happens, and we don't need to write the difference (the application
+          // is responsible for ensuring it's not writing to memory the GPU might need)
 
-          if(found)
+          if(numDiffs > 0)
           {
             // MULTIDEVICE should find the device for this queue.
             // MULTIDEVICE only want to flush maps associated with this queue
             VkDevice dev = GetDev();
 
+            RDCLOG("Persistent map flush forced for %s (%u ranges, %llu -> %llu)",
+                   ToStr(record->GetResourceID()).c_str(), (uint32_t)numDiffs,
+                   (uint64_t)diffs[0].start, (uint64_t)diffs[numDiffs - 1].end);
+
+            for(size_t d = 0; d < numDiffs; d++)
             {
-              RDCLOG("Persistent map flush forced for %s (%llu -> %llu)",
-                     ToStr(record->GetResourceID()).c_str(), (uint64_t)diffStart, (uint64_t)diffEnd);
               VkMappedMemoryRange range = {
                   VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
                   &internalMemoryFlushMarker,
                   (VkDeviceMemory)(uint64_t)record->Resource,
-                  state.mapOffset + diffStart,
-                  diffEnd - diffStart,
+                  state.mapOffset + diffs[d].start,
+                  diffs[d].end - diffs[d].start,
               };
               vkFlushMappedMemoryRanges(dev, 1, &range);
             }
@@ -146,8 +146,26 @@ void SetTLSValue(uint64_t slot, void *value);
 
 // must typedef CriticalSectionTemplate<X> CriticalSection
 
+// a simple counting semaphore. Each Wake() releases up to that many threads blocked in
+// WaitForWake(), or lets that many future calls to WaitForWake() return immediately.
+class Semaphore
+{
+public:
+  static Semaphore *Create();
+  void Destroy();
+  void Wake(uint32_t numToWake);
+  void WaitForWake();
+
+protected:
+  Semaphore() = default;
+  ~Semaphore() = default;
+};
+
 void SetCurrentThreadName(const rdcstr &name);
 
+// returns the number of logical processors available to this process, always at least 1
+uint32_t NumberOfCores();
+
 typedef uint64_t ThreadHandle;
 ThreadHandle CreateThread(std::function<void()> entryFunc);
 uint64_t GetCurrentID();
@@ -185,6 +203,12 @@ public:
   bool RecvDataBlocking(void *data, uint32_t length);
   bool RecvDataNonBlocking(void *data, uint32_t &length);
 
+  // sends both buffers in order, in a single call where possible
+  bool SendDataBlocking(const void *buf, uint32_t length, const void *buf2, uint32_t length2);
+  // blocks until at least minLength bytes are received, but receives up to length bytes if they're
+  // already available. length is updated with the number of bytes received.
+  bool RecvDataBlocking(void *data, uint32_t minLength, uint32_t &length);
+
 private:
   ptrdiff_t socket;
   uint32_t timeoutMS;
@@ -330,6 +354,14 @@ void logfile_close(LogFileHandle *logHandle, const char *deleteFilename);
 // may fail on the shared logfile
 rdcstr logfile_readall(uint64_t offset, const char *filename);
 
+// functions for memory-mapping a range of an open file. The mapping is copy-on-write, so the data
+// can be modified in memory without affecting the file, and it remains valid after the file is
+// closed. If the file can't be mapped NULL is returned and it should be read normally.
+struct FileMapping;
+FileMapping *mapfile_open(FILE *f, uint64_t offset, uint64_t length);
+byte *mapfile_data(FileMapping *mapping);
+void mapfile_close(FileMapping *mapping);
+
 // utility functions
 inline bool WriteAll(const rdcstr &filename, const void *buffer, size_t size)
 {
@@ -27,18 +27,257 @@
 #define _GNU_SOURCE
 #endif
 
+#include <cxxabi.h>
+#include <elf.h>
 #include <execinfo.h>
 #include <link.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include "common/common.h"
 #include "common/formatting.h"
+#include "common/threading.h"
+#include "core/core.h"
+#include "core/settings.h"
 #include "os/os_specific.h"
+#include "strings/string_utils.h"
+
+RDOC_CONFIG(bool, Linux_Callstack_FramePointerWalk, false,
+            "Collect callstacks by walking frame pointers instead of with backtrace(), which is "
+            "much faster but only gives complete callstacks when the application, its libraries "
+            "and RenderDoc (see the ENABLE_FRAME_POINTERS CMake option) are compiled with "
+            "-fno-omit-frame-pointer.");
 
 void *renderdocBase = NULL;
 void *renderdocEnd = NULL;
 
+// frame records are {previous frame pointer, return address} on these architectures
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#define FRAME_POINTER_WALK OPTION_ON
+#else
+#define FRAME_POINTER_WALK OPTION_OFF
+#endif
+
+// the executable mappings in the process, used to validate return addresses while walking frame
+// pointers. Snapshots are immutable once published so walking threads never need to lock.
+struct ExecutableRanges
+{
+  rdcarray<rdcpair<uint64_t, uint64_t>> ranges;
+  // the number of objects loaded by the dynamic linker when this snapshot was taken
+  uint64_t numLoads = 0;
+
+  bool Contains(uint64_t addr) const
+  {
+    auto it = std::upper_bound(
+        ranges.begin(), ranges.end(), addr,
+        [](uint64_t a, const rdcpair<uint64_t, uint64_t> &r) { return a < r.first; });
+
+    if(it == ranges.begin())
+      return false;
+
+    --it;
+    return addr < it->second;
+  }
+};
+
+static std::atomic<ExecutableRanges *> execRanges(NULL);
+static Threading::CriticalSection execRangesLock;
+// previous snapshots may still be in use by other threads, so they're never freed
+static rdcarray<ExecutableRanges *> retiredExecRanges;
+
+static int count_loads_callback(struct dl_phdr_info *info, size_t size, void *data)
+{
+  *(uint64_t *)data = info->dlpi_adds;
+  return 1;
+}
+
+static uint64_t CountLoadedObjects()
+{
+  uint64_t numLoads = 0;
+  dl_iterate_phdr(count_loads_callback, &numLoads);
+  return numLoads;
+}
+
+static void ReadProcessMaps(ExecutableRanges *exec)
+{
+  FILE *f = FileIO::fopen("/proc/self/maps", "r");
+
+  if(!f)
+    return;
+
+  while(!feof(f))
+  {
+    char line[512] = {0};
+    if(fgets(line, 511, f))
+    {
+      void *base = NULL, *end = NULL;
+      char perms[8] = {0};
+      if(sscanf(line, "%p-%p %4s", &base, &end, perms) != 3 || perms[2] != 'x')
+        continue;
+
+      if(strstr(line, "librenderdoc") && renderdocBase == NULL)
+      {
+        renderdocBase = base;
+        renderdocEnd = end;
+      }
+
+      if(exec)
+        exec->ranges.push_back({(uint64_t)base, (uint64_t)end});
+    }
+  }
+
+  FileIO::fclose(f);
+
+  if(exec)
+    std::sort(exec->ranges.begin(), exec->ranges.end());
+}
+
+// re-reads the mappings if a library has been loaded since the given snapshot was taken
+static ExecutableRanges *RefreshExecutableRanges(ExecutableRanges *prev)
+{
+  uint64_t numLoads = CountLoadedObjects();
+
+  if(prev && prev->numLoads == numLoads)
+    return prev;
+
+  SCOPED_LOCK(execRangesLock);
+
+  ExecutableRanges *cur = execRanges.load(std::memory_order_acquire);
+  if(cur && cur->numLoads == numLoads)
+    return cur;
+
+  ExecutableRanges *exec = new ExecutableRanges;
+  exec->numLoads = numLoads;
+  ReadProcessMaps(exec);
+
+  if(cur)
+    retiredExecRanges.push_back(cur);
+  execRanges.store(exec, std::memory_order_release);
+
+  return exec;
+}
+
+static const size_t MaxCallstackLevels = 128;
+
+// per-thread state for frame pointer walks
+struct FramePointerThreadState
+{
+  uintptr_t stackLow = 0;
+  uintptr_t stackHigh = 0;
+
+  // if a walk didn't make it out of our own frames then frame pointers are omitted somewhere on
+  // this thread's path into us. Other threads may come in through code that keeps them
+  bool walkFailed = false;
+};
+
+static pthread_key_t framePointerStateKey;
+static pthread_once_t framePointerStateOnce = PTHREAD_ONCE_INIT;
+
+static void DeleteFramePointerState(void *state)
+{
+  delete(FramePointerThreadState *)state;
+}
+
+static void CreateFramePointerStateKey()
+{
+  pthread_key_create(&framePointerStateKey, &DeleteFramePointerState);
+}
+
+static FramePointerThreadState *GetFramePointerState()
+{
+  pthread_once(&framePointerStateOnce, &CreateFramePointerStateKey);
+
+  FramePointerThreadState *state =
+      (FramePointerThreadState *)pthread_getspecific(framePointerStateKey);
+
+  if(state)
+    return state;
+
+  state = new FramePointerThreadState;
+
+  // frame pointers are only followed while they're within this thread's stack, so a broken chain
+  // from code built without frame pointers can't make us read unmapped memory
+  pthread_attr_t attr;
+  if(pthread_getattr_np(pthread_self(), &attr) == 0)
+  {
+    void *stackAddr = NULL;
+    size_t stackSize = 0;
+    if(pthread_attr_getstack(&attr, &stackAddr, &stackSize) == 0)
+    {
+      state->stackLow = (uintptr_t)stackAddr;
+      state->stackHigh = (uintptr_t)stackAddr + stackSize;
+    }
+    pthread_attr_destroy(&attr);
+  }
+
+  pthread_setspecific(framePointerStateKey, state);
+
+  return state;
+}
+
+// walks the frame pointer chain from the caller, returning the number of levels written to addrs
+static size_t WalkFramePointers(FramePointerThreadState *state, uint64_t *addrs,
+                                size_t maxLevels)
+{
+#if ENABLED(FRAME_POINTER_WALK)
+  if(state->stackHigh == 0)
+    return 0;
+
+  ExecutableRanges *exec = execRanges.load(std::memory_order_acquire);
+  if(exec == NULL)
+    exec = RefreshExecutableRanges(NULL);
+
+  uintptr_t fp = (uintptr_t)__builtin_frame_address(0);
+  size_t numLevels = 0;
+
+  while(numLevels < maxLevels)
+  {
+    if((fp & (sizeof(uintptr_t) - 1)) != 0 || fp < state->stackLow ||
+       fp + sizeof(uintptr_t) * 2 > state->stackHigh)
+      break;
+
+    const uintptr_t *frame = (const uintptr_t *)fp;
+
+    uint64_t ret = (uint64_t)frame[1];
+
+    if(!exec->Contains(ret))
+    {
+      // this may be in a library that was loaded after the mappings were read
+      exec = RefreshExecutableRanges(exec);
+      if(!exec->Contains(ret))
+        break;
+    }
+
+    addrs[numLevels++] = ret;
+
+    // the stack grows down, so each caller's frame must be above its callee's
+    if(frame[0] <= fp)
+      break;
+
+    fp = frame[0];
+  }
+
+  return numLevels;
+#else
+  return 0;
+#endif
+}
+
+static size_t TrimRenderDocFrames(uint64_t *addrs, size_t numLevels)
+{
+  size_t offs = 0;
+  while(offs < numLevels && addrs[offs] >= (uint64_t)renderdocBase &&
+        addrs[offs] < (uint64_t)renderdocEnd)
+    offs++;
+
+  memmove(addrs, addrs + offs, (numLevels - offs) * sizeof(uint64_t));
+
+  return numLevels - offs;
+}
+
 class LinuxCallstack : public Callstack::Stackwalk
 {
 public:
@@ -64,28 +303,41 @@ private:
 
   void Collect()
   {
+    numLevels = 0;
+
+    if(Linux_Callstack_FramePointerWalk())
+    {
+      FramePointerThreadState *state = GetFramePointerState();
+
+      if(!state->walkFailed)
+      {
+        numLevels =
+            TrimRenderDocFrames(addrs, WalkFramePointers(state, addrs, ARRAY_COUNT(addrs)));
+
+        if(numLevels > 0)
+          return;
+
+        state->walkFailed = true;
+        RDCWARN("Frame pointer walk failed on thread %llu, falling back to backtrace()",
+                Threading::GetCurrentID());
+      }
+    }
+
     void *addrs_ptr[ARRAY_COUNT(addrs)];
 
     int ret = backtrace(addrs_ptr, ARRAY_COUNT(addrs));
 
-    numLevels = 0;
     if(ret > 0)
       numLevels = (size_t)ret;
 
-    int offs = 0;
-    // if we want to trim levels of the stack, we can do that here
-    // by incrementing offs and decrementing numLevels
-    while(numLevels > 0 && addrs_ptr[offs] >= renderdocBase && addrs_ptr[offs] < renderdocEnd)
-    {
-      offs++;
-      numLevels--;
-    }
-
     for(size_t i = 0; i < numLevels; i++)
-      addrs[i] = (uint64_t)addrs_ptr[i + offs];
+      addrs[i] = (uint64_t)addrs_ptr[i];
+
+    // if we want to trim levels of the stack, we can do that here
+    numLevels = TrimRenderDocFrames(addrs, numLevels);
   }
 
-  uint64_t addrs[128];
+  uint64_t addrs[MaxCallstackLevels];
   size_t numLevels;
 };
 
@@ -93,26 +345,11 @@ namespace Callstack
 {
 void Init()
 {
-  // look for our own line
-  FILE *f = FileIO::fopen("/proc/self/maps", "r");
-
-  if(f)
-  {
-    while(!feof(f))
-    {
-      char line[512] = {0};
-      if(fgets(line, 511, f))
-      {
-        if(strstr(line, "librenderdoc") && strstr(line, "r-xp"))
-        {
-          sscanf(line, "%p-%p", &renderdocBase, &renderdocEnd);
-          break;
-        }
-      }
-    }
-
-    FileIO::fclose(f);
-  }
+  // look for our own line, and read the executable mappings once up front for frame pointer walks
+  if(Linux_Callstack_FramePointerWalk())
+    RefreshExecutableRanges(NULL);
+  else
+    ReadProcessMaps(NULL);
 }
 
 Stackwalk *Collect()
@@ -191,88 +428,765 @@ struct LookupModule
   char path[2048];
 };
 
-class LinuxResolver : public Callstack::StackResolver
+// the subset of DWARF constants needed to decode line tables
+enum
+{
+  DW_LNS_copy = 1,
+  DW_LNS_advance_pc = 2,
+  DW_LNS_advance_line = 3,
+  DW_LNS_set_file = 4,
+  DW_LNS_const_add_pc = 8,
+  DW_LNS_fixed_advance_pc = 9,
+
+  DW_LNE_end_sequence = 1,
+  DW_LNE_set_address = 2,
+  DW_LNE_define_file = 3,
+
+  DW_LNCT_path = 1,
+  DW_LNCT_directory_index = 2,
+
+  DW_FORM_data2 = 0x05,
+  DW_FORM_data4 = 0x06,
+  DW_FORM_data8 = 0x07,
+  DW_FORM_string = 0x08,
+  DW_FORM_block = 0x09,
+  DW_FORM_data1 = 0x0b,
+  DW_FORM_strp = 0x0e,
+  DW_FORM_udata = 0x0f,
+  DW_FORM_data16 = 0x1e,
+  DW_FORM_line_strp = 0x1f,
+};
+
+// bounds-checked reader over a DWARF section. Any read past the end sets the error flag and
+// returns 0, so parsing can check once at convenient points.
+struct DWARFReader
+{
+  const byte *cur;
+  const byte *end;
+  bool error;
+
+  DWARFReader(const byte *data, size_t size) : cur(data), end(data + size), error(false) {}
+  bool AtEnd() const { return error || cur >= end; }
+  bool Skip(uint64_t bytes)
+  {
+    if(error || bytes > uint64_t(end - cur))
+    {
+      error = true;
+      return false;
+    }
+    cur += bytes;
+    return true;
+  }
+
+  uint64_t Fixed(size_t bytes)
+  {
+    const byte *src = cur;
+    if(!Skip(bytes))
+      return 0;
+
+    // DWARF is in target byte order, we only resolve little-endian modules
+    uint64_t ret = 0;
+    for(size_t i = 0; i < bytes && i < sizeof(ret); i++)
+      ret |= uint64_t(src[i]) << (i * 8);
+    return ret;
+  }
+
+  uint8_t U8() { return (uint8_t)Fixed(1); }
+  uint16_t U16() { return (uint16_t)Fixed(2); }
+  uint32_t U32() { return (uint32_t)Fixed(4); }
+  uint64_t U64() { return Fixed(8); }
+  uint64_t ULEB()
+  {
+    uint64_t ret = 0;
+    uint32_t shift = 0;
+    while(!AtEnd())
+    {
+      byte b = *cur++;
+      if(shift < 64)
+        ret |= uint64_t(b & 0x7f) << shift;
+      shift += 7;
+      if((b & 0x80) == 0)
+        return ret;
+    }
+    error = true;
+    return 0;
+  }
+  int64_t SLEB()
+  {
+    int64_t ret = 0;
+    uint32_t shift = 0;
+    while(!AtEnd())
+    {
+      byte b = *cur++;
+      if(shift < 64)
+        ret |= int64_t(b & 0x7f) << shift;
+      shift += 7;
+      if((b & 0x80) == 0)
+      {
+        if(shift < 64 && (b & 0x40))
+          ret |= -(int64_t(1) << shift);
+        return ret;
+      }
+    }
+    error = true;
+    return 0;
+  }
+  const char *String()
+  {
+    const char *ret = (const char *)cur;
+    while(!AtEnd() && *cur)
+      cur++;
+    if(!Skip(1))
+      return "";
+    return ret;
+  }
+};
+
+// a view of a section's contents in the mapped ELF file
+struct ELFSection
+{
+  const byte *data = NULL;
+  size_t size = 0;
+};
+
+static const char *GetSectionString(const byte *data, size_t size, uint64_t offset)
+{
+  if(offset >= size || memchr(data + offset, 0, size - offset) == NULL)
+    return "";
+  return (const char *)data + offset;
+}
+
+static const char *GetSectionString(const ELFSection &section, uint64_t offset)
+{
+  return GetSectionString(section.data, section.size, offset);
+}
+
+// file index marking the end of a line table sequence
+static const uint32_t EndSequence = ~0U;
+
+// symbols and line tables loaded from a module's ELF file (or its separate debug file) so that
+// addresses can be resolved in-process, rather than running addr2line for every address.
+class ELFModule
 {
 public:
-  LinuxResolver(rdcarray<LookupModule> modules) { m_Modules = modules; }
-  Callstack::AddressDetails GetAddr(uint64_t addr)
+  // returns false if the file couldn't be read as an ELF at all
+  bool Load(const rdcstr &path)
   {
-    EnsureCached(addr);
+    if(!LoadFile(path))
+      return false;
 
-    return m_Cache[addr];
+    // look for a separate debug file if this one was stripped
+    if(m_Lines.empty() && !m_DebugLink.empty())
+    {
+      rdcstr dir = get_dirname(FileIO::GetFullPathname(path));
+
+      for(const rdcstr &debugPath : {dir + "/" + m_DebugLink, dir + "/.debug/" + m_DebugLink,
+                                     "/usr/lib/debug" + dir + "/" + m_DebugLink})
+      {
+        if(FileIO::exists(debugPath.c_str()) && LoadFile(debugPath))
+          break;
+      }
+    }
+
+    std::sort(m_Symbols.begin(), m_Symbols.end());
+
+    FinaliseLines();
+
+    RDCLOG("Loaded %zu symbols and %zu line entries for %s", m_Symbols.size(), m_Lines.size(),
+           path.c_str());
+
+    return true;
+  }
+
+  // addr is relative to the module's link-time base, as addr2line expects
+  void Resolve(uint64_t addr, Callstack::AddressDetails &ret) const
+  {
+    auto sym = std::upper_bound(m_Symbols.begin(), m_Symbols.end(), Symbol({addr, 0, 0}));
+    if(sym != m_Symbols.begin())
+    {
+      sym--;
+      // a call to a noreturn function can be the last instruction, so the end is inclusive to
+      // include its return address
+      if(sym->size == 0 || addr <= sym->addr + sym->size)
+        ret.function =
+            Demangle(GetSectionString(m_StringData.data(), m_StringData.size(), sym->name));
+    }
+
+    auto row = std::upper_bound(m_Lines.begin(), m_Lines.end(), LineRow({addr, 0, 0}));
+    if(row != m_Lines.begin())
+    {
+      row--;
+      if(row->file != EndSequence && row->file < m_Files.size())
+      {
+        ret.filename = m_Files[row->file];
+        ret.line = row->line;
+      }
+    }
   }
 
 private:
-  void EnsureCached(uint64_t addr)
+  struct Symbol
   {
-    auto it = m_Cache.insert(
-        std::pair<uint64_t, Callstack::AddressDetails>(addr, Callstack::AddressDetails()));
-    if(!it.second)
-      return;
+    uint64_t addr;
+    uint64_t size;
+    // offset in m_StringData
+    uint64_t name;
 
-    Callstack::AddressDetails &ret = it.first->second;
+    bool operator<(const Symbol &o) const { return addr < o.addr; }
+  };
 
-    ret.filename = "Unknown";
-    ret.line = 0;
-    ret.function = StringFormat::Fmt("0x%08llx", addr);
+  struct LineRow
+  {
+    uint64_t addr;
+    uint32_t file;
+    uint32_t line;
 
-    for(size_t i = 0; i < m_Modules.size(); i++)
+    bool operator<(const LineRow &o) const { return addr < o.addr; }
+  };
+
+  rdcarray<Symbol> m_Symbols;
+  // the string tables of any symbol tables loaded, concatenated
+  bytebuf m_StringData;
+
+  // line table rows from all sequences, sorted by address. Each sequence finishes with an
+  // EndSequence row marking the end of its address range.
+  rdcarray<LineRow> m_Lines;
+  rdcarray<rdcarray<LineRow>> m_Sequences;
+  rdcarray<rdcstr> m_Files;
+  std::map<rdcstr, uint32_t> m_FileLookup;
+
+  rdcstr m_DebugLink;
+
+  static rdcstr Demangle(const char *name)
+  {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+
+    if(status == 0 && demangled)
+    {
+      rdcstr ret = demangled;
+      free(demangled);
+      return ret;
+    }
+
+    return name;
+  }
+
+  bool LoadFile(const rdcstr &path)
+  {
+    FILE *f = FileIO::fopen(path.c_str(), "rb");
+
+    if(f == NULL)
+      return false;
+
+    FileIO::fseek64(f, 0, SEEK_END);
+    uint64_t size = FileIO::ftell64(f);
+    FileIO::fseek64(f, 0, SEEK_SET);
+
+    FileIO::FileMapping *mapping = FileIO::mapfile_open(f, 0, size);
+
+    FileIO::fclose(f);
+
+    if(mapping == NULL)
+      return false;
+
+    const byte *data = FileIO::mapfile_data(mapping);
+
+    bool ret = false;
+
+    if(size >= EI_NIDENT && memcmp(data, ELFMAG, SELFMAG) == 0 && data[EI_DATA] == ELFDATA2LSB)
     {
-      if(addr >= m_Modules[i].base && addr < m_Modules[i].end)
+      if(data[EI_CLASS] == ELFCLASS64)
+        ret = LoadELF<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(data, (size_t)size);
+      else if(data[EI_CLASS] == ELFCLASS32)
+        ret = LoadELF<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>(data, (size_t)size);
+    }
+
+    if(!ret)
+      RDCWARN("Couldn't read %s as a little-endian ELF file", path.c_str());
+
+    FileIO::mapfile_close(mapping);
+
+    return ret;
+  }
+
+  template <typename Ehdr, typename Shdr, typename Sym>
+  bool LoadELF(const byte *data, size_t size)
+  {
+    const Ehdr *ehdr = (const Ehdr *)data;
+
+    if(size < sizeof(Ehdr) || ehdr->e_shentsize != sizeof(Shdr) || ehdr->e_shoff > size ||
+       (size - ehdr->e_shoff) / sizeof(Shdr) < ehdr->e_shnum || ehdr->e_shstrndx >= ehdr->e_shnum)
+      return false;
+
+    const Shdr *sections = (const Shdr *)(data + ehdr->e_shoff);
+
+    auto sectionData = [&](const Shdr &sh) {
+      ELFSection ret;
+      if(sh.sh_type != SHT_NOBITS && sh.sh_offset <= size && sh.sh_size <= size - sh.sh_offset)
       {
-        RDCLOG("%llx relative to module %llx-%llx, with offset %llx", addr, m_Modules[i].base,
-               m_Modules[i].end, m_Modules[i].offset);
-        uint64_t relative = addr - m_Modules[i].base + m_Modules[i].offset;
-        rdcstr cmd = StringFormat::Fmt("addr2line -fCe \"%s\" 0x%llx", m_Modules[i].path, relative);
+        ret.data = data + sh.sh_offset;
+        ret.size = (size_t)sh.sh_size;
+      }
+      return ret;
+    };
 
-        RDCLOG(": %s", cmd.c_str());
+    ELFSection sectionNames = sectionData(sections[ehdr->e_shstrndx]);
 
-        FILE *f = ::popen(cmd.c_str(), "r");
+    ELFSection debugLine, debugLineStr, debugStr;
+    const Shdr *symtab = NULL, *dynsym = NULL;
 
-        char result[2048] = {0};
-        fread(result, 1, 2047, f);
+    for(uint32_t i = 0; i < ehdr->e_shnum; i++)
+    {
+      const Shdr &sh = sections[i];
+      rdcstr name = GetSectionString(sectionNames, sh.sh_name);
+
+      if(sh.sh_type == SHT_SYMTAB)
+        symtab = &sh;
+      else if(sh.sh_type == SHT_DYNSYM)
+        dynsym = &sh;
+      else if(name == ".gnu_debuglink")
+        m_DebugLink = GetSectionString(sectionData(sh), 0);
 
-        fclose(f);
+      if(name.beginsWith(".debug_") && (sh.sh_flags & SHF_COMPRESSED))
+      {
+        RDCWARN("Compressed debug section %s not supported", name.c_str());
+        continue;
+      }
 
-        char *line2 = strchr(result, '\n');
-        if(line2)
+      if(name == ".debug_line")
+        debugLine = sectionData(sh);
+      else if(name == ".debug_line_str")
+        debugLineStr = sectionData(sh);
+      else if(name == ".debug_str")
+        debugStr = sectionData(sh);
+    }
+
+    // prefer the full symbol table, but if the module has been stripped we can still get exported
+    // function names
+    if(symtab == NULL)
+      symtab = dynsym;
+
+    if(symtab && symtab->sh_link < ehdr->e_shnum)
+    {
+      ELFSection symData = sectionData(*symtab);
+      ELFSection strData = sectionData(sections[symtab->sh_link]);
+
+      // the mapping is closed after loading, so keep a copy of the names
+      uint64_t strBase = m_StringData.size();
+      m_StringData.append(strData.data, strData.size);
+
+      const Sym *syms = (const Sym *)symData.data;
+      for(size_t i = 0; i < symData.size / sizeof(Sym); i++)
+      {
+        if((syms[i].st_info & 0xf) == STT_FUNC && syms[i].st_value != 0 &&
+           syms[i].st_shndx != SHN_UNDEF)
+          m_Symbols.push_back({syms[i].st_value, syms[i].st_size, strBase + syms[i].st_name});
+      }
+    }
+
+    ParseDebugLine(debugLine, debugLineStr, debugStr);
+
+    return true;
+  }
+
+  uint32_t AddFile(const rdcstr &dir, const rdcstr &name)
+  {
+    rdcstr path = name;
+    if(!dir.empty() && name[0] != '/')
+      path = dir + "/" + name;
+
+    auto it = m_FileLookup.find(path);
+    if(it != m_FileLookup.end())
+      return it->second;
+
+    uint32_t ret = (uint32_t)m_Files.size();
+    m_Files.push_back(path);
+    m_FileLookup[path] = ret;
+    return ret;
+  }
+
+  void ParseDebugLine(const ELFSection &debugLine, const ELFSection &debugLineStr,
+                      const ELFSection &debugStr)
+  {
+    DWARFReader unit(debugLine.data, debugLine.size);
+
+    while(!unit.AtEnd())
+    {
+      bool dwarf64 = false;
+      uint64_t unitLength = unit.U32();
+      if(unitLength == 0xffffffff)
+      {
+        dwarf64 = true;
+        unitLength = unit.U64();
+      }
+
+      if(unit.error || unitLength > uint64_t(unit.end - unit.cur))
+        break;
+
+      // parse this unit on its own, and skip to the next even if it's malformed
+      DWARFReader rd(unit.cur, (size_t)unitLength);
+      unit.Skip(unitLength);
+
+      uint16_t version = rd.U16();
+      if(version < 2 || version > 5)
+      {
+        RDCWARN("Unsupported DWARF line table version %u", version);
+        continue;
+      }
+
+      uint8_t addressSize = 0;
+      if(version >= 5)
+      {
+        addressSize = rd.U8();
+        rd.U8();    // segment selector size
+      }
+
+      uint64_t headerLength = dwarf64 ? rd.U64() : rd.U32();
+      if(rd.error || headerLength > uint64_t(rd.end - rd.cur))
+        continue;
+
+      DWARFReader program(rd.cur + headerLength, size_t(rd.end - rd.cur - headerLength));
+
+      uint8_t minInstLength = rd.U8();
+      if(version >= 4)
+        rd.U8();    // max ops per instruction, only relevant for VLIW
+      rd.U8();      // default is_stmt
+      int8_t lineBase = (int8_t)rd.U8();
+      uint8_t lineRange = rd.U8();
+      uint8_t opcodeBase = rd.U8();
+
+      uint8_t opcodeLengths[256] = {};
+      for(uint8_t i = 1; i < opcodeBase; i++)
+        opcodeLengths[i] = rd.U8();
+
+      if(rd.error || lineRange == 0)
+        continue;
+
+      // the unit's files, indexed by the line program's file register
+      rdcarray<uint32_t> files;
+
+      if(version >= 5)
+      {
+        rdcarray<rdcstr> dirs;
+
+        if(!ParseEntryTable(rd, dwarf64, debugLineStr, debugStr, dirs, NULL) ||
+           !ParseEntryTable(rd, dwarf64, debugLineStr, debugStr, dirs, &files))
+          continue;
+      }
+      else
+      {
+        rdcarray<rdcstr> dirs;
+        // directory 0 is the compilation directory, which isn't in the line table header
+        dirs.push_back(rdcstr());
+        while(!rd.AtEnd() && *rd.cur)
+          dirs.push_back(rd.String());
+        rd.U8();
+
+        // file numbering starts at 1
+        files.push_back(EndSequence);
+        while(!rd.AtEnd() && *rd.cur)
         {
-          *line2 = 0;
-          line2++;
+          rdcstr name = rd.String();
+          uint64_t dir = rd.ULEB();
+          rd.ULEB();    // modification time
+          rd.ULEB();    // length
+          files.push_back(AddFile(dir < dirs.size() ? dirs[(size_t)dir] : rdcstr(), name));
         }
 
-        ret.function = result;
+        if(rd.error)
+          continue;
+      }
+
+      RunLineProgram(program, addressSize, minInstLength, lineBase, lineRange, opcodeBase,
+                     opcodeLengths, files);
+    }
+  }
+
+  // parse a DWARF 5 directory or file name table. If files is NULL the entries are directories
+  bool ParseEntryTable(DWARFReader &rd, bool dwarf64, const ELFSection &debugLineStr,
+                       const ELFSection &debugStr, rdcarray<rdcstr> &dirs,
+                       rdcarray<uint32_t> *files)
+  {
+    rdcarray<rdcpair<uint64_t, uint64_t>> formats;
+    formats.resize(rd.U8());
+    for(rdcpair<uint64_t, uint64_t> &fmt : formats)
+    {
+      fmt.first = rd.ULEB();
+      fmt.second = rd.ULEB();
+    }
 
-        if(line2)
+    uint64_t count = rd.ULEB();
+    for(uint64_t i = 0; i < count && !rd.error; i++)
+    {
+      rdcstr path;
+      uint64_t dir = 0;
+
+      for(const rdcpair<uint64_t, uint64_t> &fmt : formats)
+      {
+        rdcstr str;
+        uint64_t val = 0;
+
+        switch(fmt.second)
         {
-          char *linenum = line2 + strlen(line2) - 1;
-          while(linenum > line2 && *linenum != ':')
-            linenum--;
+          case DW_FORM_string: str = rd.String(); break;
+          case DW_FORM_line_strp:
+            str = GetSectionString(debugLineStr, dwarf64 ? rd.U64() : rd.U32());
+            break;
+          case DW_FORM_strp: str = GetSectionString(debugStr, dwarf64 ? rd.U64() : rd.U32()); break;
+          case DW_FORM_udata: val = rd.ULEB(); break;
+          case DW_FORM_data1: val = rd.U8(); break;
+          case DW_FORM_data2: val = rd.U16(); break;
+          case DW_FORM_data4: val = rd.U32(); break;
+          case DW_FORM_data8: val = rd.U64(); break;
+          case DW_FORM_data16: rd.Skip(16); break;
+          case DW_FORM_block: rd.Skip(rd.ULEB()); break;
+          default: RDCWARN("Unsupported form %llx in DWARF line table", fmt.second); return false;
+        }
 
-          ret.line = 0;
+        if(fmt.first == DW_LNCT_path)
+          path = str;
+        else if(fmt.first == DW_LNCT_directory_index)
+          dir = val;
+      }
 
-          if(*linenum == ':')
-          {
-            *linenum = 0;
-            linenum++;
+      if(files)
+        files->push_back(AddFile(dir < dirs.size() ? dirs[(size_t)dir] : rdcstr(), path));
+      else
+        dirs.push_back(path);
+    }
+
+    return !rd.error;
+  }
+
+  void RunLineProgram(DWARFReader &rd, uint8_t addressSize, uint8_t minInstLength, int8_t lineBase,
+                      uint8_t lineRange, uint8_t opcodeBase, const uint8_t *opcodeLengths,
+                      const rdcarray<uint32_t> &files)
+  {
+    uint64_t addr = 0;
+    uint64_t file = 1;
+    int64_t line = 1;
+
+    rdcarray<LineRow> sequence;
+
+    // DWARF 5 gives the address size up front, otherwise it's only known from DW_LNE_set_address
+    uint64_t tombstone = ~0ULL;
+    if(addressSize > 0 && addressSize < 8)
+      tombstone = (uint64_t(1) << (addressSize * 8)) - 1;
 
-            while(*linenum >= '0' && *linenum <= '9')
+    auto emitRow = [&]() {
+      uint32_t f = file < files.size() ? files[(size_t)file] : EndSequence;
+      if(f != EndSequence)
+        sequence.push_back({addr, f, (uint32_t)line});
+    };
+
+    while(!rd.AtEnd())
+    {
+      uint8_t opcode = rd.U8();
+
+      if(opcode >= opcodeBase)
+      {
+        uint8_t adjusted = opcode - opcodeBase;
+        addr += (adjusted / lineRange) * minInstLength;
+        line += lineBase + (adjusted % lineRange);
+        emitRow();
+        continue;
+      }
+
+      switch(opcode)
+      {
+        case 0:
+        {
+          uint64_t len = rd.ULEB();
+          const byte *next = rd.cur + len;
+          if(len == 0 || len > uint64_t(rd.end - rd.cur))
+            return;
+
+          uint8_t extended = rd.U8();
+
+          if(extended == DW_LNE_end_sequence)
+          {
+            // sequences for code that the linker discarded are left at address 0 (or a tombstone
+            // value), don't let them shadow real code.
+            if(!sequence.empty() && sequence[0].addr != 0 && sequence[0].addr != tombstone)
             {
-              ret.line *= 10;
-              ret.line += (uint32_t(*linenum) - uint32_t('0'));
-              linenum++;
+              sequence.push_back({addr, EndSequence, 0});
+              m_Sequences.push_back(std::move(sequence));
             }
+
+            sequence.clear();
+            addr = 0;
+            file = 1;
+            line = 1;
+          }
+          else if(extended == DW_LNE_set_address)
+          {
+            addr = rd.Fixed((size_t)len - 1);
+            if(len - 1 < 8)
+              tombstone = (uint64_t(1) << ((len - 1) * 8)) - 1;
           }
 
-          ret.filename = line2;
+          // skip any remaining operands, including DW_LNE_define_file which is deprecated
+          rd.cur = next;
+          break;
         }
+        case DW_LNS_copy: emitRow(); break;
+        case DW_LNS_advance_pc: addr += rd.ULEB() * minInstLength; break;
+        case DW_LNS_advance_line: line += rd.SLEB(); break;
+        case DW_LNS_set_file: file = rd.ULEB(); break;
+        case DW_LNS_const_add_pc: addr += ((255 - opcodeBase) / lineRange) * minInstLength; break;
+        case DW_LNS_fixed_advance_pc: addr += rd.U16(); break;
+        default:
+          // skip the operands of any opcodes we don't need
+          for(uint8_t i = 0; i < opcodeLengths[opcode]; i++)
+            rd.ULEB();
+          break;
+      }
+    }
+  }
 
-        break;
+  void FinaliseLines()
+  {
+    std::sort(m_Sequences.begin(), m_Sequences.end(),
+              [](const rdcarray<LineRow> &a, const rdcarray<LineRow> &b) {
+                return a[0].addr < b[0].addr;
+              });
+
+    size_t numRows = 0;
+    for(const rdcarray<LineRow> &seq : m_Sequences)
+      numRows += seq.size();
+
+    m_Lines.reserve(numRows);
+
+    for(rdcarray<LineRow> &seq : m_Sequences)
+    {
+      // rows within a sequence are already in address order
+      m_Lines.append(seq);
+    }
+
+    m_Sequences.clear();
+    m_FileLookup.clear();
+  }
+};
+
+// addr2line is used for modules we can't load ourselves
+static void ResolveWithAddr2Line(const char *path, uint64_t relative, AddressDetails &ret)
+{
+  rdcstr cmd = StringFormat::Fmt("addr2line -fCe \"%s\" 0x%llx", path, relative);
+
+  FILE *f = ::popen(cmd.c_str(), "r");
+
+  if(f == NULL)
+    return;
+
+  char result[2048] = {0};
+  fread(result, 1, 2047, f);
+
+  ::pclose(f);
+
+  char *line2 = strchr(result, '\n');
+  if(line2)
+  {
+    *line2 = 0;
+    line2++;
+  }
+
+  ret.function = result;
+
+  if(line2)
+  {
+    char *linenum = line2 + strlen(line2) - 1;
+    while(linenum > line2 && *linenum != ':')
+      linenum--;
+
+    ret.line = 0;
+
+    if(*linenum == ':')
+    {
+      *linenum = 0;
+      linenum++;
+
+      while(*linenum >= '0' && *linenum <= '9')
+      {
+        ret.line *= 10;
+        ret.line += (uint32_t(*linenum) - uint32_t('0'));
+        linenum++;
       }
     }
+
+    ret.filename = line2;
+  }
+}
+
+class LinuxResolver : public Callstack::StackResolver
+{
+public:
+  LinuxResolver(rdcarray<LookupModule> modules)
+  {
+    m_Modules = modules;
+    std::sort(m_Modules.begin(), m_Modules.end(),
+              [](const LookupModule &a, const LookupModule &b) { return a.base < b.base; });
+  }
+  ~LinuxResolver()
+  {
+    for(auto it = m_ELFs.begin(); it != m_ELFs.end(); ++it)
+      delete it->second;
+  }
+  Callstack::AddressDetails GetAddr(uint64_t addr)
+  {
+    EnsureCached(addr);
+
+    return m_Cache[addr];
+  }
+
+private:
+  void EnsureCached(uint64_t addr)
+  {
+    auto it = m_Cache.insert(
+        std::pair<uint64_t, Callstack::AddressDetails>(addr, Callstack::AddressDetails()));
+    if(!it.second)
+      return;
+
+    Callstack::AddressDetails &ret = it.first->second;
+
+    ret.filename = "Unknown";
+    ret.line = 0;
+    ret.function = StringFormat::Fmt("0x%08llx", addr);
+
+    // find the last module starting at or before this address
+    auto mod = std::upper_bound(
+        m_Modules.begin(), m_Modules.end(), addr,
+        [](uint64_t a, const LookupModule &m) { return a < m.base; });
+
+    if(mod == m_Modules.begin())
+      return;
+
+    mod--;
+
+    if(addr >= mod->end)
+      return;
+
+    uint64_t relative = addr - mod->base + mod->offset;
+
+    // each module file is only loaded once, the first time an address in it is resolved
+    auto elf = m_ELFs.find(mod->path);
+    if(elf == m_ELFs.end())
+    {
+      ELFModule *module = new ELFModule;
+      if(!module->Load(mod->path))
+        SAFE_DELETE(module);
+
+      elf = m_ELFs.insert(std::make_pair(rdcstr(mod->path), module)).first;
+    }
+
+    if(elf->second)
+      elf->second->Resolve(relative, ret);
+    else
+      ResolveWithAddr2Line(mod->path, relative, ret);
   }
 
   rdcarray<LookupModule> m_Modules;
+  std::map<rdcstr, ELFModule *> m_ELFs;
   std::map<uint64_t, Callstack::AddressDetails> m_Cache;
 };
 
@@ -363,3 +1277,163 @@ StackResolver *MakeResolver(bool interactive, byte *moduleDB, size_t DBSize,
   return new LinuxResolver(modules);
 }
 };
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "api/replay/structured_data.h"
+#include "catch/catch.hpp"
+
+TEST_CASE("Resolve callstack addresses in-process", "[callstack]")
+{
+  size_t size = 0;
+  Callstack::GetLoadedModules(NULL, size);
+
+  bytebuf moduleDB;
+  moduleDB.resize(size);
+  Callstack::GetLoadedModules(moduleDB.data(), size);
+
+  Callstack::StackResolver *resolver =
+      Callstack::MakeResolver(false, moduleDB.data(), moduleDB.size(), NULL);
+
+  REQUIRE(resolver);
+
+  // resolve an address part way into a function, as a return address would be
+  uint64_t addr = uint64_t(&Callstack::MakeResolver) + 4;
+
+  Callstack::AddressDetails details = resolver->GetAddr(addr);
+
+  CHECK(details.function.contains("Callstack::MakeResolver"));
+
+  // line information is only available in builds with debug info
+  if(details.filename != "Unknown")
+  {
+    CHECK(details.filename.endsWith("linux_callstack.cpp"));
+    CHECK(details.line > 0);
+  }
+
+  // cached results are identical
+  Callstack::AddressDetails cached = resolver->GetAddr(addr);
+  CHECK(cached.function == details.function);
+  CHECK(cached.filename == details.filename);
+  CHECK(cached.line == details.line);
+
+  // addresses outside any module aren't resolved
+  details = resolver->GetAddr(0x10);
+  CHECK(details.filename == "Unknown");
+  CHECK(details.function == "0x00000010");
+
+  delete resolver;
+};
+
+#if ENABLED(FRAME_POINTER_WALK)
+
+struct TestWalk
+{
+  uint64_t framePointer[MaxCallstackLevels];
+  size_t framePointerLevels = 0;
+  void *backtrace[MaxCallstackLevels];
+  size_t backtraceLevels = 0;
+};
+
+static __attribute__((noinline)) void WalkAtDepth(int depth, TestWalk &walk)
+{
+  if(depth > 0)
+  {
+    WalkAtDepth(depth - 1, walk);
+    // prevent this being turned into a tail call
+    asm volatile("");
+    return;
+  }
+
+  walk.framePointerLevels =
+      WalkFramePointers(GetFramePointerState(), walk.framePointer, MaxCallstackLevels);
+  walk.backtraceLevels = (size_t)backtrace(walk.backtrace, MaxCallstackLevels);
+}
+
+TEST_CASE("Walk callstacks with frame pointers", "[callstack]")
+{
+  TestWalk walks[2];
+
+  // walking twice from the same place finds the same callstack
+  for(int i = 0; i < 2; i++)
+    WalkAtDepth(16, walks[i]);
+
+  CHECK(walks[0].framePointerLevels == walks[1].framePointerLevels);
+  for(size_t i = 0; i < walks[0].framePointerLevels; i++)
+    CHECK(walks[0].framePointer[i] == walks[1].framePointer[i]);
+
+// optimised builds may omit frame pointers in our code, which ends the walk early
+#if !defined(__OPTIMIZE__)
+  TestWalk &walk = walks[0];
+
+  REQUIRE(walk.framePointerLevels > 16);
+  REQUIRE(walk.backtraceLevels > 16);
+
+  // the innermost frames return to different places, but every caller is the same
+  for(size_t i = 1; i < 16; i++)
+    CHECK(walk.framePointer[i] == (uint64_t)walk.backtrace[i]);
+#endif
+};
+
+TEST_CASE("Benchmark callstack collection", "[callstack][!benchmark]")
+{
+  TestWalk walk;
+
+  // each benchmark runs this many collections, after one first to read the process mappings
+  const int NumCollections = 1000;
+
+  FramePointerThreadState *state = GetFramePointerState();
+
+  walk.framePointerLevels = WalkFramePointers(state, walk.framePointer, MaxCallstackLevels);
+
+  BENCHMARK("backtrace() x1000")
+  {
+    for(int i = 0; i < NumCollections; i++)
+      walk.backtraceLevels = (size_t)backtrace(walk.backtrace, MaxCallstackLevels);
+  }
+
+  BENCHMARK("Frame pointer walk x1000")
+  {
+    for(int i = 0; i < NumCollections; i++)
+      walk.framePointerLevels = WalkFramePointers(state, walk.framePointer, MaxCallstackLevels);
+  }
+
+  RDCLOG("backtrace() found %llu levels, frame pointer walk found %llu levels",
+         (uint64_t)walk.backtraceLevels, (uint64_t)walk.framePointerLevels);
+
+  // if our own code is missing frame pointers, the walk can't get out of it to the caller and
+  // collection falls back to backtrace()
+  CHECK(TrimRenderDocFrames(walk.framePointer, walk.framePointerLevels) > 0);
+
+  // the whole collection path, which only uses the walk if it gets out of our own frames
+  SDObject *option = RenderDoc::Inst().SetConfigSetting("Linux_Callstack_FramePointerWalk");
+  REQUIRE(option);
+
+  const bool prevValue = option->data.basic.b;
+
+  size_t collectedLevels[2] = {};
+
+  for(bool useWalk : {false, true})
+  {
+    option->data.basic.b = useWalk;
+
+    BENCHMARK(useWalk ? "Collect with frame pointer walk x1000" : "Collect with backtrace() x1000")
+    {
+      for(int i = 0; i < NumCollections; i++)
+      {
+        Callstack::Stackwalk *stack = Callstack::Collect();
+        collectedLevels[useWalk] = stack->NumLevels();
+        delete stack;
+      }
+    }
+  }
+
+  option->data.basic.b = prevValue;
+
+  RDCLOG("Collect found %llu levels with backtrace(), %llu with the frame pointer walk",
+         (uint64_t)collectedLevels[0], (uint64_t)collectedLevels[1]);
+};
+
+#endif    // ENABLED(FRAME_POINTER_WALK)
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -27,11 +27,13 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include "api/replay/data_types.h"
@@ -143,30 +145,49 @@ Socket *Socket::AcceptClient(uint32_t timeoutMilliseconds)
   return NULL;
 }
 
-bool Socket::SendDataBlocking(const void *buf, uint32_t length)
+// sockets are always left non-blocking, so blocking operations wait for readiness with poll() up to
+// the socket's timeout. This avoids toggling the blocking mode and the SO_SNDTIMEO/SO_RCVTIMEO
+// timeouts around every send and receive, which cost several syscalls each time.
+static bool WaitForSocket(int socket, short events, uint32_t timeoutMS)
 {
-  if(length == 0)
-    return true;
+  pollfd fd = {};
+  fd.fd = socket;
+  fd.events = events;
 
-  uint32_t sent = 0;
+  int ret = 0;
+  do
+  {
+    // if we hit EINTR, just try again completely. Technically this restarts the timeout but we
+    // expect EINTR to be rare so it's not a big deal.
+    ret = poll(&fd, 1, (int)timeoutMS);
+  } while(ret < 0 && errno == EINTR);
 
-  char *src = (char *)buf;
+  return ret > 0;
+}
 
-  int flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
+bool Socket::SendDataBlocking(const void *buf, uint32_t length)
+{
+  return SendDataBlocking(buf, length, NULL, 0);
+}
+
+bool Socket::SendDataBlocking(const void *buf, uint32_t length, const void *buf2, uint32_t length2)
+{
+  if(length + length2 == 0)
+    return true;
 
-  timeval oldtimeout = {0};
-  socklen_t len = sizeof(oldtimeout);
-  getsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (char *)&oldtimeout, &len);
+  iovec iov[2] = {};
+  iov[0].iov_base = (void *)buf;
+  iov[0].iov_len = length;
+  iov[1].iov_base = (void *)buf2;
+  iov[1].iov_len = length2;
 
-  timeval timeout = {0};
-  timeout.tv_sec = (timeoutMS / 1000);
-  timeout.tv_usec = (timeoutMS % 1000) * 1000;
-  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+  // skip any empty buffer at the start so we never pass a zero-length first entry
+  iovec *vec = length == 0 ? &iov[1] : &iov[0];
+  int numVec = length2 == 0 || length == 0 ? 1 : 2;
 
-  while(sent < length)
+  while(numVec > 0)
   {
-    int ret = send(socket, src, length - sent, 0);
+    ssize_t ret = writev((int)socket, vec, numVec);
 
     if(ret <= 0)
     {
@@ -174,12 +195,13 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
 
       if(err == EINTR)
       {
-        // if we hit EINTR, just try again completely. Technically this restarts the timeout but we
-        // expect EINTR to be rare so it's not a big deal.
         continue;
       }
       else if(err == EWOULDBLOCK || err == EAGAIN)
       {
+        if(WaitForSocket((int)socket, POLLOUT, timeoutMS))
+          continue;
+
         RDCWARN("Timeout of %f seconds exceeded in send", float(timeoutMS) / 1000.0f);
         Shutdown();
         return false;
@@ -192,16 +214,21 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
       }
     }
 
-    sent += ret;
-    src += ret;
-  }
-
-  flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags | O_NONBLOCK);
-
-  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&oldtimeout, sizeof(oldtimeout));
+    // advance past whatever was sent, which may end part-way through a buffer
+    size_t sent = (size_t)ret;
+    while(numVec > 0 && sent >= vec->iov_len)
+    {
+      sent -= vec->iov_len;
+      vec++;
+      numVec--;
+    }
 
-  RDCASSERT(sent == length);
+    if(numVec > 0)
+    {
+      vec->iov_base = (byte *)vec->iov_base + sent;
+      vec->iov_len -= sent;
+    }
+  }
 
   // incredibly ugly hack necessary for android
   SocketPostSend();
@@ -271,6 +298,11 @@ bool Socket::RecvDataNonBlocking(void *buf, uint32_t &length)
 }
 
 bool Socket::RecvDataBlocking(void *buf, uint32_t length)
+{
+  return RecvDataBlocking(buf, length, length);
+}
+
+bool Socket::RecvDataBlocking(void *buf, uint32_t minLength, uint32_t &length)
 {
   if(length == 0)
     return true;
@@ -279,39 +311,37 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
 
   char *dst = (char *)buf;
 
-  int flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
-
-  timeval oldtimeout = {0};
-  socklen_t len = sizeof(oldtimeout);
-  getsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (char *)&oldtimeout, &len);
-
-  timeval timeout = {0};
-  timeout.tv_sec = (timeoutMS / 1000);
-  timeout.tv_usec = (timeoutMS % 1000) * 1000;
-  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
-
   while(received < length)
   {
-    int ret = recv(socket, dst, length - received, 0);
+    ssize_t ret = recv((int)socket, dst, length - received, 0);
 
     if(ret == 0)
     {
+      // the connection was closed. If we have what we need, return it and leave the closed socket
+      // to be found on the next receive
+      if(received >= minLength)
+        break;
+
       Shutdown();
       return false;
     }
-    else if(ret <= 0)
+    else if(ret < 0)
     {
       int err = errno;
 
       if(err == EINTR)
       {
-        // if we hit EINTR, just try again completely. Technically this restarts the timeout but we
-        // expect EINTR to be rare so it's not a big deal.
         continue;
       }
       else if(err == EWOULDBLOCK || err == EAGAIN)
       {
+        // once we have what we need, don't wait for any more
+        if(received >= minLength)
+          break;
+
+        if(WaitForSocket((int)socket, POLLIN, timeoutMS))
+          continue;
+
         RDCWARN("Timeout of %f seconds exceeded in recv", float(timeoutMS) / 1000.0f);
         Shutdown();
         return false;
@@ -324,16 +354,13 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
       }
     }
 
-    received += ret;
+    received += (uint32_t)ret;
     dst += ret;
   }
 
-  flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags | O_NONBLOCK);
-
-  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&oldtimeout, sizeof(oldtimeout));
+  RDCASSERT(received >= minLength && received <= length, received, minLength, length);
 
-  RDCASSERT(received == length);
+  length = received;
 
   return true;
 }
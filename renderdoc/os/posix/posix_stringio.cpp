@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
@@ -574,6 +575,57 @@ void logfile_close(LogFileHandle *logHandle, const char *deleteFilename)
     close(fd);
   }
 }
+
+struct FileMapping
+{
+  void *base;
+  size_t size;
+  byte *data;
+};
+
+FileMapping *mapfile_open(FILE *f, uint64_t offset, uint64_t length)
+{
+  if(f == NULL || length == 0)
+    return NULL;
+
+  // mappings must start on a page boundary, so map from the start of the page containing offset
+  uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t pageOffset = offset - (offset % pageSize);
+  uint64_t mapSize = length + (offset - pageOffset);
+
+  // can't map more than the address space allows
+  if(mapSize != (uint64_t)(size_t)mapSize)
+    return NULL;
+
+  void *base = mmap(NULL, (size_t)mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f),
+                    (off_t)pageOffset);
+
+  if(base == MAP_FAILED)
+  {
+    RDCWARN("Couldn't map %llu bytes of file at %llu: %d", length, offset, (int)errno);
+    return NULL;
+  }
+
+  FileMapping *ret = new FileMapping;
+  ret->base = base;
+  ret->size = (size_t)mapSize;
+  ret->data = (byte *)base + (offset - pageOffset);
+  return ret;
+}
+
+byte *mapfile_data(FileMapping *mapping)
+{
+  return mapping ? mapping->data : NULL;
+}
+
+void mapfile_close(FileMapping *mapping)
+{
+  if(mapping)
+  {
+    munmap(mapping->base, mapping->size);
+    delete mapping;
+  }
+}
 };
 
 namespace StringFormat
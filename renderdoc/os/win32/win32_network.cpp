@@ -238,6 +238,11 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
   return true;
 }
 
+bool Socket::SendDataBlocking(const void *buf, uint32_t length, const void *buf2, uint32_t length2)
+{
+  return SendDataBlocking(buf, length) && SendDataBlocking(buf2, length2);
+}
+
 bool Socket::IsRecvDataWaiting()
 {
   char dummy;
@@ -359,6 +364,21 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
   return true;
 }
 
+bool Socket::RecvDataBlocking(void *buf, uint32_t minLength, uint32_t &length)
+{
+  if(!RecvDataBlocking(buf, minLength))
+    return false;
+
+  // read whatever else is already available, up to length
+  uint32_t extra = length - minLength;
+  if(!RecvDataNonBlocking((byte *)buf + minLength, extra))
+    return false;
+
+  length = minLength + extra;
+
+  return true;
+}
+
 Socket *CreateServerSocket(const char *bindaddr, uint16_t port, int queuesize)
 {
   SOCKET s = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0,
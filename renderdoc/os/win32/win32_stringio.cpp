@@ -768,6 +768,73 @@ void logfile_close(LogFileHandle *logHandle, const char *deleteFilename)
     ::DeleteFileW(wpath.c_str());
   }
 }
+
+struct FileMapping
+{
+  HANDLE mapping;
+  void *base;
+  byte *data;
+};
+
+FileMapping *mapfile_open(FILE *f, uint64_t offset, uint64_t length)
+{
+  if(f == NULL || length == 0)
+    return NULL;
+
+  // views must start on an allocation granularity boundary
+  SYSTEM_INFO info = {};
+  GetSystemInfo(&info);
+
+  uint64_t viewOffset = offset - (offset % info.dwAllocationGranularity);
+  uint64_t viewSize = length + (offset - viewOffset);
+
+  if(viewSize != (uint64_t)(SIZE_T)viewSize)
+    return NULL;
+
+  HANDLE file = (HANDLE)_get_osfhandle(_fileno(f));
+
+  if(file == INVALID_HANDLE_VALUE)
+    return NULL;
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+
+  if(mapping == NULL)
+  {
+    RDCWARN("Couldn't create file mapping: %u", GetLastError());
+    return NULL;
+  }
+
+  void *base = MapViewOfFile(mapping, FILE_MAP_COPY, DWORD(viewOffset >> 32),
+                             DWORD(viewOffset & 0xFFFFFFFFU), (SIZE_T)viewSize);
+
+  if(base == NULL)
+  {
+    RDCWARN("Couldn't map %llu bytes of file at %llu: %u", length, offset, GetLastError());
+    CloseHandle(mapping);
+    return NULL;
+  }
+
+  FileMapping *ret = new FileMapping;
+  ret->mapping = mapping;
+  ret->base = base;
+  ret->data = (byte *)base + (offset - viewOffset);
+  return ret;
+}
+
+byte *mapfile_data(FileMapping *mapping)
+{
+  return mapping ? mapping->data : NULL;
+}
+
+void mapfile_close(FileMapping *mapping)
+{
+  if(mapping)
+  {
+    UnmapViewOfFile(mapping->base);
+    CloseHandle(mapping->mapping);
+    delete mapping;
+  }
+}
 };
 
 namespace StringFormat
@@ -151,6 +151,38 @@ void RWLock::ReadUnlock()
   ReleaseSRWLockShared(&m_Data);
 }
 
+struct Win32Semaphore : public Semaphore
+{
+  ~Win32Semaphore() {}
+  HANDLE h;
+};
+
+Semaphore *Semaphore::Create()
+{
+  Win32Semaphore *sem = new Win32Semaphore();
+  sem->h = CreateSemaphore(NULL, 0, 0x10000, NULL);
+  return sem;
+}
+
+void Semaphore::Destroy()
+{
+  Win32Semaphore *sem = (Win32Semaphore *)this;
+  CloseHandle(sem->h);
+  delete sem;
+}
+
+void Semaphore::Wake(uint32_t numToWake)
+{
+  Win32Semaphore *sem = (Win32Semaphore *)this;
+  ReleaseSemaphore(sem->h, (LONG)numToWake, NULL);
+}
+
+void Semaphore::WaitForWake()
+{
+  Win32Semaphore *sem = (Win32Semaphore *)this;
+  WaitForSingleObject(sem->h, INFINITE);
+}
+
 struct ThreadInitData
 {
   std::function<void()> entryFunc;
@@ -355,4 +387,11 @@ void Sleep(uint32_t milliseconds)
 {
   ::Sleep((DWORD)milliseconds);
 }
+
+uint32_t NumberOfCores()
+{
+  SYSTEM_INFO info = {};
+  GetSystemInfo(&info);
+  return RDCMAX(1U, (uint32_t)info.dwNumberOfProcessors);
+}
 };
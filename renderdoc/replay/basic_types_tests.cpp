@@ -28,6 +28,7 @@
 
 #include "api/replay/rdcarray.h"
 #include "api/replay/rdcflatmap.h"
+#include "api/replay/rdchashmap.h"
 #include "api/replay/rdcpair.h"
 #include "api/replay/rdcstr.h"
 #include "common/formatting.h"
@@ -35,6 +36,9 @@
 #include "common/timing.h"
 #include "os/os_specific.h"
 
+#include <map>
+#include <set>
+
 #include "catch/catch.hpp"
 
 static int32_t constructor = 0;
@@ -1890,4 +1894,217 @@ TEST_CASE("Test flatmap type", "[basictypes][flatmap]")
   };
 };
 
+TEST_CASE("Test hashmap type", "[basictypes][hashmap]")
+{
+  SECTION("insert, lookup and erase")
+  {
+    rdchashmap<uint32_t, rdcstr> test;
+
+    CHECK(test.empty());
+    CHECK(bool(test.find(5) == test.end()));
+
+    test[5] = "foo";
+    test[7] = "bar";
+    test[3] = "asdf";
+
+    CHECK(test.size() == 3);
+    CHECK(test.find(5)->second == "foo");
+    CHECK(test.find(7)->second == "bar");
+    CHECK(test.find(3)->second == "asdf");
+    CHECK(bool(test.find(4) == test.end()));
+
+    auto ins = test.insert({5, "overwrite"});
+    CHECK_FALSE(ins.second);
+    CHECK(ins.first->second == "foo");
+
+    ins = test.insert({9, "new"});
+    CHECK(ins.second);
+    CHECK(ins.first->second == "new");
+
+    CHECK(test.erase(7) == 1);
+    CHECK(test.erase(7) == 0);
+    CHECK(test.size() == 3);
+    CHECK(bool(test.find(7) == test.end()));
+    CHECK(test.find(5)->second == "foo");
+
+    test.erase(test.find(3));
+    CHECK(bool(test.find(3) == test.end()));
+    CHECK(test.size() == 2);
+
+    test.clear();
+    CHECK(test.empty());
+    CHECK(bool(test.begin() == test.end()));
+    CHECK(bool(test.find(5) == test.end()));
+  };
+
+  SECTION("growth and tombstone reuse")
+  {
+    rdchashmap<uint64_t, uint64_t> test;
+
+    // pointer-like keys, which std::hash leaves with the low bits all zero
+    for(uint64_t i = 0; i < 10000; i++)
+      test[i * 64] = i;
+
+    CHECK(test.size() == 10000);
+
+    for(uint64_t i = 0; i < 10000; i += 2)
+      test.erase(i * 64);
+
+    CHECK(test.size() == 5000);
+
+    // churn through many inserts and erases, which must not grow the table without bound
+    size_t cap = test.capacity();
+    for(uint64_t i = 100000; i < 200000; i++)
+    {
+      test[i * 64] = i;
+      test.erase(i * 64);
+    }
+    CHECK(test.capacity() == cap);
+
+    bool allFound = true;
+    for(uint64_t i = 1; i < 10000; i += 2)
+    {
+      auto it = test.find(i * 64);
+      allFound &= (it != test.end() && it->second == i);
+    }
+    CHECK(allFound);
+
+    // each remaining entry is visited exactly once
+    uint64_t sum = 0, count = 0;
+    for(auto it = test.begin(); it != test.end(); ++it)
+    {
+      sum += it->second;
+      count++;
+    }
+    CHECK(count == 5000);
+    CHECK(sum == 5000ULL * 5000ULL);
+  };
+
+  SECTION("erase while iterating")
+  {
+    rdchashmap<uint32_t, uint32_t> test;
+
+    for(uint32_t i = 0; i < 100; i++)
+      test[i] = i;
+
+    for(auto it = test.begin(); it != test.end();)
+    {
+      if(it->first % 3 == 0)
+        it = test.erase(it);
+      else
+        ++it;
+    }
+
+    CHECK(test.size() == 66);
+    for(auto it = test.begin(); it != test.end(); ++it)
+      CHECK(it->first % 3 != 0);
+  };
+
+  SECTION("existing keys don't move")
+  {
+    rdchashmap<uint32_t, uint32_t> test;
+
+    for(uint32_t i = 0; i < 12; i++)
+      test[i] = i;
+
+    // the table is at its load limit, but assigning to existing keys must not rehash
+    uint32_t *ptr = &test[5];
+    for(uint32_t i = 0; i < 12; i++)
+      test[i] = i + 1;
+    CHECK(ptr == &test[5]);
+  };
+
+  SECTION("copy and swap")
+  {
+    rdchashmap<uint32_t, rdcstr> test;
+    test[1] = "one";
+    test[2] = "two";
+
+    rdchashmap<uint32_t, rdcstr> copy = test;
+    test[1] = "changed";
+
+    CHECK(copy.size() == 2);
+    CHECK(copy.find(1)->second == "one");
+
+    rdchashmap<uint32_t, rdcstr> swapped;
+    swapped.swap(copy);
+    CHECK(copy.empty());
+    CHECK(swapped.find(2)->second == "two");
+  };
+
+  SECTION("hashset")
+  {
+    rdchashset<uint32_t> test;
+
+    CHECK(test.insert(5).second);
+    CHECK(test.insert(7).second);
+    CHECK_FALSE(test.insert(5).second);
+
+    CHECK(test.size() == 2);
+    CHECK(bool(test.find(5) != test.end()));
+    CHECK(*test.find(7) == 7);
+    CHECK(test.count(6) == 0);
+
+    test.erase(5);
+    CHECK(bool(test.find(5) == test.end()));
+    CHECK(test.size() == 1);
+  };
+};
+
+TEST_CASE("Benchmark hashmap against std::map", "[basictypes][hashmap][!benchmark]")
+{
+  const uint64_t count = 1000000;
+
+  // resource IDs are allocated mostly sequentially, but shuffle the insertion order a little as
+  // different threads create resources concurrently.
+  rdcarray<uint64_t> keys;
+  keys.resize(count);
+  for(uint64_t i = 0; i < count; i++)
+    keys[i] = 1000 + i;
+  for(uint64_t i = 0; i + 8 < count; i += 8)
+    std::swap(keys[i], keys[i + 7]);
+
+  std::map<uint64_t, uint32_t> stdmap;
+  rdchashmap<uint64_t, uint32_t> hashmap;
+  uint64_t found = 0;
+
+  BENCHMARK("std::map insert")
+  {
+    for(uint64_t k : keys)
+      stdmap[k] = 1;
+  }
+
+  BENCHMARK("rdchashmap insert")
+  {
+    for(uint64_t k : keys)
+      hashmap[k] = 1;
+  }
+
+  BENCHMARK("std::map lookup")
+  {
+    for(uint64_t k : keys)
+      found += stdmap.find(k) != stdmap.end() ? 1 : 0;
+  }
+
+  BENCHMARK("rdchashmap lookup")
+  {
+    for(uint64_t k : keys)
+      found += hashmap.find(k) != hashmap.end() ? 1 : 0;
+  }
+
+  BENCHMARK("std::map iterate")
+  {
+    for(auto it = stdmap.begin(); it != stdmap.end(); ++it)
+      found += it->second;
+  }
+
+  BENCHMARK("rdchashmap iterate")
+  {
+    for(auto it = hashmap.begin(); it != hashmap.end(); ++it)
+      found += it->second;
+  }
+
+  CHECK(found == count * 4);
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "core/core.h"
+#include "core/settings.h"
 #include "jpeg-compressor/jpgd.h"
 #include "jpeg-compressor/jpge.h"
 #include "replay/replay_controller.h"
@@ -32,6 +33,12 @@
 #include "stb/stb_image_resize.h"
 #include "stb/stb_image_write.h"
 
+RDOC_CONFIG(bool, Capture_LazyStructuredData, true,
+            "Only decode the children of each chunk in a capture's structured data when they're "
+            "first accessed, for APIs that can decode chunks independently. This greatly reduces "
+            "the time and memory taken to fetch the structured data of large captures when only "
+            "some chunks are inspected.");
+
 static void writeToBytebuf(void *context, void *data, int size)
 {
   bytebuf *buf = (bytebuf *)context;
@@ -336,13 +343,42 @@ void CaptureFile::InitStructuredData(RENDERDOC_ProgressCallback progress /*= REN
   if(m_StructuredData.chunks.empty() && m_RDC && m_RDC->SectionIndex(SectionType::FrameCapture) >= 0)
   {
     StructuredProcessor proc = RenderDoc::Inst().GetStructuredProcessor(m_RDC->GetDriver());
+    StructuredChunkDecoderProvider decoderProvider =
+        RenderDoc::Inst().GetStructuredChunkDecoder(m_RDC->GetDriver());
 
     RenderDoc::Inst().SetProgressCallback<LoadProgress>(progress);
 
-    if(proc)
-      proc(m_RDC, m_StructuredData);
-    else
-      RDCERR("Can't get structured data for driver %s", m_RDC->GetDriverName().c_str());
+    IStructuredChunkDecoder *decoder = NULL;
+    if(decoderProvider && Capture_LazyStructuredData())
+      decoder = decoderProvider(m_RDC);
+
+    bool lazy = false;
+
+    if(decoder)
+    {
+      int sectionIdx = m_RDC->SectionIndex(SectionType::FrameCapture);
+
+      // chunks are decoded in any order so the section must be seekable. It's shared if it's
+      // mapped, otherwise it's read into memory once.
+      StreamReader *section = m_RDC->ReadSection(sectionIdx);
+      StreamReader *reader = new StreamReader(section, section->GetSize());
+      delete section;
+
+      lazy = ReadLazyStructuredFile(reader, decoder, m_RDC->GetSectionProperties(sectionIdx).version,
+                                    m_RDC->GetCallstackTable(), m_StructuredData);
+
+      if(!lazy)
+        RDCWARN("Couldn't read structured data lazily, decoding all of it");
+    }
+
+    // otherwise the driver decodes every chunk up front
+    if(!lazy)
+    {
+      if(proc)
+        proc(m_RDC, m_StructuredData);
+      else
+        RDCERR("Can't get structured data for driver %s", m_RDC->GetDriverName().c_str());
+    }
 
     RenderDoc::Inst().SetProgressCallback<LoadProgress>(RENDERDOC_ProgressCallback());
   }
@@ -426,12 +462,25 @@ ReplayStatus CaptureFile::Convert(const char *filename, const char *filetype, co
   {
     if(file)
     {
+      PopulateStructuredChunks(*file, fetchProgress);
+
       return exporter(filename, *m_RDC, *file, exportProgress);
     }
     else
     {
+      // if the structured data hasn't been fetched already, formats that support it are converted
+      // straight from the capture so the whole structured file is never held in memory.
+      CaptureStreamExporter streamExporter = RenderDoc::Inst().GetCaptureStreamExporter(filetype);
+
+      if(streamExporter && m_StructuredData.chunks.empty() &&
+         m_RDC->SectionIndex(SectionType::FrameCapture) >= 0)
+        return streamExporter(filename, m_RDC, progress);
+
       InitStructuredData(fetchProgress);
 
+      // exporters expect every chunk to be complete
+      PopulateStructuredChunks(m_StructuredData, fetchProgress);
+
       return exporter(filename, *m_RDC, GetStructuredData(), exportProgress);
     }
   }
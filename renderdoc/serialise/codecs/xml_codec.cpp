@@ -27,6 +27,7 @@
 #include "common/common.h"
 #include "common/formatting.h"
 #include "serialise/rdcfile.h"
+#include "serialise/serialiser.h"
 #include "strings/string_utils.h"
 
 #include "miniz/miniz.h"
@@ -274,14 +275,9 @@ static void Obj2XML(pugi::xml_node &parent, SDObject &child)
   }
 }
 
-static ReplayStatus Structured2XML(const char *filename, const RDCFile &file, uint64_t version,
-                                   const StructuredChunkList &chunks,
-                                   RENDERDOC_ProgressCallback progress)
+static void Header2XML(pugi::xml_node &xRoot, const RDCFile &file,
+                       RENDERDOC_ProgressCallback progress)
 {
-  pugi::xml_document doc;
-
-  pugi::xml_node xRoot = doc.append_child("rdc");
-
   {
     pugi::xml_node xHeader = xRoot.append_child("header");
 
@@ -411,58 +407,110 @@ static ReplayStatus Structured2XML(const char *filename, const RDCFile &file, ui
 
   if(progress)
     progress(StructuredProgress(0.2f));
+}
+
+static void Chunk2XML(pugi::xml_node &xChunk, SDChunk *chunk)
+{
+  xChunk.append_attribute("id") = chunk->metadata.chunkID;
+  xChunk.append_attribute("name") = chunk->name.c_str();
+  xChunk.append_attribute("length") = chunk->metadata.length;
+  if(chunk->metadata.threadID)
+    xChunk.append_attribute("threadID") = chunk->metadata.threadID;
+  if(chunk->metadata.timestampMicro)
+    xChunk.append_attribute("timestamp") = chunk->metadata.timestampMicro;
+  if(chunk->metadata.durationMicro >= 0)
+    xChunk.append_attribute("duration") = chunk->metadata.durationMicro;
+  if(chunk->metadata.flags & SDChunkFlags::HasCallstack)
+  {
+    pugi::xml_node stack = xChunk.append_child("callstack");
 
-  pugi::xml_node xChunks = xRoot.append_child("chunks");
+    for(size_t i = 0; i < chunk->metadata.callstack.size(); i++)
+    {
+      stack.append_child("address").text() = chunk->metadata.callstack[i];
+    }
+  }
 
-  xChunks.append_attribute("version") = version;
+  chunk->PopulateChildren();
 
-  for(size_t c = 0; c < chunks.size(); c++)
+  if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
   {
-    pugi::xml_node xChunk = xChunks.append_child("chunk");
-    SDChunk *chunk = chunks[c];
-
-    xChunk.append_attribute("id") = chunk->metadata.chunkID;
-    xChunk.append_attribute("name") = chunk->name.c_str();
-    xChunk.append_attribute("length") = chunk->metadata.length;
-    if(chunk->metadata.threadID)
-      xChunk.append_attribute("threadID") = chunk->metadata.threadID;
-    if(chunk->metadata.timestampMicro)
-      xChunk.append_attribute("timestamp") = chunk->metadata.timestampMicro;
-    if(chunk->metadata.durationMicro >= 0)
-      xChunk.append_attribute("duration") = chunk->metadata.durationMicro;
-    if(chunk->metadata.flags & SDChunkFlags::HasCallstack)
-    {
-      pugi::xml_node stack = xChunk.append_child("callstack");
+    xChunk.append_attribute("opaque") = true;
 
-      for(size_t i = 0; i < chunk->metadata.callstack.size(); i++)
-      {
-        stack.append_child("address").text() = chunk->metadata.callstack[i];
-      }
-    }
+    RDCASSERT(!chunk->data.children.empty());
+    pugi::xml_node opaque = xChunk.append_child("buffer");
+    opaque.append_attribute("byteLength") = chunk->data.children[0]->type.byteSize;
+    opaque.text() = chunk->data.children[0]->data.basic.u;
+  }
+  else
+  {
+    for(size_t o = 0; o < chunk->data.children.size(); o++)
+      Obj2XML(xChunk, *chunk->data.children[o]);
+  }
+}
 
-    if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
-    {
-      xChunk.append_attribute("opaque") = true;
+// writes the xml document incrementally, producing the same output as saving the whole document at
+// once. This allows each chunk to be converted and discarded as soon as it's available.
+struct xml_chunk_writer
+{
+  xml_file_writer writer;
 
-      RDCASSERT(!chunk->data.children.empty());
-      pugi::xml_node opaque = xChunk.append_child("buffer");
-      opaque.append_attribute("byteLength") = chunk->data.children[0]->type.byteSize;
-      opaque.text() = chunk->data.children[0]->data.basic.u;
-    }
-    else
-    {
-      for(size_t o = 0; o < chunk->data.children.size(); o++)
-        Obj2XML(xChunk, *chunk->data.children[o]);
-    }
+  xml_chunk_writer(const char *filename, const RDCFile &file, uint64_t version,
+                   RENDERDOC_ProgressCallback progress)
+      : writer(filename)
+  {
+    pugi::xml_document doc;
+
+    pugi::xml_node xRoot = doc.append_child("rdc");
+
+    Header2XML(xRoot, file, progress);
+
+    Write("<?xml version=\"1.0\"?>\n<rdc>\n");
+
+    for(pugi::xml_node xNode = xRoot.first_child(); xNode; xNode = xNode.next_sibling())
+      xNode.print(writer, "\t", pugi::format_default, pugi::encoding_auto, 1);
+
+    Write(StringFormat::Fmt("\t<chunks version=\"%llu\">\n", version));
+  }
+
+  void WriteChunk(SDChunk *chunk)
+  {
+    pugi::xml_document doc;
+
+    pugi::xml_node xChunk = doc.append_child("chunk");
+
+    Chunk2XML(xChunk, chunk);
+
+    xChunk.print(writer, "\t", pugi::format_default, pugi::encoding_auto, 2);
+  }
+
+  ReplayStatus Finish()
+  {
+    Write("\t</chunks>\n</rdc>\n");
+
+    writer.stream.Finish();
+
+    return writer.stream.IsErrored() ? ReplayStatus::FileIOFailed : ReplayStatus::Succeeded;
+  }
+
+private:
+  void Write(const rdcstr &str) { writer.write(str.c_str(), str.size()); }
+};
+
+static ReplayStatus Structured2XML(const char *filename, const RDCFile &file, uint64_t version,
+                                   const StructuredChunkList &chunks,
+                                   RENDERDOC_ProgressCallback progress)
+{
+  xml_chunk_writer xml(filename, file, version, progress);
+
+  for(size_t c = 0; c < chunks.size(); c++)
+  {
+    xml.WriteChunk(chunks[c]);
 
     if(progress)
       progress(StructuredProgress(0.2f + 0.8f * (float(c) / float(chunks.size()))));
   }
 
-  xml_file_writer writer(filename);
-  doc.save(writer);
-
-  return writer.stream.IsErrored() ? ReplayStatus::FileIOFailed : ReplayStatus::Succeeded;
+  return xml.Finish();
 }
 
 static SDObject *XML2Obj(pugi::xml_node &obj)
@@ -835,13 +883,10 @@ static ReplayStatus XML2Structured(const char *xml, const ThumbTypeAndData &thum
   return ReplayStatus::Succeeded;
 }
 
-static ReplayStatus Buffers2ZIP(const rdcstr &filename, const RDCFile &file,
-                                const StructuredBufferList &buffers,
-                                RENDERDOC_ProgressCallback progress)
+static bool OpenZIP(mz_zip_archive &zip, const rdcstr &filename)
 {
   rdcstr zipFile = strip_extension(filename);
 
-  mz_zip_archive zip;
   memset(&zip, 0, sizeof(zip));
 
   mz_bool b = mz_zip_writer_init_file(&zip, zipFile.c_str(), 0);
@@ -849,17 +894,20 @@ static ReplayStatus Buffers2ZIP(const rdcstr &filename, const RDCFile &file,
   if(!b)
   {
     RDCERR("Failed to open .zip file '%s'", zipFile.c_str());
-    return ReplayStatus::FileIOFailed;
+    return false;
   }
 
-  for(size_t i = 0; i < buffers.size(); i++)
-  {
-    mz_zip_writer_add_mem(&zip, GetBufferName(i).c_str(), buffers[i]->data(), buffers[i]->size(), 2);
+  return true;
+}
 
-    if(progress)
-      progress(BufferProgress(float(i) / float(buffers.size())));
-  }
+static void Buffer2ZIP(mz_zip_archive &zip, size_t idx, const bytebuf &buffer)
+{
+  mz_zip_writer_add_mem(&zip, GetBufferName(idx).c_str(), buffer.data(), buffer.size(), 2);
+}
 
+// writes the thumbnails and diagnostic log after the buffers, then closes the zip
+static void FinishZIP(mz_zip_archive &zip, const RDCFile &file)
+{
   const RDCThumb &th = file.GetThumbnail();
   if(!th.pixels.empty() && th.width > 0 && th.height > 0)
   {
@@ -928,6 +976,26 @@ static ReplayStatus Buffers2ZIP(const rdcstr &filename, const RDCFile &file,
 
   mz_zip_writer_finalize_archive(&zip);
   mz_zip_writer_end(&zip);
+}
+
+static ReplayStatus Buffers2ZIP(const rdcstr &filename, const RDCFile &file,
+                                const StructuredBufferList &buffers,
+                                RENDERDOC_ProgressCallback progress)
+{
+  mz_zip_archive zip;
+
+  if(!OpenZIP(zip, filename))
+    return ReplayStatus::FileIOFailed;
+
+  for(size_t i = 0; i < buffers.size(); i++)
+  {
+    Buffer2ZIP(zip, i, *buffers[i]);
+
+    if(progress)
+      progress(BufferProgress(float(i) / float(buffers.size())));
+  }
+
+  FinishZIP(zip, file);
 
   return ReplayStatus::Succeeded;
 }
@@ -1052,8 +1120,148 @@ ReplayStatus exportXMLOnly(const char *filename, const RDCFile &rdc, const SDFil
   return Structured2XML(filename, rdc, structData.version, structData.chunks, progress);
 }
 
+static ReplayStatus StreamStructured2XML(const char *filename, RDCFile *rdc, bool includeBuffers,
+                                         RENDERDOC_ProgressCallback progress)
+{
+  int sectionIdx = rdc->SectionIndex(SectionType::FrameCapture);
+
+  if(sectionIdx < 0)
+  {
+    RDCERR("Can't get structured data without a frame capture");
+    return ReplayStatus::InternalError;
+  }
+
+  StructuredChunkDecoderProvider decoderProvider =
+      RenderDoc::Inst().GetStructuredChunkDecoder(rdc->GetDriver());
+
+  IStructuredChunkDecoder *decoder = decoderProvider ? decoderProvider(rdc) : NULL;
+
+  // without a decoder the driver's structured processor has to decode the whole capture. It moves
+  // chunks between structured files while reading and can look back at earlier chunks, so nothing
+  // can be released until it's done.
+  if(!decoder)
+  {
+    StructuredProcessor proc = RenderDoc::Inst().GetStructuredProcessor(rdc->GetDriver());
+
+    if(!proc)
+    {
+      RDCERR("Can't get structured data for driver %s", rdc->GetDriverName().c_str());
+      return ReplayStatus::InternalError;
+    }
+
+    SDFile structData;
+
+    RenderDoc::Inst().SetProgressCallback<LoadProgress>(
+        [progress](float p) { progress(p * 0.5f); });
+
+    proc(rdc, structData);
+
+    RenderDoc::Inst().SetProgressCallback<LoadProgress>(RENDERDOC_ProgressCallback());
+
+    RENDERDOC_ProgressCallback exportProgress = [progress](float p) { progress(0.5f + p * 0.5f); };
+
+    if(includeBuffers)
+      return exportXMLZ(filename, *rdc, structData, exportProgress);
+    return exportXMLOnly(filename, *rdc, structData, exportProgress);
+  }
+
+  mz_zip_archive zip;
+
+  if(includeBuffers && !OpenZIP(zip, filename))
+  {
+    delete decoder;
+    return ReplayStatus::FileIOFailed;
+  }
+
+  uint64_t version = rdc->GetSectionProperties(sectionIdx).version;
+
+  xml_chunk_writer xml(filename, *rdc, version, NULL);
+
+  ReadSerialiser ser(rdc->ReadSection(sectionIdx), Ownership::Stream);
+
+  ser.SetVersion(version);
+  ser.SetCallstackTable(rdc->GetCallstackTable());
+  ser.ConfigureStructuredExport(decoder->GetChunkLookup(), true, 0, 1.0);
+
+  StreamReader *reader = ser.GetReader();
+  SDFile &structData = ser.GetStructuredFile();
+
+  // how many chunks and buffers have been written out. Each one is deleted and replaced with NULL
+  // once it's written, so that indices stay valid.
+  size_t flushedChunks = 0, flushedBuffers = 0;
+
+  // called once the decoder has finished with each chunk, to write out and free the chunk along
+  // with any buffers it added.
+  auto flush = [&](SDFile &file) {
+    for(; flushedBuffers < file.buffers.size(); flushedBuffers++)
+    {
+      if(includeBuffers)
+        Buffer2ZIP(zip, flushedBuffers, *file.buffers[flushedBuffers]);
+
+      SAFE_DELETE(file.buffers[flushedBuffers]);
+    }
+
+    for(; flushedChunks < file.chunks.size(); flushedChunks++)
+    {
+      xml.WriteChunk(file.chunks[flushedChunks]);
+
+      SAFE_DELETE(file.chunks[flushedChunks]);
+    }
+  };
+
+  ReplayStatus status = ReplayStatus::Succeeded;
+
+  {
+    // only our own structured file is streamed, the decoder may read others while decoding
+    ScopedStructuredChunkCallback callback(structData, flush);
+
+    while(!reader->AtEnd())
+    {
+      uint32_t chunkID = ser.ReadChunk<uint32_t>();
+
+      bool success = decoder->DecodeChunk(ser, chunkID);
+
+      ser.EndChunk();
+
+      if(!success || reader->IsErrored())
+      {
+        RDCERR("Failed to decode chunk %zu", flushedChunks);
+        status = ReplayStatus::FileCorrupted;
+        break;
+      }
+
+      if(progress)
+        progress(float(reader->GetOffset()) / float(reader->GetSize()));
+
+      if((SystemChunk)chunkID == SystemChunk::CaptureEnd)
+        break;
+    }
+  }
+
+  delete decoder;
+
+  if(includeBuffers)
+    FinishZIP(zip, *rdc);
+
+  ReplayStatus xmlStatus = xml.Finish();
+
+  return status != ReplayStatus::Succeeded ? status : xmlStatus;
+}
+
+ReplayStatus streamExportXMLZ(const char *filename, RDCFile *rdc,
+                              RENDERDOC_ProgressCallback progress)
+{
+  return StreamStructured2XML(filename, rdc, true, progress);
+}
+
+ReplayStatus streamExportXMLOnly(const char *filename, RDCFile *rdc,
+                                 RENDERDOC_ProgressCallback progress)
+{
+  return StreamStructured2XML(filename, rdc, false, progress);
+}
+
 static ConversionRegistration XMLZIPConversionRegistration(
-    &importXMLZ, &exportXMLZ,
+    &importXMLZ, &exportXMLZ, &streamExportXMLZ,
     {
         "zip.xml", "XML+ZIP capture",
         R"(Stores the structured data in an xml tree, with large buffer data stored in indexed blobs in
@@ -1062,7 +1270,7 @@ similarly named zip file.)",
     });
 
 static ConversionRegistration XMLOnlyConversionRegistration(
-    &exportXMLOnly,
+    &exportXMLOnly, &streamExportXMLOnly,
     {
         "xml", "XML capture",
         R"(Stores the structured data in an xml tree, with large buffer data omitted - that makes it
@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "lz4io.h"
+#include "rdcfile.h"
 #include "serialiser.h"
 #include "zstdio.h"
 
@@ -190,4 +191,216 @@ TEST_CASE("Test ZSTD compression/decompression", "[streamio][zstd]")
   delete[] randomData;
 };
 
+TEST_CASE("Test ZSTD parallel compression/decompression", "[streamio][zstd]")
+{
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+  // use an awkward size so that the last frame and last batch are both partial
+  const uint64_t dataSize = 9 * 1024 * 1024 + 12345;
+
+  byte *data = new byte[(size_t)dataSize];
+
+  for(uint64_t i = 0; i < dataSize; i++)
+    data[i] = (i % 3 == 0) ? (rand() & 0xff) : (i & 0xff);
+
+  {
+    StreamWriter writer(new ZSTDParallelCompressor(&buf, Ownership::Nothing), Ownership::Stream);
+
+    // write in unevenly sized pieces
+    uint64_t offs = 0;
+    uint64_t piece = 1;
+    while(offs < dataSize)
+    {
+      uint64_t len = RDCMIN(piece, dataSize - offs);
+      writer.Write(data + offs, len);
+      offs += len;
+      piece = (piece * 7 + 13) % (300 * 1024);
+    }
+
+    CHECK(writer.GetOffset() == dataSize);
+
+    writer.Finish();
+
+    CHECK_FALSE(writer.IsErrored());
+  }
+
+  const uint64_t numBlocks = AlignUp(dataSize, ZSTDBlockSize) / ZSTDBlockSize;
+
+  // check the block index
+  ZSTDBlockIndexFooter footer;
+  memcpy(&footer, buf.GetData() + buf.GetOffset() - sizeof(footer), sizeof(footer));
+
+  CHECK(footer.magic == ZSTDBlockIndexMagic);
+  CHECK(footer.blockSize == ZSTDBlockSize);
+  CHECK(footer.numBlocks == numBlocks);
+
+  const uint64_t indexSize = numBlocks * sizeof(uint64_t) + sizeof(footer);
+  const uint64_t *frameOffsets =
+      (const uint64_t *)(buf.GetData() + buf.GetOffset() - indexSize);
+
+  // each frame offset should point to a length prefix, with the next frame immediately after
+  for(uint64_t i = 0; i + 1 < numBlocks; i++)
+  {
+    uint32_t frameSize = 0;
+    memcpy(&frameSize, buf.GetData() + frameOffsets[i], sizeof(frameSize));
+    CHECK(frameOffsets[i + 1] == frameOffsets[i] + sizeof(uint32_t) + frameSize);
+  }
+
+  // the frames should be readable by the normal decompressor
+  {
+    StreamReader reader(new ZSTDDecompressor(
+                            new StreamReader(buf.GetData(), buf.GetOffset() - indexSize),
+                            Ownership::Stream),
+                        dataSize, Ownership::Stream);
+
+    byte *readData = new byte[(size_t)dataSize];
+
+    reader.Read(readData, dataSize);
+    CHECK_FALSE(memcmp(readData, data, (size_t)dataSize));
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+
+    delete[] readData;
+  }
+
+  // with the index, the decompressor can seek to arbitrary offsets
+  {
+    ZSTDBlockIndex index;
+    index.frameOffsets.assign(frameOffsets, (size_t)numBlocks);
+
+    StreamReader reader(new ZSTDDecompressor(
+                            new StreamReader(buf.GetData(), buf.GetOffset() - indexSize),
+                            Ownership::Stream, index),
+                        dataSize, Ownership::Stream);
+
+    const uint64_t offsets[] = {
+        5 * 1024 * 1024 + 17, 1000, 0, dataSize - 64, ZSTDBlockSize - 8, 3 * ZSTDBlockSize,
+        8 * 1024 * 1024,      1024,
+    };
+
+    byte readData[256];
+
+    for(uint64_t offs : offsets)
+    {
+      uint64_t len = RDCMIN((uint64_t)sizeof(readData), dataSize - offs);
+
+      reader.SetOffset(offs);
+      CHECK(reader.GetOffset() == offs);
+
+      reader.Read(readData, len);
+      CHECK_FALSE(memcmp(readData, data + offs, (size_t)len));
+      CHECK(reader.GetOffset() == offs + len);
+    }
+
+    reader.SetOffset(dataSize);
+    CHECK(reader.AtEnd());
+
+    CHECK_FALSE(reader.IsErrored());
+  }
+
+  delete[] data;
+};
+
+TEST_CASE("Test seeking in zstd compressed RDC sections", "[streamio][zstd]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "renderdoc_zstd_seek_test.rdc";
+
+  const uint64_t dataSize = 3 * 1024 * 1024 + 100;
+
+  bytebuf data;
+  data.resize((size_t)dataSize);
+  for(uint64_t i = 0; i < dataSize; i++)
+    data[(size_t)i] = byte((i * 31) ^ (i >> 11));
+
+  {
+    RDCFile rdc;
+    rdc.SetData(RDCDriver::Unknown, "test", 0, NULL, 0, 1.0);
+    rdc.Create(filename.c_str());
+
+    REQUIRE((rdc.ErrorCode() == ContainerError::NoError));
+
+    SectionProperties props;
+    props.type = SectionType::FrameCapture;
+    props.flags = SectionFlags::ZstdCompressed;
+
+    StreamWriter *writer = rdc.WriteSection(props);
+    writer->Write(data.data(), dataSize);
+    writer->Finish();
+    CHECK_FALSE(writer->IsErrored());
+    delete writer;
+
+    // write a second section after, to ensure the index doesn't get confused with it
+    props.type = SectionType::Notes;
+    props.flags = SectionFlags::NoFlags;
+    writer = rdc.WriteSection(props);
+    writer->Write("notes", 5);
+    writer->Finish();
+    delete writer;
+
+    // LZ4 sections have no index so can only be seeked forwards
+    props.type = SectionType::ResolveDatabase;
+    props.flags = SectionFlags::LZ4Compressed;
+    writer = rdc.WriteSection(props);
+    writer->Write(data.data(), dataSize);
+    writer->Finish();
+    delete writer;
+  }
+
+  {
+    RDCFile rdc;
+    rdc.Open(filename.c_str());
+
+    REQUIRE((rdc.ErrorCode() == ContainerError::NoError));
+
+    const SectionProperties &props = rdc.GetSectionProperties(0);
+    CHECK(props.uncompressedSize == dataSize);
+    CHECK(((props.flags & SectionFlags::ZstdBlockIndexed) == SectionFlags::ZstdBlockIndexed));
+
+    StreamReader *reader = rdc.ReadSection(0);
+
+    const uint64_t offsets[] = {dataSize - 1000, 200, 2 * 1024 * 1024 + 3, 0};
+
+    byte readData[512];
+
+    for(uint64_t offs : offsets)
+    {
+      reader->SetOffset(offs);
+      reader->Read(readData, sizeof(readData));
+      CHECK_FALSE(memcmp(readData, data.data() + offs, sizeof(readData)));
+    }
+
+    // a full sequential read should still work after seeking
+    bytebuf readback;
+    readback.resize((size_t)dataSize);
+    reader->SetOffset(0);
+    reader->Read(readback.data(), dataSize);
+    CHECK(readback == data);
+
+    CHECK_FALSE(reader->IsErrored());
+    delete reader;
+
+    reader = rdc.ReadSection(rdc.SectionIndex(SectionType::Notes));
+    char notes[6] = {};
+    reader->Read(notes, 5);
+    CHECK(rdcstr(notes) == "notes");
+    delete reader;
+
+    reader = rdc.ReadSection(rdc.SectionIndex(SectionType::ResolveDatabase));
+
+    reader->SetOffset(2000);
+    reader->Read(readData, sizeof(readData));
+    CHECK_FALSE(memcmp(readData, data.data() + 2000, sizeof(readData)));
+    CHECK_FALSE(reader->IsErrored());
+
+    // a failed seek must not leave the reader going on from the wrong offset
+    reader->SetOffset(100);
+    CHECK(reader->IsErrored());
+
+    delete reader;
+  }
+
+  FileIO::Delete(filename.c_str());
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,403 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "serialiser.h"
+#include <algorithm>
+#include <atomic>
+#include "common/threading.h"
+#include "core/core.h"
+#include "strings/string_utils.h"
+
+static void OffsetBufferIndices(SDObject *obj, uint64_t offset)
+{
+  if(obj->type.basetype == SDBasic::Buffer)
+    obj->data.basic.u += offset;
+
+  for(SDObject *child : obj->data.children)
+    OffsetBufferIndices(child, offset);
+}
+
+// decodes the chunk at offset in ser's reader into chunk. Any buffers are left in ser's structured
+// file, and the chunk's buffer objects index into those.
+static void DecodeChunk(ReadSerialiser &ser, IStructuredChunkDecoder *decoder, uint64_t offset,
+                        SDChunk *chunk)
+{
+  StreamReader *reader = ser.GetReader();
+
+  reader->SetOffset(offset);
+
+  uint32_t chunkID = ser.ReadChunk<uint32_t>();
+
+  bool success = decoder->DecodeChunk(ser, chunkID);
+
+  ser.EndChunk();
+
+  if(!success || reader->IsErrored())
+    RDCERR("Failed to decode chunk %u (%s)", chunk->storageIndex, chunk->name.c_str());
+
+  SDFile &decoded = ser.GetStructuredFile();
+
+  if(decoded.chunks.empty())
+    return;
+
+  SDChunk *src = decoded.chunks.back();
+  decoded.chunks.pop_back();
+
+  chunk->data.children.swap(src->data.children);
+  chunk->metadata.flags |= (src->metadata.flags & SDChunkFlags::OpaqueChunk);
+
+  delete src;
+}
+
+// owns the capture data and the driver's decoder, and decodes each chunk's children on first
+// access. Every chunk holds a reference, so this lives as long as any of the file's chunks.
+// This is the only implementation of SDChunkStorage.
+class LazyChunkStorage : public SDChunkStorage
+{
+public:
+  LazyChunkStorage(StreamReader *reader, IStructuredChunkDecoder *decoder, uint64_t version)
+      : m_Ser(reader, Ownership::Stream), m_Decoder(decoder), m_Version(version)
+  {
+    m_Ser.SetVersion(version);
+    m_Ser.ConfigureStructuredExport(m_Decoder->GetChunkLookup(), true, 0, 1.0);
+  }
+
+  ~LazyChunkStorage()
+  {
+    for(SDObjectArena *arena : m_DecodeArenas)
+      delete arena;
+    delete[] m_Decoded;
+    delete m_Decoder;
+  }
+
+  bool ReadChunks(const CallstackTable *callstacks, SDFile &file)
+  {
+    StreamReader *reader = m_Ser.GetReader();
+
+    // only the chunk headers are read, the rest of each chunk is skipped
+    ReadSerialiser ser(reader, Ownership::Nothing);
+
+    ser.SetVersion(m_Version);
+    ser.SetCallstackTable(callstacks);
+
+    ChunkLookup lookup = m_Decoder->GetChunkLookup();
+    std::map<uint32_t, rdcliteral> names;
+
+    m_File = &file;
+
+    while(!reader->AtEnd())
+    {
+      uint64_t offset = reader->GetOffset();
+
+      uint32_t chunkID = ser.ReadChunk<uint32_t>();
+
+      ser.EndChunk();
+
+      if(reader->IsErrored())
+        return false;
+
+      auto it = names.find(chunkID);
+      if(it == names.end())
+      {
+        rdcstr name = lookup(chunkID);
+        if(name.empty())
+          name = "<Unknown Chunk>";
+        it = names.insert(std::make_pair(chunkID, strintern(name))).first;
+      }
+
+      SDChunk *chunk = m_Arena.New<SDChunk>(it->second);
+      chunk->metadata = ser.ChunkMetadata();
+      chunk->type.byteSize = chunk->metadata.length;
+      chunk->type.flags |= SDTypeFlags::LazyChildren;
+      chunk->storage = this;
+      chunk->storageIndex = (uint32_t)m_Offsets.size();
+      Atomic::Inc32(&m_RefCount);
+
+      m_Offsets.push_back(offset);
+      file.chunks.push_back(chunk);
+
+      RenderDoc::Inst().SetProgress(LoadProgress::FileInitialRead,
+                                    float(reader->GetOffset()) / float(reader->GetSize()));
+
+      if((SystemChunk)chunkID == SystemChunk::CaptureEnd)
+        break;
+    }
+
+    m_EndOffset = reader->GetOffset();
+
+    m_Decoded = new std::atomic<bool>[m_Offsets.size()]();
+
+    return true;
+  }
+
+  void Populate(SDChunk *chunk)
+  {
+    std::atomic<bool> &decoded = m_Decoded[chunk->storageIndex];
+
+    // acquire pairs with the release once the children are decoded, so that they're visible to
+    // every thread that sees the chunk as decoded
+    if(decoded.load(std::memory_order_acquire))
+      return;
+
+    SCOPED_LOCK(m_Lock);
+
+    // another thread may have decoded this chunk while we waited for the lock
+    if(decoded.load(std::memory_order_relaxed))
+      return;
+
+    Decode(chunk);
+
+    decoded.store(true, std::memory_order_release);
+  }
+
+  void Release()
+  {
+    if(Atomic::Dec32(&m_RefCount) == 0)
+      delete this;
+  }
+
+  // decodes all of the given chunks that haven't been decoded yet. The chunks are split into
+  // contiguous ranges, each decoded on a worker thread with its own decoder and reader.
+  void PopulateAll(rdcarray<SDChunk *> chunks, size_t minChunksPerJob,
+                   RENDERDOC_ProgressCallback progress)
+  {
+    // nothing can be decoded on demand until we're done
+    SCOPED_LOCK(m_Lock);
+
+    chunks.removeIf([this](SDChunk *chunk) {
+      return m_Decoded[chunk->storageIndex].load(std::memory_order_relaxed);
+    });
+
+    if(chunks.empty())
+      return;
+
+    // each range must be contiguous in the capture
+    std::sort(chunks.begin(), chunks.end(), [](const SDChunk *a, const SDChunk *b) {
+      return a->storageIndex < b->storageIndex;
+    });
+
+    // a couple of ranges per thread, including this one, evens out ranges that are slower to decode
+    size_t numJobs = RDCMIN(chunks.size() / RDCMAX(minChunksPerJob, (size_t)1),
+                            ((size_t)Threading::JobSystem::NumWorkers() + 1) * 2);
+    numJobs = RDCMAX(numJobs, (size_t)1);
+
+    // decoders hold state while decoding, so every range needs its own
+    rdcarray<IStructuredChunkDecoder *> decoders = {m_Decoder};
+    while(decoders.size() < numJobs)
+    {
+      IStructuredChunkDecoder *decoder = m_Decoder->Clone();
+      if(!decoder)
+        break;
+      decoders.push_back(decoder);
+    }
+
+    numJobs = decoders.size();
+
+    rdcarray<DecodeJob> jobs;
+    jobs.resize(numJobs);
+
+    StreamReader *reader = m_Ser.GetReader();
+
+    for(size_t j = 0; j < numJobs; j++)
+    {
+      DecodeJob &job = jobs[j];
+
+      size_t first = chunks.size() * j / numJobs;
+      size_t last = chunks.size() * (j + 1) / numJobs;
+
+      job.chunks.assign(chunks.data() + first, last - first);
+      job.decoder = decoders[j];
+
+      // the decoded objects live as long as the chunks they're decoded into
+      job.arena = new SDObjectArena;
+      m_DecodeArenas.push_back(job.arena);
+
+      uint32_t lastIndex = job.chunks.back()->storageIndex;
+
+      job.baseOffset = m_Offsets[job.chunks[0]->storageIndex];
+      uint64_t endOffset =
+          lastIndex + 1 < m_Offsets.size() ? m_Offsets[lastIndex + 1] : m_EndOffset;
+
+      // shares the data if it's mapped, otherwise the range is copied out
+      reader->SetOffset(job.baseOffset);
+      job.reader = new StreamReader(reader, endOffset - job.baseOffset);
+    }
+
+    rdcarray<Threading::JobSystem::Job *> workerJobs;
+    for(DecodeJob &job : jobs)
+      workerJobs.push_back(Threading::JobSystem::AddJob([this, &job]() { DecodeRange(job); }));
+
+    for(size_t j = 0; j < numJobs; j++)
+    {
+      Threading::JobSystem::SyncJob(workerJobs[j]);
+
+      if(progress)
+        progress(float(j + 1) / float(numJobs));
+    }
+
+    // buffers are numbered from 0 in each range, so they're appended to the file in order
+    for(DecodeJob &job : jobs)
+    {
+      AdoptBuffers(job.chunks, job.buffers);
+
+      for(SDChunk *chunk : job.chunks)
+        m_Decoded[chunk->storageIndex].store(true, std::memory_order_release);
+
+      delete job.reader;
+    }
+
+    for(size_t j = 1; j < decoders.size(); j++)
+      delete decoders[j];
+  }
+
+private:
+  struct DecodeJob
+  {
+    rdcarray<SDChunk *> chunks;
+    IStructuredChunkDecoder *decoder = NULL;
+    SDObjectArena *arena = NULL;
+    StreamReader *reader = NULL;
+    uint64_t baseOffset = 0;
+    rdcarray<bytebuf *> buffers;
+  };
+
+  void DecodeRange(DecodeJob &job)
+  {
+    ReadSerialiser ser(job.reader, Ownership::Nothing);
+
+    ser.SetVersion(m_Version);
+    ser.UseStructuredArena(*job.arena);
+    ser.ConfigureStructuredExport(job.decoder->GetChunkLookup(), true, 0, 1.0);
+
+    for(SDChunk *chunk : job.chunks)
+      DecodeChunk(ser, job.decoder, m_Offsets[chunk->storageIndex] - job.baseOffset, chunk);
+
+    job.buffers.swap(ser.GetStructuredFile().buffers);
+  }
+
+  void Decode(SDChunk *chunk)
+  {
+    DecodeChunk(m_Ser, m_Decoder, m_Offsets[chunk->storageIndex], chunk);
+
+    AdoptBuffers({chunk}, m_Ser.GetStructuredFile().buffers);
+  }
+
+  // moves decoded buffers onto the end of the file's buffers, and points the chunks' buffer objects
+  // at their new indices
+  void AdoptBuffers(const rdcarray<SDChunk *> &chunks, rdcarray<bytebuf *> &buffers)
+  {
+    if(buffers.empty())
+      return;
+
+    uint64_t base = m_File->buffers.size();
+
+    for(SDChunk *chunk : chunks)
+      for(SDObject *child : chunk->data.children)
+        OffsetBufferIndices(child, base);
+
+    m_File->buffers.append(buffers);
+    buffers.clear();
+  }
+
+  int32_t m_RefCount = 1;
+
+  // everything below is protected by m_Lock once the chunks have been read
+  Threading::CriticalSection m_Lock;
+
+  ReadSerialiser m_Ser;
+  IStructuredChunkDecoder *m_Decoder;
+  uint64_t m_Version;
+  SDFile *m_File = NULL;
+
+  // the lazy chunks themselves are allocated in bulk
+  SDObjectArena m_Arena;
+  // objects decoded in parallel, which m_Ser's own arena holds for any decoded on demand
+  rdcarray<SDObjectArena *> m_DecodeArenas;
+
+  rdcarray<uint64_t> m_Offsets;
+  uint64_t m_EndOffset = 0;
+  std::atomic<bool> *m_Decoded = NULL;
+};
+
+bool ReadLazyStructuredFile(StreamReader *reader, IStructuredChunkDecoder *decoder,
+                            uint64_t version, const CallstackTable *callstacks, SDFile &file)
+{
+  LazyChunkStorage *storage = new LazyChunkStorage(reader, decoder, version);
+
+  file.version = version;
+
+  bool success = storage->ReadChunks(callstacks, file);
+
+  if(!success)
+  {
+    for(SDChunk *chunk : file.chunks)
+      delete chunk;
+    file.chunks.clear();
+  }
+
+  // each chunk holds its own reference, drop ours
+  storage->Release();
+
+  return success;
+}
+
+void PopulateStructuredChunks(const SDFile &file, RENDERDOC_ProgressCallback progress,
+                              size_t minChunksPerJob)
+{
+  // a file's lazy chunks normally all come from one storage, but group them in case they don't
+  rdcarray<SDChunkStorage *> storages;
+  rdcarray<rdcarray<SDChunk *>> storageChunks;
+
+  for(SDChunk *chunk : file.chunks)
+  {
+    if(!(chunk->type.flags & SDTypeFlags::LazyChildren))
+      continue;
+
+    int32_t idx = storages.indexOf(chunk->storage);
+    if(idx < 0)
+    {
+      idx = storages.count();
+      storages.push_back(chunk->storage);
+      storageChunks.push_back({});
+    }
+
+    storageChunks[idx].push_back(chunk);
+  }
+
+  for(size_t i = 0; i < storages.size(); i++)
+  {
+    RENDERDOC_ProgressCallback storageProgress;
+    if(progress)
+    {
+      storageProgress = [progress, i, &storages](float p) {
+        progress((float(i) + p) / float(storages.size()));
+      };
+    }
+
+    ((LazyChunkStorage *)storages[i])->PopulateAll(storageChunks[i], minChunksPerJob, storageProgress);
+  }
+
+  if(progress)
+    progress(1.0f);
+}
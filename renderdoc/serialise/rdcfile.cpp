@@ -30,6 +30,7 @@
 #include "jpeg-compressor/jpge.h"
 #include "stb/stb_image.h"
 #include "lz4io.h"
+#include "serialiser.h"
 #include "zstdio.h"
 
 // not provided by tinyexr, just do by hand
@@ -132,7 +133,9 @@ bool is_exr_file(FILE *f)
      uint32_t sectionNameLength; // byte length of the string below (minimum 1, for null terminator)
      char sectionName[sectionNameLength]; // UTF-8 string name of section, optional.
 
-     byte sectiondata[length]; // actual contents of the section
+     byte sectiondata[length]; // actual contents of the section. If sectionFlags contains
+                               // ZstdBlockIndexed then the compressed data is followed by a block
+                               // index, see ZSTDBlockIndexFooter.
    }
  };
 
@@ -248,6 +251,8 @@ RDCFile::~RDCFile()
 {
   if(m_File)
     FileIO::fclose(m_File);
+
+  SAFE_DELETE(m_Callstacks);
 }
 
 void RDCFile::Open(const char *path)
@@ -345,7 +350,10 @@ void RDCFile::Init(StreamReader &reader)
 
   // in v1.1 we changed chunk flags such that we could support 64-bit length. This is a backwards
   // compatible change
-  if(m_SerVer != SERIALISE_VERSION && m_SerVer != V1_0_VERSION && m_SerVer != V1_1_VERSION)
+  // in v1.3 chunks can refer to their callstack by ID into a callstack table section. This is also
+  // backwards compatible
+  if(m_SerVer != SERIALISE_VERSION && m_SerVer != V1_0_VERSION && m_SerVer != V1_1_VERSION &&
+     m_SerVer != V1_2_VERSION)
   {
     if(header.version < V1_0_VERSION)
     {
@@ -813,6 +821,28 @@ int RDCFile::SectionIndex(const char *name) const
   return -1;
 }
 
+const CallstackTable *RDCFile::GetCallstackTable()
+{
+  if(m_CallstacksLoaded)
+    return m_Callstacks;
+
+  m_CallstacksLoaded = true;
+
+  int index = SectionIndex(SectionType::CallstackTable);
+  if(index < 0)
+    return NULL;
+
+  StreamReader *reader = ReadSection(index);
+
+  m_Callstacks = new CallstackTable;
+  if(!m_Callstacks->Read(reader))
+    SAFE_DELETE(m_Callstacks);
+
+  delete reader;
+
+  return m_Callstacks;
+}
+
 StreamReader *RDCFile::ReadSection(int index) const
 {
   if(m_Error != ContainerError::NoError)
@@ -831,7 +861,34 @@ StreamReader *RDCFile::ReadSection(int index) const
   SectionLocation offsetSize = m_SectionLocations[index];
   FileIO::fseek64(m_File, offsetSize.dataOffset, SEEK_SET);
 
-  StreamReader *fileReader = new StreamReader(m_File, offsetSize.diskLength, Ownership::Nothing);
+  uint64_t diskLength = offsetSize.diskLength;
+
+  ZSTDBlockIndex blockIndex;
+
+  // the block index follows the compressed frames, exclude it from what the decompressor sees.
+  if((props.flags & SectionFlags::ZstdCompressed) && (props.flags & SectionFlags::ZstdBlockIndexed))
+  {
+    if(!ReadZSTDBlockIndex(m_File, offsetSize.dataOffset, diskLength, blockIndex))
+    {
+      RDCERR("Couldn't read block index for section %d", index);
+      return new StreamReader(StreamReader::InvalidStream);
+    }
+
+    diskLength -= blockIndex.GetStoredSize();
+
+    FileIO::fseek64(m_File, offsetSize.dataOffset, SEEK_SET);
+  }
+
+  // uncompressed sections are mapped where possible, so that data can be used directly from the
+  // mapping instead of being read through a buffer and copied out.
+  if(!(props.flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed)))
+  {
+    FileIO::FileMapping *mapping = FileIO::mapfile_open(m_File, offsetSize.dataOffset, diskLength);
+    if(mapping)
+      return new StreamReader(mapping, diskLength);
+  }
+
+  StreamReader *fileReader = new StreamReader(m_File, diskLength, Ownership::Nothing);
 
   StreamReader *compReader = NULL;
 
@@ -844,7 +901,9 @@ StreamReader *RDCFile::ReadSection(int index) const
   }
   else if(props.flags & SectionFlags::ZstdCompressed)
   {
-    compReader = new StreamReader(new ZSTDDecompressor(fileReader, Ownership::Stream),
+    // with a block index the reader can seek to any offset with SetOffset(), only decompressing
+    // the block containing it.
+    compReader = new StreamReader(new ZSTDDecompressor(fileReader, Ownership::Stream, blockIndex),
                                   props.uncompressedSize, Ownership::Stream);
   }
 
@@ -908,6 +967,14 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
 
   rdcstr name = props.name;
   SectionType type = props.type;
+  SectionFlags flags = props.flags;
+
+  // zstd sections are always compressed in parallel, which writes a block index. LZ4 takes
+  // precedence if both are somehow specified.
+  if((flags & SectionFlags::ZstdCompressed) && !(flags & SectionFlags::LZ4Compressed))
+    flags |= SectionFlags::ZstdBlockIndexed;
+  else
+    flags &= ~SectionFlags::ZstdBlockIndexed;
 
   // normalise names for known sections
   if(type != SectionType::Unknown && type < SectionType::Count)
@@ -1139,7 +1206,7 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
                                 // sectionVersion
                                 props.version,
                                 // sectionFlags
-                                props.flags,
+                                flags,
                                 // sectionNameLength
                                 uint32_t(name.length() + 1)};
 
@@ -1167,14 +1234,15 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
   }
   else if(props.flags & SectionFlags::ZstdCompressed)
   {
-    compWriter =
-        new StreamWriter(new ZSTDCompressor(fileWriter, Ownership::Stream), Ownership::Stream);
+    compWriter = new StreamWriter(new ZSTDParallelCompressor(fileWriter, Ownership::Stream),
+                                  Ownership::Stream);
   }
 
   uint64_t dataOffset = FileIO::ftell64(m_File);
 
   m_CurrentWritingProps = props;
   m_CurrentWritingProps.name = name;
+  m_CurrentWritingProps.flags = flags;
 
   // register a destroy callback to tidy up the section at the end
   fileWriter->AddCloseCallback([this, type, name, headerOffset, dataOffset, fileWriter, compWriter]() {
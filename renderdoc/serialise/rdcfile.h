@@ -38,6 +38,8 @@ enum class ContainerError
 
 extern const char *SectionTypeNames[];
 
+class CallstackTable;
+
 struct RDCThumb
 {
   bytebuf pixels;
@@ -60,13 +62,14 @@ public:
   // version number of overall file format or chunk organisation. If the contents/meaning/order of
   // chunks have changed this does not need to be bumped, there are version numbers within each
   // API that interprets the stream that can be bumped.
-  static const uint32_t SERIALISE_VERSION = 0x00000102;
+  static const uint32_t SERIALISE_VERSION = 0x00000103;
 
   // this must never be changed - files before this were in the v0.x series and didn't have embedded
   // version numbers
   static const uint32_t V1_0_VERSION = 0x00000100;
   static const uint32_t V1_1_VERSION = 0x00000101;
   static const uint32_t V1_2_VERSION = 0x00000102;
+  static const uint32_t V1_3_VERSION = 0x00000103;
 
   ~RDCFile();
 
@@ -98,6 +101,10 @@ public:
   StreamReader *ReadSection(int index) const;
   StreamWriter *WriteSection(const SectionProperties &props);
 
+  // the table of callstacks referenced by ID from the frame capture's chunks. Loaded the first time
+  // it's needed, returns NULL if the capture doesn't have one.
+  const CallstackTable *GetCallstackTable();
+
   // Only valid if GetDriver returns RDCDriver::Image, passes over the underlying FILE * for use
   // loading the image directly, since the RDC container isn't there to read from a section.
   FILE *StealImageFileHandle(rdcstr &filename);
@@ -133,4 +140,7 @@ private:
   rdcarray<SectionProperties> m_Sections;
   rdcarray<SectionLocation> m_SectionLocations;
   rdcarray<bytebuf> m_MemorySections;
+
+  bool m_CallstacksLoaded = false;
+  CallstackTable *m_Callstacks = NULL;
 };
@@ -26,6 +26,7 @@
 #define SERIALISER_IMPL
 
 #include "serialiser.h"
+#include "common/threading.h"
 #include "core/core.h"
 #include "strings/string_utils.h"
 
@@ -83,6 +84,489 @@ void DumpChunk(bool reading, FileIO::LogFileHandle *log, SDChunk *chunk)
   DumpObject(log, "  ", chunk);
 }
 
+static uint64_t structuredChunkCallbackTLSSlot = Threading::AllocateTLSSlot();
+
+ScopedStructuredChunkCallback::ScopedStructuredChunkCallback(SDFile &file,
+                                                             StructuredChunkCallback callback)
+    : m_File(file), m_Callback(callback)
+{
+  m_Prev =
+      (ScopedStructuredChunkCallback *)Threading::GetTLSValue(structuredChunkCallbackTLSSlot);
+  Threading::SetTLSValue(structuredChunkCallbackTLSSlot, this);
+}
+
+ScopedStructuredChunkCallback::~ScopedStructuredChunkCallback()
+{
+  Threading::SetTLSValue(structuredChunkCallbackTLSSlot, m_Prev);
+}
+
+ScopedStructuredChunkCallback *ScopedStructuredChunkCallback::Find(const SDFile &file)
+{
+  ScopedStructuredChunkCallback *cb =
+      (ScopedStructuredChunkCallback *)Threading::GetTLSValue(structuredChunkCallbackTLSSlot);
+
+  while(cb && &cb->m_File != &file)
+    cb = cb->m_Prev;
+
+  return cb;
+}
+
+void ScopedStructuredChunkCallback::ChunkRead(SDFile &file)
+{
+  ScopedStructuredChunkCallback *cb = Find(file);
+
+  if(cb)
+    cb->m_Callback(file);
+}
+
+bool ScopedStructuredChunkCallback::Streaming(const SDFile &file)
+{
+  return Find(file) != NULL;
+}
+
+// the first page is small so that serialisers exporting only a few objects don't waste memory,
+// then pages double in size up to the maximum.
+static const size_t SDObjectArenaMinPageSize = 4 * 1024;
+static const size_t SDObjectArenaMaxPageSize = 256 * 1024;
+
+// keep each allocation and its arena prefix 8-byte aligned
+static size_t SDObjectArenaAllocSize(size_t size)
+{
+  return AlignUp(size + SDObjectAlloc::PrefixSize, (size_t)8);
+}
+
+struct SDObjectArena::Pages : public SDObjectArenaBase
+{
+  struct Page
+  {
+    Page *next;
+    // the end of the allocations in this page
+    byte *end;
+  };
+
+  // two pointers, which keeps the allocations after it 8-byte aligned
+  static const size_t HeaderSize = sizeof(Page);
+
+  Pages() { release = &Release; }
+  // one reference for the arena itself, and one for each live chunk allocated from it
+  int32_t refcount = 1;
+
+  Page *first = NULL;
+  Page *cur = NULL;
+  size_t pageSize = 0;
+
+  static void Release(SDObjectArenaBase *base)
+  {
+    Pages *pages = (Pages *)base;
+
+    if(Atomic::Dec32(&pages->refcount) == 0)
+    {
+      pages->Free();
+      delete pages;
+    }
+  }
+
+  void Free()
+  {
+    // destroy every object that hasn't been deleted in one pass over the pages. The pages aren't
+    // freed until afterwards, so the objects can still refer to each other while this happens.
+    for(Page *page = first; page; page = page->next)
+    {
+      byte *it = (byte *)page + HeaderSize;
+
+      while(it < page->end)
+      {
+        uint64_t prefix = *(uint64_t *)it;
+        SDObject *obj = (SDObject *)(it + SDObjectAlloc::PrefixSize);
+
+        if(prefix & SDObjectAlloc::ChunkFlag)
+        {
+          // chunks keep the arena alive, so they must all have been deleted by now
+          RDCASSERT(prefix & SDObjectAlloc::DeadFlag);
+          it += SDObjectArenaAllocSize(sizeof(SDChunk));
+        }
+        else
+        {
+          if(!(prefix & SDObjectAlloc::DeadFlag))
+            obj->~SDObject();
+          it += SDObjectArenaAllocSize(sizeof(SDObject));
+        }
+      }
+    }
+
+    for(Page *page = first; page;)
+    {
+      Page *next = page->next;
+      SDObjectAlloc::FreeMem(page);
+      page = next;
+    }
+  }
+};
+
+SDObjectArena::~SDObjectArena()
+{
+  // drop the arena's own reference, the pages are freed once every chunk in them is deleted
+  if(m_Pages)
+    Pages::Release(m_Pages);
+}
+
+void *SDObjectArena::Allocate(size_t size, bool chunk)
+{
+  size_t allocSize = SDObjectArenaAllocSize(size);
+
+  if(m_Pages == NULL)
+    m_Pages = new Pages;
+
+  Pages::Page *page = m_Pages->cur;
+
+  if(page == NULL || page->end + allocSize > (byte *)page + m_Pages->pageSize)
+  {
+    m_Pages->pageSize =
+        RDCCLAMP(m_Pages->pageSize * 2, SDObjectArenaMinPageSize, SDObjectArenaMaxPageSize);
+
+    page = (Pages::Page *)SDObjectAlloc::AllocateMem(m_Pages->pageSize);
+    page->next = NULL;
+    page->end = (byte *)page + Pages::HeaderSize;
+
+    if(m_Pages->cur)
+      m_Pages->cur->next = page;
+    else
+      m_Pages->first = page;
+    m_Pages->cur = page;
+
+    m_NumPages++;
+  }
+
+  byte *ret = page->end;
+  page->end += allocSize;
+
+  *(uint64_t *)ret = (uint64_t)(uintptr_t)m_Pages;
+
+  if(chunk)
+  {
+    *(uint64_t *)ret |= SDObjectAlloc::ChunkFlag;
+    Atomic::Inc32(&m_Pages->refcount);
+  }
+
+  return ret + SDObjectAlloc::PrefixSize;
+}
+
+CallstackTable::CallstackTable(uint32_t generation) : m_Generation(generation)
+{
+  // the root node, for an empty callstack
+  m_Addrs.push_back(0);
+  m_Parents.push_back(0);
+}
+
+namespace
+{
+struct CaptureCallstacks
+{
+  Threading::CriticalSection lock;
+  CallstackTable *current = NULL;
+  // kept so that chunks recorded in the previous capture can be moved into the current table
+  CallstackTable *previous = NULL;
+  uint32_t generation = 0;
+  bool capturing = false;
+};
+
+CaptureCallstacks &GetCaptureCallstacks()
+{
+  static CaptureCallstacks callstacks;
+  return callstacks;
+}
+}
+
+void CallstackTable::BeginCapture()
+{
+  CaptureCallstacks &callstacks = GetCaptureCallstacks();
+
+  SCOPED_LOCK(callstacks.lock);
+
+  // generation 0 is left for tables that aren't interned into
+  callstacks.generation = (callstacks.generation % 255) + 1;
+
+  if(callstacks.previous)
+    callstacks.previous->Release();
+  callstacks.previous = callstacks.current;
+  callstacks.current = new CallstackTable(callstacks.generation);
+  callstacks.capturing = true;
+}
+
+void CallstackTable::EndCapture()
+{
+  CaptureCallstacks &callstacks = GetCaptureCallstacks();
+
+  SCOPED_LOCK(callstacks.lock);
+
+  callstacks.capturing = false;
+}
+
+uint32_t CallstackTable::GetCaptureGeneration()
+{
+  CaptureCallstacks &callstacks = GetCaptureCallstacks();
+
+  // read without locking, serialisers check this for every chunk. A serialiser that sees the
+  // previous generation only produces IDs that are remapped when they're written
+  return callstacks.capturing ? callstacks.generation : 0;
+}
+
+CallstackTable *CallstackTable::GetCapture()
+{
+  CaptureCallstacks &callstacks = GetCaptureCallstacks();
+
+  SCOPED_LOCK(callstacks.lock);
+
+  if(callstacks.current)
+    callstacks.current->AddRef();
+  return callstacks.current;
+}
+
+uint32_t CallstackTable::RemapCaptureID(uint32_t id)
+{
+  CaptureCallstacks &callstacks = GetCaptureCallstacks();
+
+  if(id == 0)
+    return 0;
+
+  SCOPED_LOCK(callstacks.lock);
+
+  const uint32_t generation = id >> GenerationShift;
+
+  if(callstacks.current && generation == callstacks.current->m_Generation)
+    return id;
+
+  rdcarray<uint64_t> callstack;
+  if(callstacks.current && callstacks.previous &&
+     generation == callstacks.previous->m_Generation &&
+     callstacks.previous->GetCallstack(id, callstack))
+    return callstacks.current->Intern(callstack.data(), callstack.size());
+
+  return 0;
+}
+
+uint64_t CallstackTable::NodeHash(uint32_t parent, uint64_t addr)
+{
+  return (addr * 0x9E3779B97F4A7C15ULL) ^ (uint64_t(parent) * 0xC2B2AE3D27D4EB4FULL);
+}
+
+uint32_t CallstackTable::FindNode(uint32_t parent, uint64_t addr, uint64_t hash) const
+{
+  if(m_Slots.empty())
+    return 0;
+
+  const size_t mask = m_Slots.size() - 1;
+
+  for(size_t slot = size_t(hash) & mask;; slot = (slot + 1) & mask)
+  {
+    uint32_t n = m_Slots[slot];
+    if(n == 0 || (m_Parents[n] == parent && m_Addrs[n] == addr))
+      return n;
+  }
+}
+
+void CallstackTable::InsertNode(uint32_t node, uint64_t hash)
+{
+  const size_t mask = m_Slots.size() - 1;
+
+  size_t slot = size_t(hash) & mask;
+  while(m_Slots[slot] != 0)
+    slot = (slot + 1) & mask;
+
+  m_Slots[slot] = node;
+}
+
+void CallstackTable::RehashSlots()
+{
+  // keep the slots at most half full, so probes stay short
+  size_t size = RDCMAX(m_Slots.size(), size_t(1024));
+  while(m_Parents.size() * 2 > size)
+    size *= 2;
+
+  m_Slots.clear();
+  m_Slots.fill(size, 0);
+
+  for(uint32_t n = 1; n < m_Parents.size(); n++)
+    InsertNode(n, NodeHash(m_Parents[n], m_Addrs[n]));
+}
+
+uint32_t CallstackTable::Intern(const uint64_t *addrs, size_t numLevels, InternCache *cache)
+{
+  uint32_t node = 0;
+
+  // walk down from the outermost frame, so that callstacks with common callers share nodes
+  size_t i = numLevels;
+
+  // follow the cache for as long as it knows the nodes. Nodes are never removed so the cached ones
+  // stay valid, and the table's lock is only needed for callstacks with frames not seen recently
+  if(cache)
+  {
+    for(; i > 0; i--)
+    {
+      const uint64_t addr = addrs[i - 1];
+      const InternCache::Entry &entry =
+          cache->entries[NodeHash(node, addr) & (InternCache::Size - 1)];
+
+      if(entry.node == 0 || entry.parent != node || entry.addr != addr)
+        break;
+
+      node = entry.node;
+    }
+
+    if(i == 0)
+      return MakeID(node);
+  }
+
+  SCOPED_LOCK(m_Lock);
+
+  for(; i > 0; i--)
+  {
+    const uint64_t addr = addrs[i - 1];
+    const uint64_t hash = NodeHash(node, addr);
+
+    uint32_t child = FindNode(node, addr, hash);
+
+    if(child == 0)
+    {
+      if(m_Parents.size() > NodeMask)
+        return 0;
+
+      child = (uint32_t)m_Parents.size();
+      m_Addrs.push_back(addr);
+      m_Parents.push_back(node);
+
+      if(m_Parents.size() * 2 > m_Slots.size())
+        RehashSlots();
+      else
+        InsertNode(child, hash);
+    }
+
+    if(cache)
+      cache->entries[hash & (InternCache::Size - 1)] = {addr, node, child};
+
+    node = child;
+  }
+
+  return MakeID(node);
+}
+
+bool CallstackTable::GetCallstack(uint32_t id, rdcarray<uint64_t> &callstack) const
+{
+  callstack.clear();
+
+  SCOPED_LOCK(m_Lock);
+
+  id &= NodeMask;
+
+  if(id >= m_Parents.size())
+    return false;
+
+  // parents always come before their children, so this terminates at the root
+  for(uint32_t n = id; n != 0; n = m_Parents[n])
+    callstack.push_back(m_Addrs[n]);
+
+  return true;
+}
+
+void CallstackTable::Write(StreamWriter *writer)
+{
+  SCOPED_LOCK(m_Lock);
+
+  uint32_t numNodes = (uint32_t)m_Parents.size();
+  writer->Write(numNodes);
+  writer->Write(m_Parents.data(), m_Parents.byteSize());
+  writer->Write(m_Addrs.data(), m_Addrs.byteSize());
+}
+
+void CallstackTable::Write(StreamWriter *writer, const rdchashset<uint32_t> &referenced)
+{
+  SCOPED_LOCK(m_Lock);
+
+  // keep the referenced nodes and all their parents, and only go as far as the highest one
+  rdcarray<byte> keep;
+  keep.fill(m_Parents.size(), 0);
+
+  uint32_t numNodes = 1;
+
+  for(uint32_t id : referenced)
+  {
+    // IDs from another capture's table were remapped when their chunk was written
+    if((id >> GenerationShift) != m_Generation)
+      continue;
+
+    id &= NodeMask;
+
+    if(id >= m_Parents.size())
+      continue;
+
+    numNodes = RDCMAX(numNodes, id + 1);
+
+    for(uint32_t n = id; n != 0 && !keep[n]; n = m_Parents[n])
+      keep[n] = 1;
+  }
+
+  // nodes that aren't kept are written as empty children of the root, which compress away
+  rdcarray<uint32_t> parents;
+  rdcarray<uint64_t> addrs;
+  parents.fill(numNodes, 0);
+  addrs.fill(numNodes, 0);
+
+  for(uint32_t n = 1; n < numNodes; n++)
+  {
+    if(keep[n])
+    {
+      parents[n] = m_Parents[n];
+      addrs[n] = m_Addrs[n];
+    }
+  }
+
+  writer->Write(numNodes);
+  writer->Write(parents.data(), parents.byteSize());
+  writer->Write(addrs.data(), addrs.byteSize());
+}
+
+bool CallstackTable::Read(StreamReader *reader)
+{
+  SCOPED_LOCK(m_Lock);
+
+  uint32_t numNodes = 0;
+  reader->Read(numNodes);
+
+  // each node takes 12 bytes, so reject sizes that can't fit in what's left of the stream
+  if(reader->IsErrored() || numNodes == 0 || numNodes > NodeMask + 1 ||
+     numNodes > reader->GetSize() / 12)
+  {
+    RDCERR("Invalid callstack table with %u nodes", numNodes);
+    return false;
+  }
+
+  m_Parents.resize(numNodes);
+  m_Addrs.resize(numNodes);
+  reader->Read(m_Parents.data(), m_Parents.byteSize());
+  reader->Read(m_Addrs.data(), m_Addrs.byteSize());
+
+  for(uint32_t n = 1; n < numNodes; n++)
+  {
+    if(m_Parents[n] >= n)
+    {
+      RDCERR("Invalid parent %u for callstack node %u", m_Parents[n], n);
+      reader->SetErrored();
+      break;
+    }
+  }
+
+  if(reader->IsErrored())
+  {
+    m_Parents.resize(1);
+    m_Addrs.resize(1);
+  }
+
+  // rebuild the slots so that the table can still be interned into
+  RehashSlots();
+
+  return !reader->IsErrored();
+}
+
 /////////////////////////////////////////////////////////////
 // Read Serialiser functions
 
@@ -95,8 +579,12 @@ Serialiser<SerialiserMode::Reading>::Serialiser(StreamReader *reader, Ownership
 
   m_Ownership = own;
 
+  // the objects are owned by the root object, which could outlive any arena of ours
   if(rootStructuredObj)
+  {
     m_StructureStack.push_back(rootStructuredObj);
+    m_Arena = NULL;
+  }
 }
 
 template <>
@@ -127,6 +615,17 @@ uint32_t Serialiser<SerialiserMode::Reading>::BeginChunk(uint32_t, uint64_t)
 
     m_ChunkMetadata.chunkID = chunkID;
 
+    if(c & ChunkCallstackID)
+    {
+      uint32_t callstackID = 0;
+      m_Read->Read(callstackID);
+
+      m_ChunkMetadata.flags |= SDChunkFlags::HasCallstack;
+
+      if(m_Callstacks && !m_Callstacks->GetCallstack(callstackID, m_ChunkMetadata.callstack))
+        RDCERR("Read invalid callstack ID: %u", callstackID);
+    }
+
     if(c & ChunkCallstack)
     {
       uint32_t numFrames = 0;
@@ -183,12 +682,13 @@ uint32_t Serialiser<SerialiserMode::Reading>::BeginChunk(uint32_t, uint64_t)
 
   if(ExportStructure())
   {
-    rdcstr name = m_ChunkLookup ? m_ChunkLookup(chunkID) : "";
+    rdcliteral name = GetStructuredChunkName(chunkID);
 
-    if(name.empty())
-      name = "<Unknown Chunk>";
+    // chunks that are streamed out are deleted as soon as they're read, so the arena would only
+    // grow until the serialiser is done
+    m_ChunkArena = ScopedStructuredChunkCallback::Streaming(*m_StructuredFile) ? NULL : m_Arena;
 
-    SDChunk *chunk = new SDChunk(name.c_str());
+    SDChunk *chunk = m_ChunkArena ? m_ChunkArena->New<SDChunk>(name) : new SDChunk(name);
     chunk->metadata = m_ChunkMetadata;
 
     m_StructuredFile->chunks.push_back(chunk);
@@ -210,7 +710,7 @@ void Serialiser<SerialiserMode::Reading>::SkipCurrentChunk()
 
     SDObject &current = *m_StructureStack.back();
 
-    current.data.children.push_back(new SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
+    current.data.children.push_back(NewObject("Opaque chunk"_lit, "Byte Buffer"_lit));
 
     SDObject &obj = *current.data.children.back();
     obj.type.basetype = SDBasic::Buffer;
@@ -278,6 +778,8 @@ void Serialiser<SerialiserMode::Reading>::EndChunk()
     {
       DumpChunk(true, m_DebugDumpLog, m_StructuredFile->chunks.back());
     }
+
+    ScopedStructuredChunkCallback::ChunkRead(*m_StructuredFile);
   }
 
   // only skip remaining bytes if we have a valid length - if we have a length of 0 we wrote this
@@ -328,6 +830,10 @@ Serialiser<SerialiserMode::Writing>::~Serialiser()
     m_Write->Finish();
     delete m_Write;
   }
+
+  if(m_InternCallstacks)
+    m_InternCallstacks->Release();
+  delete m_InternCache;
 }
 
 template <>
@@ -339,6 +845,68 @@ void Serialiser<SerialiserMode::Writing>::SetChunkMetadataRecording(uint32_t fla
   m_ChunkFlags = flags;
 }
 
+template <>
+void Serialiser<SerialiserMode::Writing>::AddChunkCallstackID(byte *chunkData)
+{
+  if(!m_CallstackIDs)
+    return;
+
+  // the chunk header starts with the flags, followed directly by the callstack ID if there is one
+  uint32_t c = 0;
+  memcpy(&c, chunkData, sizeof(c));
+
+  if(c & ChunkCallstackID)
+  {
+    uint32_t callstackID = 0;
+    memcpy(&callstackID, chunkData + sizeof(c), sizeof(callstackID));
+
+    // chunks that outlive the capture they were recorded in, like resources created mid-frame,
+    // refer to that capture's table. Move them into this one so they stay current from now on
+    uint32_t remapped = CallstackTable::RemapCaptureID(callstackID);
+    if(remapped != callstackID)
+    {
+      memcpy(chunkData + sizeof(c), &remapped, sizeof(remapped));
+      callstackID = remapped;
+    }
+
+    if(callstackID != 0)
+      m_CallstackIDs->insert(callstackID);
+  }
+}
+
+template <>
+uint32_t Serialiser<SerialiserMode::Writing>::InternCallstack(const uint64_t *addrs,
+                                                              size_t numLevels)
+{
+  const uint32_t generation = CallstackTable::GetCaptureGeneration();
+
+  // outside of a frame capture callstacks are written inline, so there's no table to keep alive
+  if(generation == 0)
+  {
+    if(m_InternCallstacks)
+      m_InternCallstacks->Release();
+    m_InternCallstacks = NULL;
+    return 0;
+  }
+
+  // pick up the table when a new capture starts. The cached nodes belong to the old one
+  if(!m_InternCallstacks || m_InternCallstacks->GetGeneration() != generation)
+  {
+    if(m_InternCallstacks)
+      m_InternCallstacks->Release();
+    m_InternCallstacks = CallstackTable::GetCapture();
+
+    if(!m_InternCache)
+      m_InternCache = new CallstackTable::InternCache;
+    *m_InternCache = CallstackTable::InternCache();
+
+    if(!m_InternCallstacks)
+      return 0;
+  }
+
+  return m_InternCallstacks->Intern(addrs, numLevels, m_InternCache);
+}
+
 template <>
 uint32_t Serialiser<SerialiserMode::Writing>::BeginChunk(uint32_t chunkID, uint64_t byteLength)
 {
@@ -358,29 +926,57 @@ uint32_t Serialiser<SerialiserMode::Writing>::BeginChunk(uint32_t chunkID, uint6
 
       /////////////////
 
-      m_Write->Write(c);
+      // callstacks we collect during a frame capture are interned into the capture's callstack
+      // table and only the ID is written. Chunks recorded in the background can be written into
+      // any later capture, so their callstacks are written inline, as are callstacks that are
+      // already set (e.g. from structured data).
+      uint32_t callstackID = 0;
 
-      if(c & ChunkCallstack)
+      if((c & ChunkCallstack) && m_ChunkMetadata.callstack.empty())
       {
-        if(m_ChunkMetadata.callstack.empty())
-        {
-          bool collect = RenderDoc::Inst().GetCaptureOptions().captureCallstacks;
+        bool collect = RenderDoc::Inst().GetCaptureOptions().captureCallstacks;
 
-          if(RenderDoc::Inst().GetCaptureOptions().captureCallstacksOnlyDraws)
-            collect = collect && m_DrawChunk;
+        if(RenderDoc::Inst().GetCaptureOptions().captureCallstacksOnlyDraws)
+          collect = collect && m_DrawChunk;
 
-          if(collect)
+        if(collect)
+        {
+          Callstack::Stackwalk *stack = Callstack::Collect();
+          if(stack && stack->NumLevels() > 0)
           {
-            Callstack::Stackwalk *stack = Callstack::Collect();
-            if(stack && stack->NumLevels() > 0)
-            {
-              m_ChunkMetadata.callstack.assign(stack->GetAddrs(), stack->NumLevels());
-            }
+            callstackID = InternCallstack(stack->GetAddrs(), stack->NumLevels());
 
-            SAFE_DELETE(stack);
+            if(callstackID == 0 || ExportStructure())
+              m_ChunkMetadata.callstack.assign(stack->GetAddrs(), stack->NumLevels());
           }
+
+          SAFE_DELETE(stack);
         }
 
+        if(callstackID != 0)
+        {
+          c &= ~ChunkCallstack;
+          c |= ChunkCallstackID;
+
+          if(m_CallstackIDs)
+            callstackID = CallstackTable::RemapCaptureID(callstackID);
+        }
+      }
+
+      m_Write->Write(c);
+
+      if(c & ChunkCallstackID)
+      {
+        m_ChunkMetadata.flags |= SDChunkFlags::HasCallstack;
+
+        m_Write->Write(callstackID);
+
+        if(m_CallstackIDs && callstackID != 0)
+          m_CallstackIDs->insert(callstackID);
+      }
+
+      if(c & ChunkCallstack)
+      {
         m_ChunkMetadata.flags |= SDChunkFlags::HasCallstack;
 
         uint32_t numFrames = (uint32_t)m_ChunkMetadata.callstack.size();
@@ -442,12 +1038,11 @@ uint32_t Serialiser<SerialiserMode::Writing>::BeginChunk(uint32_t chunkID, uint6
 
   if(ExportStructure())
   {
-    rdcstr name = m_ChunkLookup ? m_ChunkLookup(chunkID) : "";
+    rdcliteral name = GetStructuredChunkName(chunkID);
 
-    if(name.empty())
-      name = "<Unknown Chunk>";
+    m_ChunkArena = m_Arena;
 
-    SDChunk *chunk = new SDChunk(name.c_str());
+    SDChunk *chunk = m_ChunkArena ? m_ChunkArena->New<SDChunk>(name) : new SDChunk(name);
     chunk->metadata = m_ChunkMetadata;
 
     m_StructuredFile->chunks.push_back(chunk);
@@ -588,6 +1183,8 @@ void Serialiser<SerialiserMode::Writing>::WriteStructuredFile(const SDFile &file
 
     ser->BeginChunk(m_ChunkMetadata.chunkID, m_ChunkMetadata.length);
 
+    chunk.PopulateChildren();
+
     if(chunk.metadata.flags & SDChunkFlags::OpaqueChunk)
     {
       RDCASSERT(chunk.data.children.size() == 1);
@@ -639,6 +1236,7 @@ rdcstr DoStringise(const SDTypeFlags &el)
     STRINGISE_BITFIELD_CLASS_BIT(NullString);
     STRINGISE_BITFIELD_CLASS_BIT(FixedArray);
     STRINGISE_BITFIELD_CLASS_BIT(Union);
+    STRINGISE_BITFIELD_CLASS_BIT(LazyChildren);
   }
   END_BITFIELD_STRINGISE();
 }
@@ -724,6 +1322,9 @@ void DoSerialise(SerialiserType &ser, SDObject &el)
 template <class SerialiserType>
 void DoSerialise(SerialiserType &ser, SDChunk &el)
 {
+  if(ser.IsWriting())
+    el.PopulateChildren();
+
   SERIALISE_MEMBER(name);
   SERIALISE_MEMBER(type);
   SERIALISE_MEMBER(data);
@@ -1016,6 +1617,12 @@ Chunk *Chunk::Create(Serialiser<SerialiserMode::Writing> &ser, uint16_t chunkTyp
   return ret;
 }
 
+void Chunk::Write(Serialiser<SerialiserMode::Writing> &ser)
+{
+  ser.AddChunkCallstackID(m_Data);
+  ser.GetWriter()->Write((const void *)m_Data, (size_t)m_Length);
+}
+
 ChunkAllocator::~ChunkAllocator()
 {
   for(Page &p : freePages)
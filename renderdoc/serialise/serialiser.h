@@ -24,9 +24,13 @@
 
 #pragma once
 
+#include <map>
 #include <set>
+#include "api/replay/rdchashmap.h"
 #include "api/replay/structured_data.h"
 #include "common/formatting.h"
+#include "common/threading.h"
+#include "strings/string_utils.h"
 #include "streamio.h"
 
 // function to deallocate anything from a serialise. Default impl
@@ -55,6 +59,9 @@ enum class SerialiserFlags
 {
   NoFlags = 0x0,
   AllocateMemory = 0x1,
+  // with AllocateMemory, when reading from a file mapping byte buffers may point directly into the
+  // mapping instead of being allocated. Check IsInPlace() before freeing the buffer.
+  ReadInPlace = 0x2,
 };
 
 BITMASK_OPERATORS(SerialiserFlags);
@@ -80,6 +87,117 @@ enum class SerialiserMode
 
 struct CompressedFileIO;
 
+// bump allocator for structured data objects, see SDObjectArenaBase. Pages start small so that
+// short-lived serialisers exporting only a few objects don't waste memory, and grow up to a fixed
+// maximum. The pages are kept alive by this arena and by every chunk allocated from it, and are
+// all freed together once the last of those is gone.
+class SDObjectArena
+{
+public:
+  SDObjectArena() = default;
+  SDObjectArena(const SDObjectArena &) = delete;
+  SDObjectArena &operator=(const SDObjectArena &) = delete;
+  ~SDObjectArena();
+  template <typename T, typename... ConstructArgs>
+  T *New(ConstructArgs... args)
+  {
+    static_assert(std::is_same<T, SDObject>::value || std::is_same<T, SDChunk>::value,
+                  "Only SDObject and SDChunk can be allocated in an arena");
+    return new(Allocate(sizeof(T), std::is_same<T, SDChunk>::value)) T(args...);
+  }
+
+  uint64_t GetNumPages() const { return m_NumPages; }
+private:
+  struct Pages;
+
+  void *Allocate(size_t size, bool chunk);
+
+  Pages *m_Pages = NULL;
+  uint64_t m_NumPages = 0;
+};
+
+// callstacks are interned into a trie of (parent, address) nodes built from the outermost frame
+// inwards, so stacks with common callers share nodes and each chunk only needs to store the 32-bit
+// ID of the node for its innermost frame. Node 0 is the root, an empty callstack.
+//
+// Each frame capture interns into a new table. The top bits of an ID hold the generation of the
+// capture's table, so that chunks recorded in one capture and written again in a later one can be
+// told apart.
+class CallstackTable
+{
+public:
+  // a cache of recently interned nodes. Each writing serialiser keeps one, so callstacks that were
+  // seen recently are interned without taking the table's lock
+  struct InternCache
+  {
+    struct Entry
+    {
+      uint64_t addr;
+      uint32_t parent;
+      uint32_t node;
+    };
+
+    static const uint32_t Size = 1024;
+    Entry entries[Size] = {};
+  };
+
+  CallstackTable(uint32_t generation = 0);
+  CallstackTable(const CallstackTable &) = delete;
+  CallstackTable &operator=(const CallstackTable &) = delete;
+
+  void AddRef() { Atomic::Inc32(&m_RefCount); }
+  void Release()
+  {
+    if(Atomic::Dec32(&m_RefCount) == 0)
+      delete this;
+  }
+
+  // starts a new table that callstacks are interned into until the capture ends
+  static void BeginCapture();
+  static void EndCapture();
+  // the generation of the table to intern into, or 0 if no frame is being captured
+  static uint32_t GetCaptureGeneration();
+  // the most recent capture's table with a reference added, or NULL if there hasn't been one
+  static CallstackTable *GetCapture();
+  // returns the ID of the same callstack in the most recent capture's table. Callstacks from the
+  // capture before are interned again, any older ones can't be found and come back empty
+  static uint32_t RemapCaptureID(uint32_t id);
+
+  // returns 0 if the table is full
+  uint32_t Intern(const uint64_t *addrs, size_t numLevels, InternCache *cache = NULL);
+  // returns false if the ID isn't in the table
+  bool GetCallstack(uint32_t id, rdcarray<uint64_t> &callstack) const;
+  size_t NumNodes() const { return m_Parents.size(); }
+  uint32_t GetGeneration() const { return m_Generation; }
+  void Write(StreamWriter *writer);
+  // writes only the given callstacks. IDs are unchanged, so any other nodes are written as empty
+  void Write(StreamWriter *writer, const rdchashset<uint32_t> &referenced);
+  bool Read(StreamReader *reader);
+
+private:
+  static const uint32_t GenerationShift = 24;
+  static const uint32_t NodeMask = (1U << GenerationShift) - 1;
+
+  static uint64_t NodeHash(uint32_t parent, uint64_t addr);
+  uint32_t MakeID(uint32_t node) const
+  {
+    return node == 0 ? 0 : (m_Generation << GenerationShift) | node;
+  }
+  uint32_t FindNode(uint32_t parent, uint64_t addr, uint64_t hash) const;
+  void InsertNode(uint32_t node, uint64_t hash);
+  void RehashSlots();
+
+  int32_t m_RefCount = 1;
+  uint32_t m_Generation;
+
+  mutable Threading::CriticalSection m_Lock;
+
+  rdcarray<uint64_t> m_Addrs;
+  rdcarray<uint32_t> m_Parents;
+  // open-addressed hash of (parent, address) to node, 0 for an empty slot
+  rdcarray<uint32_t> m_Slots;
+};
+
 template <SerialiserMode sertype>
 class Serialiser
 {
@@ -105,6 +223,8 @@ public:
     ChunkDuration = 0x00040000,
     ChunkTimestamp = 0x00080000,
     Chunk64BitSize = 0x00100000,
+    // set in place of ChunkCallstack when the callstack is stored as an ID in a CallstackTable
+    ChunkCallstackID = 0x00200000,
   };
 
   //////////////////////////////////////////
@@ -119,6 +239,9 @@ public:
   bool IsDummy() { return m_Dummy; }
   StreamWriter *GetWriter() { return m_Write; }
   StreamReader *GetReader() { return m_Read; }
+  // returns true if the buffer was read with SerialiserFlags::ReadInPlace and points into the
+  // stream, so it doesn't need to be freed.
+  bool IsInPlace(const void *buf) const { return IsReading() && m_Read->IsMappedPointer(buf); }
   uint32_t GetChunkMetadataRecording() { return m_ChunkFlags; }
   void SetChunkMetadataRecording(uint32_t flags);
   void SetChunkTimestampBasis(uint64_t base, double freq)
@@ -137,6 +260,13 @@ public:
   void *GetUserData() { return m_pUserData; }
   void SetUserData(void *userData) { m_pUserData = userData; }
   void SetStringDatabase(std::set<rdcstr> *db) { m_ExtStringDB = db; }
+  // the table to look up callstack IDs in chunk metadata. Without one, those callstacks are empty
+  void SetCallstackTable(const CallstackTable *table) { m_Callstacks = table; }
+  // when writing, collects the IDs of the interned callstacks that written chunks refer to
+  void SetCallstackIDs(rdchashset<uint32_t> *ids) { m_CallstackIDs = ids; }
+  // notes the callstack ID of a chunk that is written as raw bytes, see SetCallstackIDs. If the
+  // chunk was recorded in an earlier capture its ID is updated in place
+  void AddChunkCallstackID(byte *chunkData);
   // jumps to the byte after the current chunk, can be called any time after BeginChunk
   void SkipCurrentChunk();
 
@@ -163,10 +293,17 @@ public:
   //////////////////////////////////////////
   // Public serialisation interface
 
+  // by default structured objects are allocated in bulk from this serialiser's own arena. This
+  // allows them to be allocated individually instead, or from an arena that outlives the
+  // serialiser.
+  void SetStructuredArena(bool arena) { m_Arena = arena ? &m_ObjectArena : NULL; }
+  void UseStructuredArena(SDObjectArena &arena) { m_Arena = &arena; }
+  SDObjectArena &GetStructuredArena() { return m_ObjectArena; }
   void ConfigureStructuredExport(ChunkLookup lookup, bool includeBuffers, uint64_t timeBase,
                                  double timeFreq)
   {
     m_ChunkLookup = lookup;
+    m_ChunkNames.clear();
     m_ExportBuffers = includeBuffers;
     m_ExportStructured = (lookup != NULL);
     m_TimerBase = timeBase;
@@ -226,7 +363,7 @@ public:
 
       SDObject &current = *m_StructureStack.back();
 
-      current.data.children.push_back(new SDObject(name, TypeName<T>()));
+      current.data.children.push_back(NewObject(name, TypeName<T>()));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -272,7 +409,7 @@ public:
 
       SDObject &current = *m_StructureStack.back();
 
-      current.data.children.push_back(new SDObject(name, "Byte Buffer"_lit));
+      current.data.children.push_back(NewObject(name, "Byte Buffer"_lit));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -281,6 +418,7 @@ public:
     }
 
     byte *tempAlloc = NULL;
+    bool tempMapped = false;
 
     {
       if(IsWriting())
@@ -301,28 +439,49 @@ public:
 // Coverity is unable to tie this allocation together with the automatic scoped deallocation in the
 // ScopedDeseralise* classes. We can verify with e.g. valgrind that there are no leaks, so to keep
 // the analysis non-spammy we just don't allocate for coverity builds
+        byte *mapped = NULL;
+
 #if !defined(__COVERITY__)
         if(!m_Dummy && (flags & SerialiserFlags::AllocateMemory))
         {
-          if(byteSize > 0)
+          if(byteSize > 0 && (flags & SerialiserFlags::ReadInPlace))
+            mapped = m_Read->ReadMapped(byteSize);
+
+          // hand out the mapped data directly if possible. We require 16-byte alignment since
+          // consumers may assume buffers are suitably aligned for SIMD loads, as allocated buffers
+          // are.
+          if(mapped && ((uintptr_t)mapped & 0xf) == 0)
+            el = mapped;
+          else if(byteSize > 0)
             el = AllocAlignedBuffer(byteSize);
           else
             el = NULL;
         }
 
-        // if we're exporting the buffers, make sure to always alloc space to read the data, so we
-        // can save it out, even if the external code has no use for it and has asked for no
-        // allocation.
+        // if we're exporting the buffers, make sure to always have somewhere to read the data, so
+        // we can save it out, even if the external code has no use for it and has asked for no
+        // allocation. From a mapping we can copy directly without a temporary buffer.
         if(el == NULL && ExportStructure() && m_ExportBuffers)
         {
           if(byteSize > 0)
-            el = tempAlloc = AllocAlignedBuffer(byteSize);
+          {
+            el = m_Read->ReadMapped(byteSize);
+            tempMapped = (el != NULL);
+
+            if(el == NULL)
+              el = tempAlloc = AllocAlignedBuffer(byteSize);
+          }
           else
+          {
             el = NULL;
+          }
         }
 #endif
 
-        m_Read->Read(el, byteSize);
+        if(mapped && el != mapped)
+          memcpy(el, mapped, (size_t)byteSize);
+        else if(!mapped && !tempMapped)
+          m_Read->Read(el, byteSize);
       }
     }
 
@@ -351,6 +510,10 @@ public:
       FreeAlignedBuffer(tempAlloc);
       el = NULL;
     }
+    else if(tempMapped)
+    {
+      el = NULL;
+    }
 #endif
 
     return *this;
@@ -382,7 +545,7 @@ public:
 
       SDObject &current = *m_StructureStack.back();
 
-      current.data.children.push_back(new SDObject(name, "Byte Buffer"_lit));
+      current.data.children.push_back(NewObject(name, "Byte Buffer"_lit));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -494,7 +657,7 @@ public:
       }
 
       SDObject &parent = *m_StructureStack.back();
-      parent.data.children.push_back(new SDObject(name, TypeName<T>()));
+      parent.data.children.push_back(NewObject(name, TypeName<T>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -506,7 +669,7 @@ public:
 
       for(size_t i = 0; i < N; i++)
       {
-        arr.data.children[i] = new SDObject("$el"_lit, TypeName<T>());
+        arr.data.children[i] = NewObject("$el"_lit, TypeName<T>());
         m_StructureStack.push_back(arr.data.children[i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -613,7 +776,7 @@ public:
       }
 
       SDObject &parent = *m_StructureStack.back();
-      parent.data.children.push_back(new SDObject(name, TypeName<T>()));
+      parent.data.children.push_back(NewObject(name, TypeName<T>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -637,7 +800,7 @@ public:
 
       for(uint64_t i = 0; el && i < arrayCount; i++)
       {
-        arr.data.children[(size_t)i] = new SDObject("$el"_lit, TypeName<T>());
+        arr.data.children[(size_t)i] = NewObject("$el"_lit, TypeName<T>());
         m_StructureStack.push_back(arr.data.children[(size_t)i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -704,7 +867,7 @@ public:
       }
 
       SDObject &parent = *m_StructureStack.back();
-      parent.data.children.push_back(new SDObject(name, TypeName<U>()));
+      parent.data.children.push_back(NewObject(name, TypeName<U>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -718,7 +881,7 @@ public:
 
       for(size_t i = 0; i < (size_t)size; i++)
       {
-        arr.data.children[i] = new SDObject("$el"_lit, TypeName<U>());
+        arr.data.children[i] = NewObject("$el"_lit, TypeName<U>());
         m_StructureStack.push_back(arr.data.children[i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -759,7 +922,7 @@ public:
       }
 
       SDObject &parent = *m_StructureStack.back();
-      parent.data.children.push_back(new SDObject(name, "pair"_lit));
+      parent.data.children.push_back(NewObject(name, "pair"_lit));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -769,7 +932,7 @@ public:
       arr.data.children.resize(2);
 
       {
-        arr.data.children[0] = new SDObject("first"_lit, TypeName<U>());
+        arr.data.children[0] = NewObject("first"_lit, TypeName<U>());
         m_StructureStack.push_back(arr.data.children[0]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -784,7 +947,7 @@ public:
       }
 
       {
-        arr.data.children[1] = new SDObject("second"_lit, TypeName<V>());
+        arr.data.children[1] = NewObject("second"_lit, TypeName<V>());
         m_StructureStack.push_back(arr.data.children[1]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -875,7 +1038,7 @@ public:
       else
       {
         SDObject &parent = *m_StructureStack.back();
-        parent.data.children.push_back(new SDObject(name, TypeName<T>()));
+        parent.data.children.push_back(NewObject(name, TypeName<T>()));
 
         SDObject &nullable = *parent.data.children.back();
         nullable.type.basetype = SDBasic::Null;
@@ -962,7 +1125,7 @@ public:
 
       SDObject &current = *m_StructureStack.back();
 
-      current.data.children.push_back(new SDObject(name.c_str(), "Byte Buffer"_lit));
+      current.data.children.push_back(NewObject(name.c_str(), "Byte Buffer"_lit));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -1047,7 +1210,14 @@ public:
     return *this;
   }
 
+  // non-literal names are interned, so they're shared between every object they're applied to
   Serialiser &TypedAs(const rdcstr &name)
+  {
+    if(ExportStructure())
+      return TypedAs(strintern(name));
+    return *this;
+  }
+  Serialiser &TypedAs(const rdcliteral &name)
   {
     if(ExportStructure() && !m_StructureStack.empty())
     {
@@ -1070,6 +1240,12 @@ public:
   }
 
   Serialiser &Named(const rdcstr &name)
+  {
+    if(ExportStructure())
+      return Named(strintern(name));
+    return *this;
+  }
+  Serialiser &Named(const rdcliteral &name)
   {
     if(ExportStructure() && !m_StructureStack.empty())
     {
@@ -1313,8 +1489,26 @@ private:
   SDFile *m_StructuredFile = &m_StructData;
   rdcarray<SDObject *> m_StructureStack;
 
+  SDObjectArena m_ObjectArena;
+  SDObjectArena *m_Arena = &m_ObjectArena;
+  // the arena for the current chunk's objects, if any
+  SDObjectArena *m_ChunkArena = NULL;
+
+  SDObject *NewObject(const rdcstr &name, const rdcstr &typeName)
+  {
+    if(m_ChunkArena)
+      return m_ChunkArena->New<SDObject>(name, typeName);
+    return new SDObject(name, typeName);
+  }
+
   uint32_t m_ChunkFlags = 0;
   SDChunkMetaData m_ChunkMetadata;
+  const CallstackTable *m_Callstacks = NULL;
+  rdchashset<uint32_t> *m_CallstackIDs = NULL;
+  // the capture's table that collected callstacks are interned into
+  CallstackTable *m_InternCallstacks = NULL;
+  CallstackTable::InternCache *m_InternCache = NULL;
+  uint32_t InternCallstack(const uint64_t *addrs, size_t numLevels);
   double m_TimerFrequency = 1.0;
   uint64_t m_TimerBase = 0;
 
@@ -1338,6 +1532,27 @@ private:
   }
 
   ChunkLookup m_ChunkLookup = NULL;
+
+  // interned names for each chunk ID looked up so far, so that the lookup function isn't called
+  // again for every chunk and every structured chunk shares the same name storage.
+  std::map<uint32_t, rdcliteral> m_ChunkNames;
+
+  rdcliteral GetStructuredChunkName(uint32_t chunkID)
+  {
+    auto it = m_ChunkNames.find(chunkID);
+    if(it != m_ChunkNames.end())
+      return it->second;
+
+    rdcstr name = m_ChunkLookup ? m_ChunkLookup(chunkID) : "";
+
+    if(name.empty())
+      name = "<Unknown Chunk>";
+
+    rdcliteral ret = strintern(name);
+    m_ChunkNames.insert(std::make_pair(chunkID, ret));
+    return ret;
+  }
+
   FileIO::LogFileHandle *m_DebugDumpLog = NULL;
 };
 
@@ -1441,6 +1656,63 @@ void DoSerialise(SerialiserType &ser, rdcstr &el)
 
 DECLARE_STRINGISE_TYPE(SDObject *);
 
+// while in scope, each time a chunk is completely read into the given structured file on this
+// thread, the callback is given the file. Chunks read into any other structured file, e.g. by a
+// nested serialiser, are ignored. The callback can then write out any new chunks and buffers, and
+// delete them, replacing them with NULL, so that converting a whole capture doesn't need to hold all
+// of its structured data in memory at once.
+typedef std::function<void(SDFile &file)> StructuredChunkCallback;
+
+class ScopedStructuredChunkCallback
+{
+public:
+  ScopedStructuredChunkCallback(SDFile &file, StructuredChunkCallback callback);
+  ~ScopedStructuredChunkCallback();
+
+  static void ChunkRead(SDFile &file);
+  // returns true if chunks read into this file will be streamed out and deleted
+  static bool Streaming(const SDFile &file);
+
+private:
+  static ScopedStructuredChunkCallback *Find(const SDFile &file);
+
+  SDFile &m_File;
+  StructuredChunkCallback m_Callback;
+  ScopedStructuredChunkCallback *m_Prev;
+};
+
+class ReadSerialiser;
+
+// decodes single chunks of a driver's frame capture into structured data. Chunks are decoded in any
+// order, so decoding a chunk must only depend on the chunk's own data and not on the chunks before
+// it. A decoder is only used from one thread at a time.
+class IStructuredChunkDecoder
+{
+public:
+  virtual ~IStructuredChunkDecoder() = default;
+  // used to name the structured chunks
+  virtual ChunkLookup GetChunkLookup() = 0;
+  // decode the chunk that has just been begun on ser, which is configured for structured export
+  virtual bool DecodeChunk(ReadSerialiser &ser, uint32_t chunkID) = 0;
+  // create another decoder with its own state, so that chunks can be decoded on several threads at
+  // once. May return NULL if that's not possible.
+  virtual IStructuredChunkDecoder *Clone() = 0;
+};
+
+// reads only the header of each chunk into the structured file, recording where each chunk is so
+// that its children are decoded the first time they're accessed. See SDTypeFlags::LazyChildren.
+// The reader must be seekable, and it's owned along with the decoder by the chunks from then on.
+// Buffers are added to the file as the chunks that refer to them are decoded, so the file must not
+// be swapped while any chunks are still lazy. Returns false and leaves the file empty on failure.
+bool ReadLazyStructuredFile(StreamReader *reader, IStructuredChunkDecoder *decoder,
+                            uint64_t version, const CallstackTable *callstacks, SDFile &file);
+
+// decodes every lazy chunk in the file that hasn't been decoded yet. The chunks are split into
+// ranges of at least minChunksPerJob chunks, which are decoded in parallel by separate decoders.
+static const size_t PopulateChunksPerJobMin = 256;
+void PopulateStructuredChunks(const SDFile &file, RENDERDOC_ProgressCallback progress,
+                              size_t minChunksPerJob = PopulateChunksPerJobMin);
+
 class ScopedChunk;
 
 class ChunkAllocator
@@ -1578,10 +1850,7 @@ public:
     return ret;
   }
 
-  void Write(Serialiser<SerialiserMode::Writing> &ser)
-  {
-    ser.GetWriter()->Write((const void *)m_Data, (size_t)m_Length);
-  }
+  void Write(Serialiser<SerialiserMode::Writing> &ser);
 
 private:
   Chunk() = default;
@@ -1698,7 +1967,7 @@ struct ScopedDeserialiseArray<SerialiserType, void *>
   ScopedDeserialiseArray(const SerialiserType &ser, void **el, uint64_t) : m_Ser(ser), m_El(el) {}
   ~ScopedDeserialiseArray()
   {
-    if(m_Ser.IsReading())
+    if(m_Ser.IsReading() && !m_Ser.IsInPlace(*m_El))
       FreeAlignedBuffer((byte *)*m_El);
   }
   const SerialiserType &m_Ser;
@@ -1714,7 +1983,7 @@ struct ScopedDeserialiseArray<SerialiserType, const void *>
   }
   ~ScopedDeserialiseArray()
   {
-    if(m_Ser.IsReading())
+    if(m_Ser.IsReading() && !m_Ser.IsInPlace(*m_El))
       FreeAlignedBuffer((byte *)*m_El);
   }
   const SerialiserType &m_Ser;
@@ -1727,7 +1996,7 @@ struct ScopedDeserialiseArray<SerialiserType, byte *>
   ScopedDeserialiseArray(const SerialiserType &ser, byte **el, uint64_t) : m_Ser(ser), m_El(el) {}
   ~ScopedDeserialiseArray()
   {
-    if(m_Ser.IsReading())
+    if(m_Ser.IsReading() && !m_Ser.IsInPlace(*m_El))
       FreeAlignedBuffer(*m_El);
   }
   const SerialiserType &m_Ser;
@@ -1766,6 +2035,16 @@ struct ScopedDeserialiseArray<SerialiserType, byte *>
       GET_SERIALISER, &obj, count);                                                               \
   GET_SERIALISER.Serialise(STRING_LITERAL(#obj), obj, count, SerialiserFlags::AllocateMemory)
 
+// for byte buffers that are only needed while the chunk is processed, allowing them to be used
+// directly from a mapped file without copying.
+#define SERIALISE_ELEMENT_ARRAY_INPLACE(obj, count)                                                \
+  uint64_t CONCAT(dummy_array_count, __LINE__) = 0;                                               \
+  (void)CONCAT(dummy_array_count, __LINE__);                                                      \
+  ScopedDeserialiseArray<decltype(GET_SERIALISER), decltype(obj)> CONCAT(deserialise_, __LINE__)( \
+      GET_SERIALISER, &obj, count);                                                               \
+  GET_SERIALISER.Serialise(STRING_LITERAL(#obj), obj, count,                                      \
+                           SerialiserFlags::AllocateMemory | SerialiserFlags::ReadInPlace)
+
 #define SERIALISE_ELEMENT_OPT(obj)                                           \
   ScopedDeserialiseNullable<decltype(GET_SERIALISER), decltype(obj)> CONCAT( \
       deserialise_, __LINE__)(GET_SERIALISER, &obj);                         \
@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "serialiser.h"
+#include "core/core.h"
 
 #if ENABLED(ENABLE_UNIT_TESTS)
 
@@ -595,6 +596,70 @@ TEST_CASE("Read/writing large buffers", "[serialiser]")
   FileIO::Delete(filename.c_str());
 };
 
+TEST_CASE("Read buffers in-place from a mapped stream", "[serialiser]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/scratch_mapped.bin";
+
+  bytebuf buffer;
+  buffer.resize(1024 * 1024);
+  for(size_t i = 0; i < buffer.size(); i++)
+    buffer[i] = byte((rand() & 0xff0) >> 4);
+
+  {
+    WriteSerialiser ser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+
+    byte *buf = buffer.data();
+    uint64_t size = buffer.size();
+
+    ser.WriteChunk(1);
+    ser.Serialise("size"_lit, size);
+    ser.Serialise("buffer"_lit, buf, size);
+    ser.EndChunk();
+
+    FileIO::WriteAll(filename, ser.GetWriter()->GetData(), (size_t)ser.GetWriter()->GetOffset());
+  }
+
+  uint64_t fileSize = FileIO::GetFileSize(filename);
+
+  for(bool inplace : {false, true})
+  {
+    FILE *f = FileIO::fopen(filename.c_str(), "rb");
+    REQUIRE(f);
+    FileIO::FileMapping *mapping = FileIO::mapfile_open(f, 0, fileSize);
+    FileIO::fclose(f);
+
+    REQUIRE(mapping);
+
+    ReadSerialiser ser(new StreamReader(mapping, fileSize), Ownership::Stream);
+
+    ser.ReadChunk<uint32_t>();
+    {
+      byte *buf = NULL;
+      uint64_t size = 0;
+      ser.Serialise("size"_lit, size);
+      ser.Serialise("buffer"_lit, buf, size,
+                    inplace ? SerialiserFlags::AllocateMemory | SerialiserFlags::ReadInPlace
+                            : SerialiserFlags::AllocateMemory);
+
+      REQUIRE(buf);
+      CHECK(size == buffer.size());
+      CHECK(memcmp(buf, buffer.data(), buffer.size()) == 0);
+
+      // the data starts at a page boundary in the file so it's always aligned enough to be used
+      // in-place
+      CHECK(ser.IsInPlace(buf) == inplace);
+
+      if(!ser.IsInPlace(buf))
+        FreeAlignedBuffer(buf);
+    }
+    ser.EndChunk();
+
+    CHECK_FALSE(ser.IsErrored());
+  }
+
+  FileIO::Delete(filename.c_str());
+};
+
 TEST_CASE("Read/write chunk metadata", "[serialiser]")
 {
   StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
@@ -682,6 +747,259 @@ TEST_CASE("Read/write chunk metadata", "[serialiser]")
   delete buf;
 };
 
+TEST_CASE("Callstacks are deduplicated into a table", "[serialiser]")
+{
+  CallstackTable table;
+
+  // callstacks are innermost first, and share nodes from the outermost frame inwards
+  const uint64_t stackA[] = {10, 20, 30, 40};
+  const uint64_t stackB[] = {11, 20, 30, 40};
+  const uint64_t stackC[] = {30, 40};
+
+  uint32_t idA = table.Intern(stackA, 4);
+  uint32_t idB = table.Intern(stackB, 4);
+  uint32_t idC = table.Intern(stackC, 2);
+
+  CHECK(idA != idB);
+  CHECK(idC != idA);
+  CHECK(table.Intern(stackA, 4) == idA);
+  CHECK(table.Intern(stackB, 4) == idB);
+
+  // root + 40, 30, 20, 10 + 11. stackC is a prefix of the shared part
+  CHECK(table.NumNodes() == 6);
+
+  rdcarray<uint64_t> callstack;
+
+  SECTION("Lookup")
+  {
+    REQUIRE(table.GetCallstack(idA, callstack));
+    CHECK(callstack == rdcarray<uint64_t>({10, 20, 30, 40}));
+
+    REQUIRE(table.GetCallstack(idB, callstack));
+    CHECK(callstack == rdcarray<uint64_t>({11, 20, 30, 40}));
+
+    REQUIRE(table.GetCallstack(idC, callstack));
+    CHECK(callstack == rdcarray<uint64_t>({30, 40}));
+
+    REQUIRE(table.GetCallstack(0, callstack));
+    CHECK(callstack.empty());
+
+    CHECK_FALSE(table.GetCallstack(1000, callstack));
+  }
+
+  SECTION("Write and read back")
+  {
+    StreamWriter writer(StreamWriter::DefaultScratchSize);
+    table.Write(&writer);
+
+    CallstackTable readTable;
+    StreamReader reader(writer.GetData(), writer.GetOffset());
+    REQUIRE(readTable.Read(&reader));
+
+    CHECK(readTable.NumNodes() == table.NumNodes());
+
+    REQUIRE(readTable.GetCallstack(idB, callstack));
+    CHECK(callstack == rdcarray<uint64_t>({11, 20, 30, 40}));
+
+    // interning into a read table finds the existing nodes
+    CHECK(readTable.Intern(stackC, 2) == idC);
+  }
+
+  SECTION("Write only referenced callstacks")
+  {
+    rdchashset<uint32_t> referenced;
+    referenced.insert(idC);
+
+    StreamWriter writer(StreamWriter::DefaultScratchSize);
+    table.Write(&writer, referenced);
+
+    CallstackTable readTable;
+    StreamReader reader(writer.GetData(), writer.GetOffset());
+    REQUIRE(readTable.Read(&reader));
+
+    // nothing after the highest referenced node is written
+    CHECK(readTable.NumNodes() == idC + 1);
+
+    REQUIRE(readTable.GetCallstack(idC, callstack));
+    CHECK(callstack == rdcarray<uint64_t>({30, 40}));
+
+    CHECK_FALSE(readTable.GetCallstack(idA, callstack));
+
+    referenced.insert(idB);
+
+    writer.Rewind();
+    table.Write(&writer, referenced);
+
+    CallstackTable readTable2;
+    StreamReader reader2(writer.GetData(), writer.GetOffset());
+    REQUIRE(readTable2.Read(&reader2));
+
+    CHECK(readTable2.NumNodes() == table.NumNodes());
+
+    // IDs are unchanged, and unreferenced nodes in between are empty
+    REQUIRE(readTable2.GetCallstack(idB, callstack));
+    CHECK(callstack == rdcarray<uint64_t>({11, 20, 30, 40}));
+
+    REQUIRE(readTable2.GetCallstack(idA, callstack));
+    CHECK_FALSE(callstack == rdcarray<uint64_t>({10, 20, 30, 40}));
+  }
+
+  SECTION("Interning through a cache")
+  {
+    CallstackTable::InternCache cache;
+
+    // the first intern fills the cache, the second is found entirely in it
+    CHECK(table.Intern(stackA, 4, &cache) == idA);
+    CHECK(table.Intern(stackA, 4, &cache) == idA);
+    CHECK(table.Intern(stackB, 4, &cache) == idB);
+
+    const uint64_t stackD[] = {12, 20, 30, 40};
+    uint32_t idD = table.Intern(stackD, 4, &cache);
+
+    CHECK(table.NumNodes() == 7);
+    CHECK(table.Intern(stackD, 4) == idD);
+
+    REQUIRE(table.GetCallstack(idD, callstack));
+    CHECK(callstack == rdcarray<uint64_t>({12, 20, 30, 40}));
+  }
+
+  SECTION("Chunks reference the capture's table")
+  {
+    const CaptureOptions prevOpts = RenderDoc::Inst().GetCaptureOptions();
+
+    CaptureOptions opts = prevOpts;
+    opts.captureCallstacks = true;
+    opts.captureCallstacksOnlyDraws = false;
+    RenderDoc::Inst().SetCaptureOptions(opts);
+
+    StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+    rdchashset<uint32_t> ids;
+
+    // chunks recorded from the same place, so they all have the same callstack:
+    // 0 - outside of a capture, so the callstack is stored inline
+    // 1 - during a capture and then written into the next one, like a resource created mid-frame
+    // 2 - during the capture they're written into
+    Chunk *chunks[3] = {};
+
+    WriteSerialiser chunkSer(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+    chunkSer.SetChunkMetadataRecording(WriteSerialiser::ChunkCallstack);
+
+    for(int i = 0; i < 3; i++)
+    {
+      if(i > 0)
+      {
+        CallstackTable::EndCapture();
+        CallstackTable::BeginCapture();
+      }
+
+      chunkSer.WriteChunk(1);
+      chunkSer.EndChunk();
+
+      chunks[i] = Chunk::Create(chunkSer, 1);
+    }
+
+    {
+      WriteSerialiser ser(buf, Ownership::Nothing);
+
+      ser.SetChunkMetadataRecording(WriteSerialiser::ChunkCallstack);
+      ser.SetCallstackIDs(&ids);
+
+      for(int i = 0; i < 2; i++)
+      {
+        ser.WriteChunk(1);
+        ser.EndChunk();
+      }
+    }
+
+    CallstackTable::EndCapture();
+
+    RenderDoc::Inst().SetCaptureOptions(prevOpts);
+
+    // both chunks are written from the same place so they share one callstack
+    CHECK(ids.size() == 1);
+
+    // chunks recorded elsewhere and written as-is are tracked too
+    {
+      rdchashset<uint32_t> chunkIds;
+
+      WriteSerialiser ser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+      ser.SetCallstackIDs(&chunkIds);
+
+      for(Chunk *c : chunks)
+        c->Write(ser);
+
+      // the chunk from the previous capture is moved into this capture's table, where it finds the
+      // same callstack
+      CHECK(chunkIds.size() == 1);
+
+      ReadSerialiser readSer(
+          new StreamReader(ser.GetWriter()->GetData(), ser.GetWriter()->GetOffset()),
+          Ownership::Stream);
+
+      CallstackTable *callstacks = CallstackTable::GetCapture();
+      REQUIRE(callstacks);
+      readSer.SetCallstackTable(callstacks);
+
+      rdcarray<uint64_t> stacks[3];
+
+      for(int i = 0; i < 3; i++)
+      {
+        readSer.ReadChunk<uint32_t>();
+        CHECK(bool(readSer.ChunkMetadata().flags & SDChunkFlags::HasCallstack));
+        stacks[i] = readSer.ChunkMetadata().callstack;
+        readSer.EndChunk();
+      }
+
+      CHECK_FALSE(stacks[0].empty());
+      CHECK(stacks[1] == stacks[0]);
+      CHECK(stacks[2] == stacks[0]);
+
+      callstacks->Release();
+
+      REQUIRE_FALSE(readSer.IsErrored());
+    }
+
+    for(Chunk *c : chunks)
+      c->Delete();
+
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    // the table is written with only the referenced callstacks, as into a capture file
+    StreamWriter tableWriter(StreamWriter::DefaultScratchSize);
+    {
+      CallstackTable *callstacks = CallstackTable::GetCapture();
+      callstacks->Write(&tableWriter, ids);
+      callstacks->Release();
+    }
+
+    CallstackTable readTable;
+    StreamReader tableReader(tableWriter.GetData(), tableWriter.GetOffset());
+    REQUIRE(readTable.Read(&tableReader));
+
+    ser.SetCallstackTable(&readTable);
+
+    rdcarray<uint64_t> first;
+
+    ser.ReadChunk<uint32_t>();
+    CHECK(bool(ser.ChunkMetadata().flags & SDChunkFlags::HasCallstack));
+    first = ser.ChunkMetadata().callstack;
+    ser.EndChunk();
+
+    ser.ReadChunk<uint32_t>();
+    CHECK(bool(ser.ChunkMetadata().flags & SDChunkFlags::HasCallstack));
+    // both chunks are written from the same place so they share one callstack
+    CHECK_FALSE(first.empty());
+    CHECK(ser.ChunkMetadata().callstack == first);
+    ser.EndChunk();
+
+    REQUIRE_FALSE(ser.IsErrored());
+    CHECK(ser.GetReader()->AtEnd());
+
+    delete buf;
+  }
+};
+
 TEST_CASE("Verify multiple chunks can be merged", "[serialiser][chunks]")
 {
   StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
@@ -1386,6 +1704,476 @@ TEST_CASE("Read/write complex types", "[serialiser][structured]")
   delete buf;
 };
 
+static void WriteSyntheticCapture(StreamWriter *buf, int numChunks)
+{
+  WriteSerialiser ser(buf, Ownership::Nothing);
+
+  for(int i = 0; i < numChunks; i++)
+  {
+    SCOPED_SERIALISE_CHUNK((uint32_t)SystemChunk::FirstDriverChunk + (i % 16));
+
+    uint32_t index = i;
+    SERIALISE_ELEMENT(index);
+
+    struct2 complex;
+    complex.name = "A complex object";
+    complex.floats = {1.2f, 3.4f, float(i)};
+    complex.viewports.resize(i % 8);
+
+    SERIALISE_ELEMENT(complex);
+
+    const struct1 *inputParam = (i % 2) ? new struct1(9.0f, 9.9f, 9.99f, float(i)) : NULL;
+
+    SERIALISE_ELEMENT_OPT(inputParam);
+
+    delete inputParam;
+
+    if(i % 4 == 0)
+    {
+      bytebuf blob;
+      for(int b = 0; b < 16 + i % 32; b++)
+        blob.push_back(byte(i + b));
+
+      SERIALISE_ELEMENT(blob);
+    }
+  }
+}
+
+static bool ReadSyntheticChunk(ReadSerialiser &ser)
+{
+  uint32_t index;
+  SERIALISE_ELEMENT(index);
+
+  struct2 complex;
+  SERIALISE_ELEMENT(complex);
+
+  const struct1 *inputParam;
+  SERIALISE_ELEMENT_OPT(inputParam);
+
+  if(index % 4 == 0)
+  {
+    bytebuf blob;
+    SERIALISE_ELEMENT(blob);
+  }
+
+  return !ser.IsErrored();
+}
+
+static SDFile *ReadSyntheticCapture(StreamWriter *buf, int numChunks, bool arena,
+                                    uint64_t *numPages = NULL)
+{
+  ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+  ser.SetStructuredArena(arena);
+  ser.ConfigureStructuredExport([](uint32_t) -> rdcstr { return "TestChunk"; }, true, 0, 1.0);
+
+  for(int i = 0; i < numChunks; i++)
+  {
+    ser.ReadChunk<uint32_t>();
+    ReadSyntheticChunk(ser);
+    ser.EndChunk();
+  }
+
+  if(numPages)
+    *numPages = ser.GetStructuredArena().GetNumPages();
+
+  SDFile *ret = new SDFile;
+  ret->Swap(ser.GetStructuredFile());
+  return ret;
+}
+
+static uint64_t CountObjects(const SDObject *obj)
+{
+  uint64_t ret = 1;
+  for(const SDObject *child : *obj)
+    ret += CountObjects(child);
+  return ret;
+}
+
+TEST_CASE("Structured objects allocated in bulk", "[serialiser][structured]")
+{
+  const int numChunks = 500;
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  WriteSyntheticCapture(buf, numChunks);
+
+  uint64_t numPages = 0;
+  SDFile *arenaFile = ReadSyntheticCapture(buf, numChunks, true, &numPages);
+  SDFile *heapFile = ReadSyntheticCapture(buf, numChunks, false);
+
+  REQUIRE(arenaFile->chunks.size() == numChunks);
+  REQUIRE(heapFile->chunks.size() == numChunks);
+
+  uint64_t numObjects = 0;
+  for(int i = 0; i < numChunks; i++)
+  {
+    CHECK(arenaFile->chunks[i]->HasEqualValue(heapFile->chunks[i]));
+    numObjects += CountObjects(arenaFile->chunks[i]);
+  }
+
+  CHECK(numPages > 1);
+  CHECK(numPages * 100 < numObjects);
+
+  // chunk names are interned, so every chunk of the same type shares one copy
+  CHECK(arenaFile->chunks[0]->name.c_str() == heapFile->chunks[16]->name.c_str());
+
+  SECTION("Objects can be deleted individually")
+  {
+    // delete some objects out of the middle of pages, and keep copies of others
+    SDObject *copies = makeSDArray("copies");
+
+    for(int i = 0; i < numChunks; i += 3)
+    {
+      SDChunk *chunk = arenaFile->chunks[i];
+
+      copies->AddAndOwnChild(chunk->GetChild(1)->Duplicate());
+
+      delete chunk->GetChild(0);
+      chunk->GetChildren().erase(0);
+
+      // individually allocated children are deleted along with their parent
+      chunk->AddAndOwnChild(makeSDString("extra", "An individually allocated child"));
+    }
+
+    delete arenaFile;
+    arenaFile = NULL;
+
+    for(size_t i = 0; i < copies->NumChildren(); i++)
+    {
+      SDObject *complex = copies->GetChild(i);
+      CHECK(complex->name == "complex");
+      CHECK(complex->FindChild("name")->AsString() == "A complex object");
+      CHECK(complex->FindChild("floats")->GetChild(2)->AsFloat() == float(i * 3));
+    }
+
+    delete copies;
+  };
+
+  SECTION("Chunks keep their objects alive")
+  {
+    // take one chunk out of the file, and free everything else in its arena
+    SDChunk *chunk = arenaFile->chunks[numChunks / 2];
+    arenaFile->chunks.erase(numChunks / 2);
+
+    delete arenaFile;
+    arenaFile = NULL;
+
+    CHECK(chunk->HasEqualValue(heapFile->chunks[numChunks / 2]));
+
+    delete chunk;
+  };
+
+  delete arenaFile;
+  delete heapFile;
+  delete buf;
+};
+
+static rdcstr SyntheticChunkName(uint32_t)
+{
+  return "TestChunk";
+}
+
+class SyntheticChunkDecoder : public IStructuredChunkDecoder
+{
+public:
+  ChunkLookup GetChunkLookup() { return &SyntheticChunkName; }
+  bool DecodeChunk(ReadSerialiser &ser, uint32_t chunkID) { return ReadSyntheticChunk(ser); }
+  IStructuredChunkDecoder *Clone() { return new SyntheticChunkDecoder; }
+};
+
+// buffer indices depend on the order that chunks are decoded in, so buffers are compared by their
+// contents. If no files are given, only their sizes are compared.
+static bool SameStructuredValue(const SDObject *a, const SDObject *b, const SDFile *aFile = NULL,
+                                const SDFile *bFile = NULL)
+{
+  if(a->name != b->name || a->type.name != b->type.name ||
+     a->type.basetype != b->type.basetype || a->type.byteSize != b->type.byteSize)
+    return false;
+
+  if(a->type.basetype == SDBasic::Buffer)
+  {
+    if(aFile && bFile)
+      return *aFile->buffers[(size_t)a->data.basic.u] == *bFile->buffers[(size_t)b->data.basic.u];
+    return true;
+  }
+
+  if(a->data.str != b->data.str || a->data.basic.u != b->data.basic.u ||
+     a->NumChildren() != b->NumChildren())
+    return false;
+
+  for(size_t c = 0; c < a->NumChildren(); c++)
+    if(!SameStructuredValue(a->GetChild(c), b->GetChild(c), aFile, bFile))
+      return false;
+
+  return true;
+}
+
+TEST_CASE("Lazily decoded structured chunks", "[serialiser][structured]")
+{
+  const int numChunks = 64;
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  WriteSyntheticCapture(buf, numChunks);
+
+  SDFile *reference = ReadSyntheticCapture(buf, numChunks, false);
+
+  SDFile *lazyFile = new SDFile;
+  REQUIRE(ReadLazyStructuredFile(new StreamReader(buf->GetData(), buf->GetOffset()),
+                                 new SyntheticChunkDecoder, 0, NULL, *lazyFile));
+
+  REQUIRE(lazyFile->chunks.size() == numChunks);
+  CHECK(lazyFile->buffers.empty());
+
+  for(int i = 0; i < numChunks; i++)
+  {
+    SDChunk *chunk = lazyFile->chunks[i];
+
+    CHECK(bool(chunk->type.flags & SDTypeFlags::LazyChildren));
+    CHECK(chunk->data.children.empty());
+    CHECK(chunk->name == reference->chunks[i]->name);
+    CHECK(chunk->metadata.chunkID == reference->chunks[i]->metadata.chunkID);
+    CHECK(chunk->metadata.length == reference->chunks[i]->metadata.length);
+    CHECK(chunk->type.byteSize == reference->chunks[i]->type.byteSize);
+  }
+
+  SECTION("Children are decoded on first access")
+  {
+    CHECK(lazyFile->chunks[3]->NumChildren() == 3);
+
+    // other chunks are left alone
+    CHECK(lazyFile->chunks[2]->data.children.empty());
+    CHECK(lazyFile->chunks[4]->data.children.empty());
+
+    SDObject *complex = lazyFile->chunks[3]->FindChild("complex");
+    REQUIRE(complex);
+    CHECK(complex->FindChild("name")->AsString() == "A complex object");
+    CHECK(complex->FindChild("viewports")->NumChildren() == 3);
+
+    // decoding a chunk with a buffer adds it to the file
+    SDObject *blob = lazyFile->chunks[8]->FindChild("blob");
+    REQUIRE(blob);
+    REQUIRE(lazyFile->buffers.size() == 1);
+    CHECK(blob->data.basic.u == 0);
+    CHECK(lazyFile->buffers[0]->size() == 24);
+    CHECK(lazyFile->buffers[0]->at(0) == 8);
+  };
+
+  SECTION("Chunks decoded in any order are identical")
+  {
+    for(int i = numChunks - 1; i >= 0; i--)
+    {
+      CHECK(SameStructuredValue(lazyFile->chunks[i], reference->chunks[i], lazyFile, reference));
+      CHECK(bool(lazyFile->chunks[i]->type.flags & SDTypeFlags::LazyChildren));
+    }
+
+    CHECK(lazyFile->buffers.size() == reference->buffers.size());
+
+    SDChunk *dup = lazyFile->chunks[5]->Duplicate();
+    CHECK_FALSE(bool(dup->type.flags & SDTypeFlags::LazyChildren));
+    CHECK(dup->HasEqualValue(reference->chunks[5]));
+    delete dup;
+  };
+
+  SECTION("Chunks can be decoded from several threads at once")
+  {
+    rdcarray<Threading::ThreadHandle> threads;
+    int32_t mismatches = 0;
+
+    for(int t = 0; t < 4; t++)
+    {
+      threads.push_back(Threading::CreateThread([&]() {
+        for(int i = 0; i < numChunks; i++)
+        {
+          if(!SameStructuredValue(lazyFile->chunks[i], reference->chunks[i]))
+            Atomic::Inc32(&mismatches);
+        }
+      }));
+    }
+
+    for(Threading::ThreadHandle t : threads)
+    {
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+    }
+
+    CHECK(mismatches == 0);
+    CHECK(lazyFile->buffers.size() == reference->buffers.size());
+  };
+
+  SECTION("Lazy chunks can be written")
+  {
+    // decode some chunks first, so that buffers are in a different order to the original
+    lazyFile->chunks[12]->PopulateChildren();
+    lazyFile->chunks[4]->PopulateChildren();
+
+    StreamWriter *rewriteBuf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+    {
+      WriteSerialiser rewrite(rewriteBuf, Ownership::Nothing);
+
+      rewrite.WriteStructuredFile(*lazyFile, NULL);
+    }
+
+    REQUIRE(rewriteBuf->GetOffset() == buf->GetOffset());
+    CHECK_FALSE(memcmp(rewriteBuf->GetData(), buf->GetData(), (size_t)rewriteBuf->GetOffset()));
+
+    delete rewriteBuf;
+  };
+
+  SECTION("All chunks can be decoded in parallel")
+  {
+    // decode some chunks first, these are skipped
+    lazyFile->chunks[20]->PopulateChildren();
+    lazyFile->chunks[0]->PopulateChildren();
+
+    float lastProgress = 0.0f;
+    bool progressIncreasing = true;
+
+    // small ranges so that there's more than one even without worker threads
+    PopulateStructuredChunks(*lazyFile,
+                             [&](float p) {
+                               progressIncreasing &= (p >= lastProgress);
+                               lastProgress = p;
+                             },
+                             8);
+
+    CHECK(progressIncreasing);
+    CHECK(lastProgress == 1.0f);
+
+    REQUIRE(lazyFile->buffers.size() == reference->buffers.size());
+
+    for(int i = 0; i < numChunks; i++)
+    {
+      CHECK_FALSE(lazyFile->chunks[i]->data.children.empty());
+      CHECK(SameStructuredValue(lazyFile->chunks[i], reference->chunks[i], lazyFile, reference));
+    }
+  };
+
+  SECTION("Chunks can be deleted before they're decoded")
+  {
+    lazyFile->chunks[7]->PopulateChildren();
+
+    delete lazyFile->chunks[0];
+    lazyFile->chunks.erase(0);
+
+    CHECK(SameStructuredValue(lazyFile->chunks[0], reference->chunks[1]));
+  };
+
+  delete lazyFile;
+  delete reference;
+  delete buf;
+};
+
+TEST_CASE("Structured chunks streamed while reading", "[serialiser][structured]")
+{
+  const int numChunks = 50;
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  WriteSyntheticCapture(buf, numChunks);
+
+  SDFile *reference = ReadSyntheticCapture(buf, numChunks, false);
+
+  ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+  ser.ConfigureStructuredExport(&SyntheticChunkName, true, 0, 1.0);
+
+  size_t nextChunk = 0;
+  int numCallbacks = 0;
+  int numMatching = 0;
+  int numInArena = 0;
+
+  SDFile *nested = NULL;
+
+  {
+    ScopedStructuredChunkCallback callback(ser.GetStructuredFile(), [&](SDFile &file) {
+      numCallbacks++;
+
+      // take ownership of each chunk as soon as it's read
+      for(; nextChunk < file.chunks.size(); nextChunk++)
+      {
+        if(file.chunks[nextChunk]->HasEqualValue(reference->chunks[nextChunk]))
+          numMatching++;
+
+        // streamed chunks are deleted straight away, so they aren't allocated in bulk
+        if(SDObjectAlloc::InArena(file.chunks[nextChunk]))
+          numInArena++;
+
+        SAFE_DELETE(file.chunks[nextChunk]);
+      }
+    });
+
+    for(int i = 0; i < numChunks; i++)
+    {
+      ser.ReadChunk<uint32_t>();
+      ReadSyntheticChunk(ser);
+      ser.EndChunk();
+
+      // chunks read into any other file are left alone, e.g. by a nested serialiser
+      if(i == numChunks / 2)
+        nested = ReadSyntheticCapture(buf, numChunks, true);
+    }
+  }
+
+  CHECK(numCallbacks == numChunks);
+  CHECK(numMatching == numChunks);
+  CHECK(numInArena == 0);
+  REQUIRE(ser.GetStructuredFile().chunks.size() == numChunks);
+  CHECK(ser.GetStructuredFile().chunks[0] == NULL);
+  CHECK(ser.GetStructuredFile().chunks[numChunks - 1] == NULL);
+
+  REQUIRE(nested->chunks.size() == numChunks);
+  CHECK(nested->chunks[0]->HasEqualValue(reference->chunks[0]));
+  CHECK(nested->chunks[numChunks - 1]->HasEqualValue(reference->chunks[numChunks - 1]));
+
+  // once the callback is out of scope, chunks are left alone
+  SDFile *afterwards = ReadSyntheticCapture(buf, numChunks, true);
+  CHECK(numCallbacks == numChunks);
+  CHECK(afterwards->chunks[0]->HasEqualValue(reference->chunks[0]));
+
+  delete afterwards;
+  delete nested;
+  delete reference;
+  delete buf;
+};
+
+TEST_CASE("Structured data allocation benchmark", "[serialiser][!benchmark]")
+{
+  const int numChunks = 200000;
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  WriteSyntheticCapture(buf, numChunks);
+
+  for(bool arena : {false, true})
+  {
+    SDFile *file = NULL;
+    uint64_t numPages = 0;
+
+    BENCHMARK(arena ? "Build structured data in bulk" : "Build structured data individually")
+    {
+      file = ReadSyntheticCapture(buf, numChunks, arena, &numPages);
+    }
+
+    uint64_t numObjects = 0;
+    for(SDChunk *chunk : file->chunks)
+      numObjects += CountObjects(chunk);
+
+    // children arrays are allocated separately in both cases
+    RDCLOG("%s: %llu objects in %llu heap allocations", arena ? "Bulk" : "Individual", numObjects,
+           arena ? numPages : numObjects);
+
+    BENCHMARK(arena ? "Free structured data in bulk" : "Free structured data individually")
+    {
+      delete file;
+    }
+  }
+
+  delete buf;
+};
+
 enum class TestEnumClass
 {
   A = 1,
@@ -114,6 +114,7 @@ StreamReader::StreamReader(FILE *file, uint64_t fileSize, Ownership own)
   }
 
   m_File = file;
+  m_FileBase = FileIO::ftell64(file);
   m_InputSize = fileSize;
 
   m_BufferSize = initialBufferSize;
@@ -151,8 +152,49 @@ StreamReader::StreamReader(FILE *file)
   m_Ownership = Ownership::Stream;
 }
 
+struct StreamReader::SharedMapping
+{
+  FileIO::FileMapping *mapping;
+  byte *data;
+  uint64_t size;
+  int32_t refCount;
+};
+
+StreamReader::StreamReader(FileIO::FileMapping *mapping, uint64_t size)
+{
+  m_Mapping = new SharedMapping;
+  m_Mapping->mapping = mapping;
+  m_Mapping->data = FileIO::mapfile_data(mapping);
+  m_Mapping->size = size;
+  m_Mapping->refCount = 1;
+
+  // from here on this behaves exactly like a memory reader over the mapped data
+  m_InputSize = m_BufferSize = size;
+  m_BufferHead = m_BufferBase = m_Mapping->data;
+
+  m_Ownership = Ownership::Nothing;
+}
+
 StreamReader::StreamReader(StreamReader *reader, uint64_t bufferSize)
 {
+  // if the source is mapped, point into the same mapping instead of copying the data out
+  if(reader->m_Mapping)
+  {
+    byte *data = reader->ReadMapped(bufferSize);
+
+    if(data)
+    {
+      m_Mapping = reader->m_Mapping;
+      Atomic::Inc32(&m_Mapping->refCount);
+
+      m_InputSize = m_BufferSize = bufferSize;
+      m_BufferHead = m_BufferBase = data;
+
+      m_Ownership = Ownership::Nothing;
+      return;
+    }
+  }
+
   m_InputSize = m_BufferSize = bufferSize;
   m_BufferHead = m_BufferBase = AllocAlignedBuffer(m_BufferSize);
 
@@ -179,7 +221,18 @@ StreamReader::~StreamReader()
   for(StreamCloseCallback cb : m_Callbacks)
     cb();
 
-  FreeAlignedBuffer(m_BufferBase);
+  if(m_Mapping)
+  {
+    if(Atomic::Dec32(&m_Mapping->refCount) == 0)
+    {
+      FileIO::mapfile_close(m_Mapping->mapping);
+      delete m_Mapping;
+    }
+  }
+  else
+  {
+    FreeAlignedBuffer(m_BufferBase);
+  }
 
   if(m_Ownership == Ownership::Stream)
   {
@@ -193,15 +246,91 @@ StreamReader::~StreamReader()
 
 void StreamReader::SetOffset(uint64_t offs)
 {
+  if(m_Sock)
+  {
+    RDCERR("Socket stream readers do not support seeking");
+    return;
+  }
+
   if(m_File || m_Decompressor)
   {
-    RDCERR("File and decompress stream readers do not support seeking");
+    if(!m_BufferBase || m_HasError)
+      return;
+
+    if(offs > m_InputSize)
+    {
+      RDCERR("Seeking to %llu off the end of the stream (%llu bytes)", offs, m_InputSize);
+      m_HasError = true;
+      return;
+    }
+
+    // if the offset is ahead of us within the data we've already read in, just move the head. We
+    // can't do the same going backwards since the window isn't guaranteed to contain valid data
+    // behind the head.
+    uint64_t curOffset = GetOffset();
+    if(offs >= curOffset && offs - curOffset <= Available())
+    {
+      m_BufferHead += offs - curOffset;
+      return;
+    }
+
+    // otherwise reposition the external source and refill the window from the new offset.
+    bool seeked = true;
+
+    if(m_Decompressor)
+      seeked = m_Decompressor->Seek(offs);
+    else
+      FileIO::fseek64(m_File, m_FileBase + offs, SEEK_SET);
+
+    if(seeked)
+    {
+      m_ReadOffset = offs;
+      m_BufferHead = m_BufferBase;
+      ReadFromExternal(m_BufferBase, RDCMIN(m_BufferSize, m_InputSize - offs));
+      return;
+    }
+
+    // a decompressor that can't seek can still be skipped forward by reading
+    if(offs > curOffset)
+    {
+      Read(NULL, offs - curOffset);
+      return;
+    }
+
+    RDCERR("Stream reader can't seek backwards to %llu", offs);
+    m_HasError = true;
     return;
   }
 
   m_BufferHead = m_BufferBase + offs;
 }
 
+byte *StreamReader::ReadMapped(uint64_t numBytes)
+{
+  if(!m_Mapping || m_HasError)
+    return NULL;
+
+  // let Read() handle the error for reading off the end
+  if(GetOffset() + numBytes > GetSize())
+  {
+    Read(NULL, numBytes);
+    return NULL;
+  }
+
+  byte *ret = m_BufferHead;
+  m_BufferHead += numBytes;
+  return ret;
+}
+
+bool StreamReader::IsMappedPointer(const void *ptr) const
+{
+  if(!m_Mapping || !ptr)
+    return false;
+
+  const byte *b = (const byte *)ptr;
+  return b >= m_Mapping->data && b < m_Mapping->data + m_Mapping->size;
+}
+
 bool StreamReader::Reserve(uint64_t numBytes)
 {
   RDCASSERT(m_Sock || m_File || m_Decompressor);
@@ -381,24 +510,16 @@ bool StreamReader::ReadFromExternal(void *buffer, uint64_t length)
     }
     else
     {
-      // first get the required data blocking (this will sleep the thread until it comes in).
-      byte *readDest = (byte *)buffer;
+      // get the required data blocking (this will sleep the thread until it comes in), and read
+      // more if it's already available, as much as possible, to try and batch future reads
+      uint32_t bufSize = (uint32_t)length;
+      if(m_InputSize + length < m_BufferSize)
+        bufSize = uint32_t(m_BufferSize - m_InputSize);
 
-      success = m_Sock->RecvDataBlocking(readDest, (uint32_t)length);
+      success = m_Sock->RecvDataBlocking(buffer, (uint32_t)length, bufSize);
 
       if(success)
-      {
-        m_InputSize += length;
-        readDest += length;
-
-        uint32_t bufSize = uint32_t(m_BufferSize - m_InputSize);
-
-        // now read more, as much as possible, to try and batch future reads
-        success = m_Sock->RecvDataNonBlocking(readDest, bufSize);
-
-        if(success)
-          m_InputSize += bufSize;
-      }
+        m_InputSize += bufSize;
     }
   }
   else
@@ -515,26 +636,18 @@ StreamWriter::~StreamWriter()
 bool StreamWriter::SendSocketData(const void *data, uint64_t numBytes)
 {
   // try to coalesce small writes without doing blocking sends, at least until we're flushed.
-  // if the buffer is already full, flush it.
+  // if the write doesn't fit, send what's buffered together with it in one go.
   if(m_BufferHead + numBytes >= m_BufferEnd)
   {
-    bool success = FlushSocketData();
+    bool success = m_Sock->SendDataBlocking(m_BufferBase, uint32_t(m_BufferHead - m_BufferBase),
+                                            data, (uint32_t)numBytes);
     if(!success)
     {
       HandleError();
       return false;
     }
-  }
 
-  // if it's larger than our buffer (even after flushing) just write directly
-  if(m_BufferHead + numBytes >= m_BufferEnd)
-  {
-    bool success = m_Sock->SendDataBlocking(data, (uint32_t)numBytes);
-    if(!success)
-    {
-      HandleError();
-      return false;
-    }
+    m_BufferHead = m_BufferBase;
   }
   else
   {
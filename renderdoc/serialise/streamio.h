@@ -61,6 +61,10 @@ public:
   virtual bool Recompress(Compressor *comp) = 0;
   virtual bool Read(void *data, uint64_t numBytes) = 0;
 
+  // repositions the decompressor so the next Read() returns data from the given uncompressed
+  // offset. Decompressors that can't seek return false and are left unchanged.
+  virtual bool Seek(uint64_t offset) { return false; }
+
 protected:
   StreamReader *m_Read;
   Ownership m_Ownership;
@@ -88,6 +92,8 @@ public:
   StreamReader(FILE *file);
   StreamReader(StreamReader *reader, uint64_t bufferSize);
   StreamReader(Decompressor *decompressor, uint64_t uncompressedSize, Ownership own);
+  // reads directly from a file mapping, taking ownership of it. See FileIO::mapfile_open
+  StreamReader(FileIO::FileMapping *mapping, uint64_t size);
 
   ~StreamReader();
 
@@ -229,6 +235,16 @@ public:
     return Read(&data, sizeof(T));
   }
 
+  // for readers backed by a file mapping, returns a pointer to the next numBytes directly in the
+  // mapping and skips past them, so the data can be used without copying. The pointer remains
+  // valid as long as this reader, or any reader created from it, is alive. For other readers this
+  // returns NULL and nothing is read.
+  byte *ReadMapped(uint64_t numBytes);
+
+  bool IsMapped() const { return m_Mapping != NULL; }
+  // returns true if ptr points into this reader's file mapping, e.g. from ReadMapped()
+  bool IsMappedPointer(const void *ptr) const;
+
   void AddCloseCallback(StreamCloseCallback callback) { m_Callbacks.push_back(callback); }
 private:
   inline uint64_t Available()
@@ -267,6 +283,14 @@ private:
   // the offset in the file/decompressor that corresponds to the start of m_BufferBase
   uint64_t m_ReadOffset = 0;
 
+  // the position in m_File that corresponds to offset 0 in this stream, for seeking
+  uint64_t m_FileBase = 0;
+
+  // the file mapping, if we're reading from one. This is shared with any readers created from this
+  // one, m_BufferBase points into it and isn't owned.
+  struct SharedMapping;
+  SharedMapping *m_Mapping = NULL;
+
   // flag indicating if an error has been encountered and the stream is now invalid
   bool m_HasError = false;
 
@@ -94,6 +94,93 @@ TEST_CASE("Test basic stream I/O operations", "[streamio]")
   CHECK(reader.IsErrored());
 };
 
+TEST_CASE("Test mapped stream I/O", "[streamio]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "/renderdoc_mapped_stream_test.bin";
+
+  // put the data at an odd offset, so the mapping has to handle a range that isn't page aligned
+  const uint64_t prefix = 4099;
+  const uint64_t dataSize = 256 * 1024;
+
+  bytebuf data;
+  data.resize((size_t)dataSize);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = byte((i * 7) ^ (i >> 8));
+
+  {
+    FILE *f = FileIO::fopen(filename.c_str(), "wb");
+    REQUIRE(f);
+
+    bytebuf junk;
+    junk.resize((size_t)prefix);
+    FileIO::fwrite(junk.data(), 1, junk.size(), f);
+    FileIO::fwrite(data.data(), 1, data.size(), f);
+    FileIO::fclose(f);
+  }
+
+  FILE *f = FileIO::fopen(filename.c_str(), "rb");
+  REQUIRE(f);
+
+  FileIO::FileMapping *mapping = FileIO::mapfile_open(f, prefix, dataSize);
+
+  // the mapping remains valid after the file is closed
+  FileIO::fclose(f);
+
+  REQUIRE(mapping);
+
+  StreamReader *reader = new StreamReader(mapping, dataSize);
+
+  CHECK(reader->IsMapped());
+  CHECK(reader->GetSize() == dataSize);
+
+  uint32_t val = 0;
+  reader->Read(val);
+  CHECK(memcmp(&val, data.data(), sizeof(val)) == 0);
+
+  byte *direct = reader->ReadMapped(1024);
+  REQUIRE(direct);
+  CHECK(reader->IsMappedPointer(direct));
+  CHECK(memcmp(direct, data.data() + 4, 1024) == 0);
+  CHECK(reader->GetOffset() == 1028);
+
+  // the mapping is copy-on-write, so modifying it is allowed
+  direct[0] ^= 0xff;
+
+  CHECK_FALSE(reader->IsMappedPointer(&val));
+
+  // a reader created from a mapped reader shares the mapping instead of copying
+  StreamReader *sub = new StreamReader(reader, 64 * 1024);
+  CHECK(sub->IsMapped());
+  CHECK(reader->GetOffset() == 1028 + 64 * 1024);
+
+  // the parent can be destroyed before the sub-reader
+  delete reader;
+
+  bytebuf readback;
+  readback.resize(64 * 1024);
+  sub->Read(readback.data(), readback.size());
+  CHECK(memcmp(readback.data(), data.data() + 1028, readback.size()) == 0);
+  CHECK(sub->AtEnd());
+
+  sub->SetOffset(100);
+  sub->Read(val);
+  CHECK(memcmp(&val, data.data() + 1128, sizeof(val)) == 0);
+
+  // reading off the end of a mapping errors the same as any other reader
+  CHECK(sub->ReadMapped(128 * 1024) == NULL);
+  CHECK(sub->IsErrored());
+
+  delete sub;
+
+  // the modification didn't reach the file
+  bytebuf fileContents;
+  FileIO::ReadAll(filename, fileContents);
+  CHECK(fileContents.size() == prefix + dataSize);
+  CHECK(fileContents[(size_t)prefix + 4] == data[4]);
+
+  FileIO::Delete(filename.c_str());
+};
+
 TEST_CASE("Test stream I/O operations over the network", "[streamio][network]")
 {
   uint16_t port = 8235;
@@ -302,6 +389,71 @@ TEST_CASE("Test stream I/O operations over the network", "[streamio][network]")
     CHECK(writer.IsErrored());
   };
 
+  SECTION("Send/receive writes larger than the buffer")
+  {
+    StreamWriter writer(sender, Ownership::Nothing);
+    StreamReader reader(receiver, Ownership::Nothing);
+
+    // larger than the writer's buffer, so it's sent along with the buffered data before it
+    bytebuf sent;
+    sent.resize(1024 * 1024 + 3);
+    for(size_t i = 0; i < sent.size(); i++)
+      sent[i] = byte((i * 7) & 0xff);
+
+    bytebuf received;
+    uint32_t header = 0, footer = 0;
+
+    int32_t threadA = 0, threadB = 0;
+
+    Threading::ThreadHandle recvThread =
+        Threading::CreateThread([&threadA, &reader, &received, &header, &footer]() {
+          uint64_t size = 0;
+          reader.Read(header);
+          reader.Read(size);
+          received.resize((size_t)size);
+          reader.Read(received.data(), size);
+          reader.Read(footer);
+
+          Atomic::Inc32(&threadA);
+        });
+
+    Threading::ThreadHandle sendThread = Threading::CreateThread([&threadB, &writer, &sent]() {
+      uint32_t val = 0xcafe;
+      writer.Write(val);
+      writer.Write((uint64_t)sent.size());
+      writer.Write(sent.data(), sent.size());
+      val = 0xf00d;
+      writer.Write(val);
+      writer.Flush();
+
+      Atomic::Inc32(&threadB);
+    });
+
+    // wait up to 2 seconds for the threads to exit
+    for(int i = 0; i < 2000 / 50; i++)
+    {
+      Threading::Sleep(50);
+      if(threadA && threadB)
+        break;
+    }
+
+    REQUIRE(threadA);
+    REQUIRE(threadB);
+
+    Threading::JoinThread(sendThread);
+    Threading::CloseThread(sendThread);
+
+    Threading::JoinThread(recvThread);
+    Threading::CloseThread(recvThread);
+
+    CHECK(header == 0xcafe);
+    CHECK(footer == 0xf00d);
+    CHECK(received == sent);
+
+    CHECK_FALSE(writer.IsErrored());
+    CHECK_FALSE(reader.IsErrored());
+  };
+
   delete sender;
   delete receiver;
   delete server;
@@ -25,9 +25,15 @@
 #define ZSTD_STATIC_LINKING_ONLY
 #include "zstdio.h"
 
-static const uint64_t zstdBlockSize = 128 * 1024;
+static const uint64_t zstdBlockSize = ZSTDBlockSize;
 static const uint64_t compressBlockSize = ZSTD_compressBound(zstdBlockSize);
 
+// how many frames are compressed in each parallel job. This keeps the per-job overhead small while
+// still splitting a large section into plenty of jobs.
+static const uint64_t framesPerBatch = 16;
+static const uint64_t batchSize = zstdBlockSize * framesPerBatch;
+static const uint64_t batchCompressSize = (sizeof(uint32_t) + compressBlockSize) * framesPerBatch;
+
 ZSTDCompressor::ZSTDCompressor(StreamWriter *write, Ownership own) : Compressor(write, own)
 {
   m_Page = AllocAlignedBuffer(zstdBlockSize);
@@ -194,6 +200,203 @@ bool ZSTDCompressor::CompressZSTDFrame(ZSTD_inBuffer &in, ZSTD_outBuffer &out)
   return true;
 }
 
+bool ReadZSTDBlockIndex(FILE *file, uint64_t streamOffset, uint64_t streamLength,
+                        ZSTDBlockIndex &index)
+{
+  ZSTDBlockIndexFooter footer = {};
+
+  if(streamLength < sizeof(footer))
+    return false;
+
+  FileIO::fseek64(file, streamOffset + streamLength - sizeof(footer), SEEK_SET);
+  if(FileIO::fread(&footer, 1, sizeof(footer), file) != sizeof(footer))
+    return false;
+
+  if(footer.magic != ZSTDBlockIndexMagic || footer.blockSize != zstdBlockSize ||
+     footer.numBlocks > (streamLength - sizeof(footer)) / sizeof(uint64_t))
+  {
+    RDCERR("Invalid zstd block index footer");
+    return false;
+  }
+
+  index.blockSize = footer.blockSize;
+  index.frameOffsets.resize((size_t)footer.numBlocks);
+
+  FileIO::fseek64(file, streamOffset + streamLength - index.GetStoredSize(), SEEK_SET);
+  size_t indexBytes = index.frameOffsets.size() * sizeof(uint64_t);
+  if(FileIO::fread(index.frameOffsets.data(), 1, indexBytes, file) != indexBytes)
+  {
+    index.frameOffsets.clear();
+    return false;
+  }
+
+  return true;
+}
+
+ZSTDParallelCompressor::ZSTDParallelCompressor(StreamWriter *write, Ownership own)
+    : Compressor(write, own)
+{
+  // allow two batches in flight per worker, so workers don't starve while we write out results.
+  // With no workers we still need one batch, which will be compressed when it's retired.
+  uint32_t numBatches = RDCMAX(1U, Threading::JobSystem::NumWorkers() * 2);
+
+  m_Batches.resize(numBatches);
+  for(Batch *&b : m_Batches)
+  {
+    b = new Batch;
+    b->input = AllocAlignedBuffer(batchSize);
+    b->output = AllocAlignedBuffer(batchCompressSize);
+    b->ctx = ZSTD_createCCtx();
+  }
+}
+
+ZSTDParallelCompressor::~ZSTDParallelCompressor()
+{
+  // wait for any in-flight jobs before freeing their buffers
+  for(Batch *b : m_Batches)
+  {
+    Threading::JobSystem::SyncJob(b->job);
+    ZSTD_freeCCtx(b->ctx);
+    FreeAlignedBuffer(b->input);
+    FreeAlignedBuffer(b->output);
+    delete b;
+  }
+}
+
+bool ZSTDParallelCompressor::Write(const void *data, uint64_t numBytes)
+{
+  if(m_Error || m_Finished)
+    return false;
+
+  const byte *src = (const byte *)data;
+
+  while(numBytes > 0)
+  {
+    Batch *b = m_Batches[m_Submitted % m_Batches.size()];
+
+    uint64_t copyBytes = RDCMIN(batchSize - b->inputSize, numBytes);
+    memcpy(b->input + b->inputSize, src, (size_t)copyBytes);
+
+    b->inputSize += copyBytes;
+    src += copyBytes;
+    numBytes -= copyBytes;
+
+    if(b->inputSize == batchSize)
+    {
+      Submit();
+
+      // if the next batch is still in flight, we have to wait for it and write it out before
+      // reusing it.
+      if(m_Submitted - m_Retired == m_Batches.size() && !Retire())
+        return false;
+    }
+  }
+
+  return true;
+}
+
+bool ZSTDParallelCompressor::Finish()
+{
+  if(m_Error)
+    return false;
+
+  if(m_Finished)
+    return true;
+
+  m_Finished = true;
+
+  if(m_Batches[m_Submitted % m_Batches.size()]->inputSize > 0)
+    Submit();
+
+  while(m_Retired < m_Submitted)
+  {
+    if(!Retire())
+      return false;
+  }
+
+  ZSTDBlockIndexFooter footer;
+  footer.numBlocks = m_Index.frameOffsets.size();
+  footer.blockSize = m_Index.blockSize;
+  footer.magic = ZSTDBlockIndexMagic;
+
+  bool success = true;
+  success &= m_Write->Write(m_Index.frameOffsets.data(),
+                            m_Index.frameOffsets.size() * sizeof(uint64_t));
+  success &= m_Write->Write(footer);
+
+  if(!success)
+    m_Error = true;
+
+  return success;
+}
+
+void ZSTDParallelCompressor::CompressBatch(Batch *batch)
+{
+  batch->outputSize = 0;
+  batch->frameSizes.clear();
+
+  for(uint64_t offs = 0; offs < batch->inputSize; offs += zstdBlockSize)
+  {
+    size_t frameInput = (size_t)RDCMIN(zstdBlockSize, batch->inputSize - offs);
+
+    byte *out = batch->output + batch->outputSize;
+
+    size_t size = ZSTD_compressCCtx(batch->ctx, out + sizeof(uint32_t), compressBlockSize,
+                                    batch->input + offs, frameInput, 7);
+
+    if(ZSTD_isError(size))
+    {
+      RDCERR("Error compressing: %s", ZSTD_getErrorName(size));
+      batch->success = false;
+      return;
+    }
+
+    // write the same length prefix as ZSTDCompressor
+    uint32_t frameSize = (uint32_t)size;
+    memcpy(out, &frameSize, sizeof(frameSize));
+
+    batch->frameSizes.push_back(frameSize);
+    batch->outputSize += sizeof(uint32_t) + size;
+  }
+}
+
+void ZSTDParallelCompressor::Submit()
+{
+  Batch *b = m_Batches[m_Submitted % m_Batches.size()];
+  b->job = Threading::JobSystem::AddJob([b]() { CompressBatch(b); });
+  m_Submitted++;
+}
+
+bool ZSTDParallelCompressor::Retire()
+{
+  Batch *b = m_Batches[m_Retired % m_Batches.size()];
+  m_Retired++;
+
+  Threading::JobSystem::SyncJob(b->job);
+  b->job = NULL;
+
+  if(!b->success)
+  {
+    m_Error = true;
+    return false;
+  }
+
+  for(uint32_t frameSize : b->frameSizes)
+  {
+    m_Index.frameOffsets.push_back(m_CompressedSize);
+    m_CompressedSize += sizeof(uint32_t) + frameSize;
+  }
+
+  bool success = m_Write->Write(b->output, b->outputSize);
+
+  b->inputSize = 0;
+
+  if(!success)
+    m_Error = true;
+
+  return success;
+}
+
 ZSTDDecompressor::ZSTDDecompressor(StreamReader *read, Ownership own) : Decompressor(read, own)
 {
   m_Page = AllocAlignedBuffer(zstdBlockSize);
@@ -205,6 +408,12 @@ ZSTDDecompressor::ZSTDDecompressor(StreamReader *read, Ownership own) : Decompre
   m_Stream = ZSTD_createDStream();
 }
 
+ZSTDDecompressor::ZSTDDecompressor(StreamReader *read, Ownership own, const ZSTDBlockIndex &index)
+    : ZSTDDecompressor(read, own)
+{
+  m_Index = index;
+}
+
 ZSTDDecompressor::~ZSTDDecompressor()
 {
   ZSTD_freeDStream(m_Stream);
@@ -286,6 +495,42 @@ bool ZSTDDecompressor::Read(void *data, uint64_t numBytes)
   return success;
 }
 
+bool ZSTDDecompressor::Seek(uint64_t offset)
+{
+  // if we encountered a stream error this will be NULL
+  if(!m_CompressBuffer || m_Index.frameOffsets.empty())
+    return false;
+
+  uint64_t block = offset / m_Index.blockSize;
+
+  // seeking to the very end is allowed, it leaves the last page fully consumed
+  if(block == m_Index.frameOffsets.size() && offset % m_Index.blockSize == 0)
+  {
+    block--;
+  }
+  else if(block >= m_Index.frameOffsets.size())
+  {
+    RDCERR("Seeking to %llu which is past the last block", offset);
+    return false;
+  }
+
+  m_Read->SetOffset(m_Index.frameOffsets[(size_t)block]);
+
+  if(!FillPage())
+    return false;
+
+  m_PageOffset = offset - block * m_Index.blockSize;
+
+  if(m_PageOffset > m_PageLength)
+  {
+    RDCERR("Block %llu is too short for offset %llu", block, offset);
+    m_PageOffset = m_PageLength;
+    return false;
+  }
+
+  return true;
+}
+
 bool ZSTDDecompressor::FillPage()
 {
   uint32_t compSize = 0;
@@ -24,9 +24,48 @@
 
 #pragma once
 
+#include "common/threading.h"
 #include "zstd/zstd.h"
 #include "streamio.h"
 
+// The uncompressed size of each zstd frame. Every frame but the last in a stream decompresses to
+// exactly this many bytes.
+static const uint64_t ZSTDBlockSize = 128 * 1024;
+
+// Streams written by ZSTDParallelCompressor have the same frame layout as ZSTDCompressor, so they
+// can be read sequentially by ZSTDDecompressor, but after the last frame they have a block index:
+//
+//   uint64_t frameOffsets[numBlocks]; // offset of each frame's length prefix in the stream
+//   ZSTDBlockIndexFooter footer;
+//
+// since frame i contains the uncompressed bytes [i*blockSize, (i+1)*blockSize) this allows random
+// access as well as decompressing frames independently.
+static const uint64_t ZSTDBlockIndexMagic = MAKE_FOURCC('Z', 'I', 'D', 'X');
+
+struct ZSTDBlockIndexFooter
+{
+  uint64_t numBlocks;
+  uint64_t blockSize;
+  uint64_t magic;
+};
+
+struct ZSTDBlockIndex
+{
+  uint64_t blockSize = ZSTDBlockSize;
+  rdcarray<uint64_t> frameOffsets;
+
+  // the size of the index as stored on disk including the footer
+  uint64_t GetStoredSize() const
+  {
+    return frameOffsets.size() * sizeof(uint64_t) + sizeof(ZSTDBlockIndexFooter);
+  }
+};
+
+// Reads the block index from the end of a stream of the given total size, leaving the file position
+// undefined.
+bool ReadZSTDBlockIndex(FILE *file, uint64_t streamOffset, uint64_t streamLength,
+                        ZSTDBlockIndex &index);
+
 class ZSTDCompressor : public Compressor
 {
 public:
@@ -48,18 +87,70 @@ private:
   ZSTD_CStream *m_Stream;
 };
 
+// compresses frames in batches on the job system, so that compression isn't bottlenecked on the
+// writing thread. Frames are written out in order followed by a block index.
+class ZSTDParallelCompressor : public Compressor
+{
+public:
+  ZSTDParallelCompressor(StreamWriter *write, Ownership own);
+  ~ZSTDParallelCompressor();
+
+  bool Write(const void *data, uint64_t numBytes);
+  bool Finish();
+
+private:
+  struct Batch
+  {
+    byte *input = NULL;
+    uint64_t inputSize = 0;
+
+    // compressed frames each with their uint32_t length prefix, tightly packed
+    byte *output = NULL;
+    uint64_t outputSize = 0;
+    rdcarray<uint32_t> frameSizes;
+
+    ZSTD_CCtx *ctx = NULL;
+    Threading::JobSystem::Job *job = NULL;
+    bool success = true;
+  };
+
+  static void CompressBatch(Batch *batch);
+
+  void Submit();
+  bool Retire();
+
+  rdcarray<Batch *> m_Batches;
+
+  // number of batches handed to the job system, and the number written out. The batch currently
+  // being filled is m_Batches[m_Submitted % m_Batches.size()]
+  uint64_t m_Submitted = 0;
+  uint64_t m_Retired = 0;
+
+  // how many bytes have been written to m_Write so far, for the block index
+  uint64_t m_CompressedSize = 0;
+  ZSTDBlockIndex m_Index;
+
+  bool m_Finished = false;
+  bool m_Error = false;
+};
+
 class ZSTDDecompressor : public Decompressor
 {
 public:
   ZSTDDecompressor(StreamReader *read, Ownership own);
+  // if the stream has a block index, passing it allows seeking. See ZSTDBlockIndexFooter
+  ZSTDDecompressor(StreamReader *read, Ownership own, const ZSTDBlockIndex &index);
   ~ZSTDDecompressor();
 
   bool Recompress(Compressor *comp);
   bool Read(void *data, uint64_t numBytes);
+  bool Seek(uint64_t offset);
 
 private:
   bool FillPage();
 
+  ZSTDBlockIndex m_Index;
+
   byte *m_Page;
   byte *m_CompressBuffer;
   uint64_t m_PageOffset;
@@ -26,7 +26,9 @@
 #include <ctype.h>
 #include <stdint.h>
 #include <algorithm>
+#include <set>
 #include "common/globalconfig.h"
+#include "common/threading.h"
 #include "os/os_specific.h"
 
 uint32_t strhash(const char *str, uint32_t seed)
@@ -85,6 +87,19 @@ static int get_lastpathsep(const rdcstr &path)
   return (int)offs;
 }
 
+rdcliteral strintern(const rdcstr &str)
+{
+  // deliberately leaked, so that interned strings remain valid during shutdown
+  static Threading::CriticalSection *lock = new Threading::CriticalSection();
+  static std::set<rdcstr> *strings = new std::set<rdcstr>();
+
+  SCOPED_LOCK(*lock);
+
+  // set nodes never move, so the string storage is stable whether it's in-line or allocated
+  auto it = strings->insert(str);
+  return rdcliteral(it.first->c_str(), it.first->size());
+}
+
 rdcstr get_basename(const rdcstr &path)
 {
   rdcstr base = path;
@@ -228,6 +243,35 @@ TEST_CASE("String hashing", "[string]")
   };
 };
 
+TEST_CASE("String interning", "[string]")
+{
+  rdcstr a = "a reasonably long string that can't be stored in-line";
+  rdcstr b = a;
+  rdcstr c = "short";
+
+  rdcliteral internA = strintern(a);
+  rdcliteral internB = strintern(b);
+  rdcliteral internC = strintern(c);
+
+  CHECK(internA.c_str() != a.c_str());
+  CHECK(internA.c_str() == internB.c_str());
+  CHECK(internC.c_str() != internA.c_str());
+
+  CHECK(rdcstr(internA) == a);
+  CHECK(rdcstr(internC) == c);
+
+  // the interned storage remains valid after the source string is gone
+  a = "modified";
+  c.clear();
+  CHECK(rdcstr(internB) == b);
+  CHECK(strintern("short").c_str() == internC.c_str());
+  CHECK(strcmp(internC.c_str(), "short") == 0);
+
+  // strings constructed from an interned string share its storage instead of allocating
+  rdcstr copy = internA;
+  CHECK(copy.c_str() == internA.c_str());
+};
+
 TEST_CASE("String manipulation", "[string]")
 {
   SECTION("strlower")
@@ -33,6 +33,11 @@ rdcstr strupper(const rdcstr &str);
 
 uint32_t strhash(const char *str, uint32_t existingHash = 5381);
 
+// returns a literal with the same contents as str, backed by a process-wide table that is never
+// freed. Only intended for strings drawn from a small fixed set like chunk and type names, so that
+// everything referencing them can share one copy.
+rdcliteral strintern(const rdcstr &str);
+
 rdcstr get_basename(const rdcstr &path);
 rdcstr get_dirname(const rdcstr &path);
 rdcstr strip_extension(const rdcstr &path);